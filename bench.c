@@ -0,0 +1,1602 @@
+#define _GNU_SOURCE
+#include "funcore.h"
+#include "search.h"
+#include "funregex.h"
+#include "parallelsearch.h"
+#include "incsearch.h"
+#include "matchindex.h"
+#include "filesave.h"
+#include "journal.h"
+#include "filewatch.h"
+#include "pagedfile.h"
+#include "fileload.h"
+#include "hexview.h"
+#include "filetree.h"
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/wait.h>
+#endif
+
+#define BENCH_DEFAULT_PATH "ex.txt"
+#define BENCH_DEFAULT_OPS 20000
+
+static uint64_t bench_rng_state = 0x9E3779B97F4A7C15ULL;
+
+uint64_t BenchRandom() {
+    // xorshift64*, fixed seed so every run sees the same edit sequence
+    bench_rng_state ^= bench_rng_state >> 12;
+    bench_rng_state ^= bench_rng_state << 25;
+    bench_rng_state ^= bench_rng_state >> 27;
+    return bench_rng_state * 2685821657736338717ULL;
+}
+
+size_t BenchRandomBelow(size_t bound) {
+    return bound == 0 ? 0 : BenchRandom() % bound;
+}
+
+void ReportBench(const char* name, size_t ops, double seconds) {
+    printf("%-28s %9zu ops %10.3f ms %10.1f ns/op\n", name, ops, seconds * 1000.0, ops ? seconds * 1e9 / ops : 0.0);
+}
+
+void BenchLoad(const char* path) {
+    TextBuffer buffer = {0};
+    double start = GetWallTime();
+    InitTextBufferFromPath(&buffer, path);
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu B   %10.3f ms %10zu lines\n", "load", GetTextSize(&buffer), elapsed * 1000.0, GetLineCount(&buffer));
+    ClearTextBuffer(&buffer);
+}
+
+void BenchInsertRandom(const char* path, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    char text[] = "fun\n";
+
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        size_t position = BenchRandomBelow(GetTextSize(&buffer) + 1);
+        InsertString(&buffer, position, text, 1 + BenchRandomBelow(sizeof(text) - 1));
+    }
+    ReportBench("insert random", ops, GetWallTime() - start);
+    printf("%-28s %9zu pieces\n", "", buffer.piece_count);
+    ClearTextBuffer(&buffer);
+}
+
+void BenchInsertSequential(const char* path, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    char text = 'x';
+    size_t position = GetTextSize(&buffer) / 2;
+
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        InsertString(&buffer, position++, &text, 1);
+    }
+    ReportBench("insert typing", ops, GetWallTime() - start);
+    ClearTextBuffer(&buffer);
+}
+
+void BenchDeleteRandom(const char* path, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops && GetTextSize(&buffer) > 0; ++i) {
+        size_t position = BenchRandomBelow(GetTextSize(&buffer));
+        DeleteRange(&buffer, position, 1 + BenchRandomBelow(8));
+    }
+    ReportBench("delete random", ops, GetWallTime() - start);
+    ClearTextBuffer(&buffer);
+}
+
+void BenchLineLookup(const char* path, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "a\nb", 3);
+    }
+    size_t line_count = GetLineCount(&buffer);
+    size_t checksum = 0;
+
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        checksum += GetLineByIndex(&buffer, BenchRandomBelow(line_count)).x;
+    }
+    ReportBench("line by index", ops, GetWallTime() - start);
+
+    start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        checksum += IndexToPosition(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1)).y;
+    }
+    ReportBench("index to position", ops, GetWallTime() - start);
+
+    start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        char* line = GenerateLine(&buffer, BenchRandomBelow(line_count));
+        checksum += line[0];
+        free(line);
+    }
+    ReportBench("generate line", ops, GetWallTime() - start);
+
+    start = GetWallTime();
+    RebuildLineCache(&buffer);
+    ReportBench("rebuild line cache", 1, GetWallTime() - start);
+
+    if (checksum == 0) printf("\n");
+    ClearTextBuffer(&buffer);
+}
+
+// Opens the file in the viewer with the smallest cache, so pages keep being evicted, and checks
+// its jumps and scrolling against the line starts of the whole text. A jump made before the
+// index is built has to turn exact once it is.
+bool BenchPagedFile(const char* path, size_t ops) {
+    size_t size;
+    char* text = LoadFile(path, &size);
+    if (!text) return false;
+    size_t line_count = 1;
+    for (size_t i = 0; i < size; ++i) {
+        line_count += text[i] == '\n';
+    }
+    size_t* line_starts = malloc(line_count * sizeof(size_t));
+    line_starts[0] = 0;
+    for (size_t i = 0, line = 1; i < size; ++i) {
+        if (text[i] == '\n') {
+            line_starts[line++] = i + 1;
+        }
+    }
+    // A newline at the end starts no line the viewer goes to
+    size_t shown_lines = line_count - (size > 0 && text[size - 1] == '\n');
+
+    PagedFile file;
+    double start = GetWallTime();
+    bool opened = OpenPagedFile(&file, path, 0);
+    bool ok = opened;
+    if (opened) {
+        JumpToPagedLine(&file, shown_lines / 2);
+        while (GetPagedIndexProgress(&file, NULL) < 1.0) {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            usleep(200);
+#endif
+        }
+        double elapsed = GetWallTime() - start;
+        printf("%-28s %9zu lines  %8.3f ms %10.1f MB/s\n", "paged line index", line_count, elapsed * 1000.0, size / elapsed / 1e6);
+        UpdatePagedFile(&file);
+        ok = file.top_line_exact && file.top_line < line_count && file.top == line_starts[file.top_line];
+    }
+
+    start = GetWallTime();
+    for (size_t i = 0; i < ops && ok; ++i) {
+        size_t line = BenchRandomBelow(shown_lines);
+        JumpToPagedLine(&file, line);
+        ok = file.top_line == line && file.top == line_starts[line];
+    }
+    if (ok) ReportBench("paged jump to line", ops, GetWallTime() - start);
+
+    start = GetWallTime();
+    for (size_t i = 0; i < ops && ok && size > 0; ++i) {
+        size_t offset = BenchRandomBelow(size);
+        size_t low = 0;
+        size_t high = line_count;
+        while (high - low > 1) {
+            size_t mid = low + (high - low) / 2;
+            if (line_starts[mid] <= offset) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        JumpToPagedOffset(&file, offset);
+        ok = file.top_line == low && file.top == line_starts[low];
+    }
+    if (ok) ReportBench("paged jump to offset", ops, GetWallTime() - start);
+
+    if (ok) {
+        JumpToPagedLine(&file, 0);
+        ScrollPagedFile(&file, 100);
+        ScrollPagedFile(&file, -40);
+        size_t expected = min((size_t)100, shown_lines - 1) - min((size_t)40, min((size_t)100, shown_lines - 1));
+        char line[256];
+        uint64_t next;
+        ReadPagedLine(&file, file.top, 0, line, sizeof(line), &next);
+        ok = file.top_line == expected && file.top == line_starts[expected] && (expected + 1 >= line_count || next == line_starts[expected + 1]);
+    }
+    if (!ok) {
+        printf("paged view mismatch at line %llu, offset %llu\n", (unsigned long long)file.top_line, (unsigned long long)file.top);
+    }
+
+    if (opened) {
+        ClosePagedFile(&file);
+    }
+    free(line_starts);
+    free(text);
+    return ok;
+}
+
+bool BenchUndoRedoStorm(const char* path, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    uint64_t original_hash = HashTextBuffer(&buffer);
+    double current_time = 0;
+
+    size_t edits = min(ops, (size_t)INITIAL_UNDO_STACK_CAPACITY);
+    double start = GetWallTime();
+    for (size_t i = 0; i < edits; ++i) {
+        // Far apart in time so no edit merges with the previous one
+        current_time += 2.0;
+        buffer.pointer_position = BenchRandomBelow(GetTextSize(&buffer) + 1);
+        if (BenchRandom() & 1) {
+            InsertTextAtPointer(&buffer, "storm\n", 6, current_time);
+        } else if (buffer.pointer_position < GetTextSize(&buffer)) {
+            RemoveArea(&buffer, buffer.pointer_position, min((size_t)4, GetTextSize(&buffer) - buffer.pointer_position));
+        }
+    }
+    ReportBench("undoable edits", edits, GetWallTime() - start);
+    uint64_t edited_hash = HashTextBuffer(&buffer);
+
+    size_t rounds = max((size_t)1, ops / max(buffer.undo_stack.count, (size_t)1));
+    size_t steps = 0;
+    start = GetWallTime();
+    for (size_t round = 0; round < rounds; ++round) {
+        while (buffer.undo_stack.current > 0) {
+            UndoEdit(&buffer);
+            steps++;
+        }
+        while (buffer.undo_stack.current < buffer.undo_stack.count) {
+            RedoEdit(&buffer);
+            steps++;
+        }
+    }
+    ReportBench("undo/redo storm", steps, GetWallTime() - start);
+
+    bool redo_ok = HashTextBuffer(&buffer) == edited_hash;
+    while (buffer.undo_stack.current > 0) {
+        UndoEdit(&buffer);
+    }
+    bool undo_ok = HashTextBuffer(&buffer) == original_hash;
+    if (!redo_ok || !undo_ok) {
+        fprintf(stderr, "undo/redo storm: text mismatch (redo %s, undo %s)\n", redo_ok ? "ok" : "FAILED", undo_ok ? "ok" : "FAILED");
+    }
+    ClearTextBuffer(&buffer);
+    return redo_ok && undo_ok;
+}
+
+// The oldest group of a full stack is dropped whole, so undoing everything left ends on the
+// text right after it rather than with part of it taken back
+bool BenchUndoEviction(const char* path) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    double current_time = 0;
+
+    BeginEditTransaction(&buffer);
+    for (size_t i = 0; i < 3; ++i) {
+        buffer.pointer_position = 0;
+        InsertTextAtPointer(&buffer, "group\n", 6, current_time);
+    }
+    EndEditTransaction(&buffer);
+    uint64_t grouped_hash = HashTextBuffer(&buffer);
+
+    size_t capacity = buffer.undo_stack.capacity;
+    for (size_t i = 0; i + 2 < capacity; ++i) {
+        current_time += 2.0;
+        buffer.pointer_position = GetTextSize(&buffer);
+        InsertTextAtPointer(&buffer, "fill\n", 5, current_time);
+    }
+    size_t count = buffer.undo_stack.count;
+    while (buffer.undo_stack.current > 0) {
+        UndoEdit(&buffer);
+    }
+
+    bool ok = count == capacity - 2 && HashTextBuffer(&buffer) == grouped_hash;
+    if (!ok) {
+        fprintf(stderr, "undo eviction: %zu entries left of %zu, text %s\n", count, capacity, HashTextBuffer(&buffer) == grouped_hash ? "ok" : "FAILED");
+    }
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// The line by line strncmp scan the old find command used, as a baseline
+size_t NaiveCountMatches(TextBuffer* buffer, const char* needle) {
+    size_t needle_length = strlen(needle);
+    size_t count = 0;
+    for (size_t i = 0; i < GetLineCount(buffer); ++i) {
+        char* line = GenerateLine(buffer, i);
+        size_t line_length = strlen(line);
+        for (size_t j = 0; j + needle_length <= line_length; ++j) {
+            if (strncmp(line + j, needle, needle_length) == 0) {
+                count++;
+                j += needle_length - 1;
+            }
+        }
+        free(line);
+    }
+    return count;
+}
+
+void BenchFind(const char* path) {
+    static const char* needles[] = { "e", "the", "Pierre", "Prince Andrew", "nonexistent needle" };
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    // Fragment the buffer so matches have to cross piece boundaries
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "the", 3);
+    }
+
+    MatchList matches;
+    InitMatchList(&matches);
+    for (size_t i = 0; i < ARRAY_LEN(needles); ++i) {
+        LiteralPattern pattern = {0};
+        InitLiteralPattern(&pattern, needles[i], strlen(needles[i]));
+        double start = GetWallTime();
+        FindAllLiteral(GetPieceView(&buffer), &pattern, &matches);
+        double elapsed = GetWallTime() - start;
+        printf("%-28s %9zu hits %9.3f ms %10.1f MB/s\n", needles[i], matches.count, elapsed * 1000.0, GetTextSize(&buffer) / elapsed / 1e6);
+        ClearLiteralPattern(&pattern);
+    }
+
+    double start = GetWallTime();
+    size_t naive_count = NaiveCountMatches(&buffer, "Pierre");
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu hits %9.3f ms %10.1f MB/s\n", "Pierre (line scan)", naive_count, elapsed * 1000.0, GetTextSize(&buffer) / elapsed / 1e6);
+
+    ClearMatchList(&matches);
+    ClearTextBuffer(&buffer);
+}
+
+// Replaces every needle in a flat copy of the text, what replace-all has to produce
+char* NaiveReplaceAll(const char* text, const char* needle, const char* replacement, size_t* out_length) {
+    size_t needle_length = strlen(needle);
+    size_t replacement_length = strlen(replacement);
+    size_t capacity = strlen(text) + 1;
+    char* out = malloc(capacity);
+    size_t length = 0;
+    for (const char* p = text; *p;) {
+        const char* piece = strncmp(p, needle, needle_length) == 0 ? replacement : p;
+        size_t piece_length = piece == replacement ? replacement_length : 1;
+        while (length + piece_length + 1 > capacity) {
+            capacity *= 2;
+            out = realloc(out, capacity);
+        }
+        memcpy(out + length, piece, piece_length);
+        length += piece_length;
+        p += piece == replacement ? needle_length : 1;
+    }
+    out[length] = '\0';
+    *out_length = length;
+    return out;
+}
+
+bool BenchReplaceAll(const char* path) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "the", 3);
+    }
+    uint64_t original_hash = HashTextBuffer(&buffer);
+    char* original = GetTextRange(&buffer, 0, GetTextSize(&buffer));
+
+    LiteralPattern pattern = {0};
+    InitLiteralPattern(&pattern, "the", 3);
+    MatchList matches;
+    InitMatchList(&matches);
+
+    double start = GetWallTime();
+    FindAllLiteral(GetPieceView(&buffer), &pattern, &matches);
+    size_t replaced = ReplaceAllMatches(&buffer, &matches, "THE END", 7);
+    ReportBench("replace all", replaced, GetWallTime() - start);
+    printf("%-28s %9zu pieces %9zu lines\n", "", buffer.piece_count, GetLineCount(&buffer));
+
+    size_t expected_length;
+    char* expected = NaiveReplaceAll(original, "the", "THE END", &expected_length);
+    char* result = GetTextRange(&buffer, 0, GetTextSize(&buffer));
+    bool replace_ok = expected_length == GetTextSize(&buffer) && memcmp(expected, result, expected_length) == 0;
+    uint64_t replaced_hash = HashTextBuffer(&buffer);
+
+    start = GetWallTime();
+    UndoEdit(&buffer);
+    bool undo_ok = HashTextBuffer(&buffer) == original_hash;
+    RedoEdit(&buffer);
+    bool redo_ok = HashTextBuffer(&buffer) == replaced_hash;
+    ReportBench("replace all undo + redo", 2, GetWallTime() - start);
+
+    if (!replace_ok || !undo_ok || !redo_ok) {
+        printf("replace all mismatch: replace %s undo %s redo %s\n", replace_ok ? "ok" : "FAILED", undo_ok ? "ok" : "FAILED", redo_ok ? "ok" : "FAILED");
+    }
+
+    free(result);
+    free(expected);
+    free(original);
+    ClearMatchList(&matches);
+    ClearLiteralPattern(&pattern);
+    ClearTextBuffer(&buffer);
+    return replace_ok && undo_ok && redo_ok;
+}
+
+// Types each query one key at a time and deletes it again, every keystroke gets one slice.
+// The finished match sets are checked against a fresh search.
+bool BenchIncrementalSearch(const char* path) {
+    static const char* queries[] = { "Prince Andrew", "nanana", "the Emperor" };
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "na", 2);
+    }
+
+    IncrementalSearch search;
+    InitIncrementalSearch(&search);
+    MatchList expected;
+    InitMatchList(&expected);
+    bool ok = true;
+    size_t keys = 0;
+    double worst = 0;
+    double start = GetWallTime();
+    for (size_t i = 0; i < ARRAY_LEN(queries); ++i) {
+        size_t length = strlen(queries[i]);
+        for (size_t step = 0; step < length * 2; ++step) {
+            size_t query_length = step < length ? step + 1 : length * 2 - step - 1;
+            double key_start = GetWallTime();
+            UpdateIncrementalSearch(&search, &buffer, queries[i], query_length);
+            StepIncrementalSearch(&search, &buffer, INCREMENTAL_SEARCH_SLICE_SIZE);
+            worst = max(worst, GetWallTime() - key_start);
+            keys++;
+            if (query_length == 0) continue;
+
+            while (!StepIncrementalSearch(&search, &buffer, INCREMENTAL_SEARCH_SLICE_SIZE));
+            LiteralPattern pattern = {0};
+            InitLiteralPattern(&pattern, queries[i], query_length);
+            FindAllLiteral(GetPieceView(&buffer), &pattern, &expected);
+            ClearLiteralPattern(&pattern);
+
+            const MatchList* matches = &GetIncrementalSearchStep(&search)->matches;
+            if (matches->count != expected.count || (expected.count > 0 && memcmp(matches->items, expected.items, expected.count * sizeof(Match)) != 0)) {
+                printf("incremental search mismatch for %.*s: %zu matches, expected %zu\n", (int)query_length, queries[i], matches->count, expected.count);
+                ok = false;
+            }
+        }
+    }
+    ReportBench("incremental search keys", keys, GetWallTime() - start);
+    printf("%-28s %9.3f ms worst keystroke\n", "", worst * 1000.0);
+
+    ClearMatchList(&expected);
+    ClearIncrementalSearch(&search);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// Scrolls a view over the buffer while editing it, the index has to agree with a full search
+// on every view
+bool BenchMatchIndex(const char* path, const char* query, bool regex, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    MatchIndex index;
+    InitMatchIndex(&index, &buffer, query, regex);
+    Regex full_regex = {0};
+    LiteralPattern full_pattern = {0};
+    if (regex) {
+        CompileRegex(&full_regex, query);
+    } else {
+        InitLiteralPattern(&full_pattern, query, strlen(query));
+    }
+    MatchList expected;
+    InitMatchList(&expected);
+
+    bool ok = true;
+    size_t view = 4096;
+    size_t position = 0;
+    double elapsed = 0;
+    for (size_t i = 0; i < ops && ok; ++i) {
+        // Mostly scroll a little, sometimes jump, sometimes type a word into the view
+        size_t action = BenchRandomBelow(10);
+        if (action == 0) {
+            position = BenchRandomBelow(GetTextSize(&buffer));
+        } else if (action < 8) {
+            position = min(position + BenchRandomBelow(view), GetTextSize(&buffer));
+        } else if (action == 8) {
+            InsertString(&buffer, min(position + BenchRandomBelow(view), GetTextSize(&buffer)), (char*)query, strlen(query) / 2 + 1);
+        } else {
+            DeleteRange(&buffer, min(position + BenchRandomBelow(view), GetTextSize(&buffer)), 1 + BenchRandomBelow(8));
+        }
+
+        size_t from = position;
+        size_t to = min(position + view, GetTextSize(&buffer));
+        double start = GetWallTime();
+        size_t count;
+        const Match* matches = QueryMatchIndex(&index, &buffer, from, to, &count);
+        elapsed += GetWallTime() - start;
+
+        if (regex) {
+            FindAllRegex(&full_regex, GetPieceView(&buffer), &expected);
+        } else {
+            FindAllLiteral(GetPieceView(&buffer), &full_pattern, &expected);
+        }
+        size_t first = 0;
+        while (first < expected.count && expected.items[first].start + max(expected.items[first].length, (size_t)1) <= from) first++;
+        size_t last = first;
+        while (last < expected.count && expected.items[last].start <= to) last++;
+        if (count != last - first || (count > 0 && memcmp(matches, expected.items + first, count * sizeof(Match)) != 0)) {
+            printf("match index mismatch for %s at %zu: %zu matches, expected %zu\n", query, from, count, last - first);
+            ok = false;
+        }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "match index %s", regex ? "regex" : "literal");
+    ReportBench(name, ops, elapsed);
+
+    ClearMatchList(&expected);
+    if (regex) {
+        ClearRegex(&full_regex);
+    } else {
+        ClearLiteralPattern(&full_pattern);
+    }
+    ClearMatchIndex(&index);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// The full count the status line shows, made once by the workers and then kept up to date
+// through the match index as the text is edited, against counting everything again
+bool BenchSearchCount(const char* path, const char* query, bool regex, size_t ops) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    MatchIndex index;
+    InitMatchIndex(&index, &buffer, query, regex);
+    Regex full_regex = {0};
+    LiteralPattern full_pattern = {0};
+    if (regex) {
+        CompileRegex(&full_regex, query);
+    } else {
+        InitLiteralPattern(&full_pattern, query, strlen(query));
+    }
+
+    MatchList counted;
+    InitMatchList(&counted);
+    ParallelSearch search;
+    double start = GetWallTime();
+    StartParallelSearch(&search, &buffer, query, regex, 0);
+    while (!IsParallelSearchDone(&search)) {
+        PollParallelSearch(&search, &counted);
+    }
+    double full_time = GetWallTime() - start;
+    CoverMatchIndex(&index, &counted, search.snapshot.view.text_size, buffer.revision);
+    ClearParallelSearch(&search);
+
+    MatchList expected;
+    InitMatchList(&expected);
+    bool ok = true;
+    double elapsed = 0;
+    for (size_t i = 0; i < ops && ok; ++i) {
+        size_t position = BenchRandomBelow(GetTextSize(&buffer));
+        if (BenchRandom() & 1) {
+            InsertString(&buffer, position, (char*)query, strlen(query) / 2 + 1);
+        } else {
+            DeleteRange(&buffer, position, min((size_t)1 + BenchRandomBelow(8), GetTextSize(&buffer) - position));
+        }
+
+        start = GetWallTime();
+        SyncMatchIndex(&index, &buffer);
+        size_t gaps = GetMatchIndexGaps(&index, 0, buffer.text_size + 1);
+        size_t count;
+        QueryMatchIndex(&index, &buffer, 0, buffer.text_size, &count);
+        elapsed += GetWallTime() - start;
+
+        if (regex) {
+            FindAllRegex(&full_regex, GetPieceView(&buffer), &expected);
+        } else {
+            FindAllLiteral(GetPieceView(&buffer), &full_pattern, &expected);
+        }
+        ok = gaps <= PARALLEL_SEARCH_RANGE_SIZE && index.matches.count == expected.count && memcmp(index.matches.items, expected.items, expected.count * sizeof(Match)) == 0;
+        if (!ok) {
+            printf("search count mismatch for %s after %zu edits: %zu matches, expected %zu\n", query, i + 1, index.matches.count, expected.count);
+        }
+    }
+    printf("%-28s %9.3f ms full count, %.3f ms per edit kept up to date\n", query, full_time * 1000.0, elapsed * 1000.0 / max(ops, (size_t)1));
+
+    ClearMatchList(&expected);
+    if (regex) {
+        ClearRegex(&full_regex);
+    } else {
+        ClearLiteralPattern(&full_pattern);
+    }
+    ClearMatchIndex(&index);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// Saves a heavily edited buffer and reads the file back
+bool BenchSave(const char* path) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    for (size_t i = 0; i < 10000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "fun\n", 1 + BenchRandomBelow(4));
+    }
+
+    const char* save_path = "bench_save.tmp";
+    double start = GetWallTime();
+    bool ok = SaveTextBuffer(&buffer, save_path);
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu pieces %8.3f ms %10.1f MB/s\n", "save", buffer.piece_count, elapsed * 1000.0, GetTextSize(&buffer) / elapsed / 1e6);
+
+    size_t length = 0;
+    char* saved = ok ? LoadFile(save_path, &length) : NULL;
+    char* expected = GetTextRange(&buffer, 0, GetTextSize(&buffer));
+    ok = saved && length == GetTextSize(&buffer) && memcmp(saved, expected, length) == 0;
+    if (!ok) {
+        printf("save mismatch: wrote %zu bytes, expected %zu\n", length, GetTextSize(&buffer));
+    }
+
+    free(saved);
+    free(expected);
+    remove(save_path);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// Keeps editing and asking for saves while one runs. The extra requests have to fold into a
+// single follow-up save that ends with the final text on disk.
+bool BenchBackgroundSave(const char* path) {
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    const char* save_path = "bench_save.tmp";
+    BackgroundSave save = {0};
+
+    double start = GetWallTime();
+    StartBackgroundSave(&save, &buffer, save_path);
+    double start_cost = GetWallTime() - start;
+
+    size_t saves = 0;
+    size_t edits = 0;
+    bool ok = true;
+    SaveState state;
+    while ((state = PollBackgroundSave(&save, &buffer)) != SAVE_IDLE) {
+        if (state == SAVE_FINISHED) saves++;
+        if (state == SAVE_FAILED) ok = false;
+        if (edits < 1000) {
+            InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "fun", 3);
+            StartBackgroundSave(&save, &buffer, save_path);
+            edits++;
+        }
+    }
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu saves  %8.3f ms %10.3f ms to start\n", "background save", saves, elapsed * 1000.0, start_cost * 1000.0);
+
+    size_t length = 0;
+    char* saved = LoadFile(save_path, &length);
+    char* expected = GetTextRange(&buffer, 0, GetTextSize(&buffer));
+    ok = ok && saved && length == GetTextSize(&buffer) && memcmp(saved, expected, length) == 0;
+    if (!ok) {
+        printf("background save mismatch: wrote %zu bytes, expected %zu\n", length, GetTextSize(&buffer));
+    }
+
+    free(saved);
+    free(expected);
+    remove(save_path);
+    ClearBackgroundSave(&save);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+#ifndef _WIN32
+// Edits a copy of the file in a child that dies without closing its journal, then opens the
+// copy again and checks the journal brings every edit back
+bool BenchJournal(const char* path, size_t ops) {
+    size_t size;
+    char* text = LoadFile(path, &size);
+    const char* copy_path = "bench_journal.tmp";
+    const char* journal_path = ".bench_journal.tmp.funwal";
+    FILE* file = fopen(copy_path, "wb");
+    int hash_pipe[2];
+    if (!text || !file || pipe(hash_pipe) != 0) {
+        fprintf(stderr, "Could not open file: %s\n", copy_path);
+        free(text);
+        if (file) fclose(file);
+        return false;
+    }
+    fwrite(text, 1, size, file);
+    fclose(file);
+    free(text);
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        TextBuffer buffer = {0};
+        InitTextBufferFromPath(&buffer, copy_path);
+        size_t recovered;
+        EditJournal* journal = OpenEditJournal(&buffer, buffer.revision, &recovered);
+
+        double start = GetWallTime();
+        for (size_t i = 0; i < ops; ++i) {
+            if (BenchRandomBelow(4) == 0) {
+                DeleteRange(&buffer, BenchRandomBelow(GetTextSize(&buffer)), 1 + BenchRandomBelow(8));
+            } else {
+                InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "fun", 3);
+            }
+        }
+        ReportBench("journaled edits", ops, GetWallTime() - start);
+
+        // A replace-all goes in as the whole text
+        LiteralPattern pattern = {0};
+        InitLiteralPattern(&pattern, "Pierre", 6);
+        MatchList matches;
+        InitMatchList(&matches);
+        FindAllLiteral(GetPieceView(&buffer), &pattern, &matches);
+        ReplaceAllMatches(&buffer, &matches, "Peter", 5);
+        InsertString(&buffer, 0, "after replace\n", 14);
+
+        uint64_t hash = journal ? HashTextBuffer(&buffer) : 0;
+        if (journal) {
+            FlushEditJournal(journal);
+        }
+        ssize_t written = write(hash_pipe[1], &hash, sizeof(hash));
+        fflush(stdout);
+        _exit(written == sizeof(hash) ? 0 : 1);
+    }
+
+    close(hash_pipe[1]);
+    uint64_t expected_hash = 0;
+    bool ok = read(hash_pipe[0], &expected_hash, sizeof(expected_hash)) == sizeof(expected_hash) && expected_hash != 0;
+    close(hash_pipe[0]);
+    int status;
+    waitpid(child, &status, 0);
+
+    // A record torn by the crash has to be ignored
+    file = fopen(journal_path, "ab");
+    if (file) {
+        fwrite("torn", 1, 4, file);
+        fclose(file);
+    }
+
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, copy_path);
+    size_t recovered = 0;
+    double start = GetWallTime();
+    EditJournal* journal = OpenEditJournal(&buffer, buffer.revision, &recovered);
+    double elapsed = GetWallTime() - start;
+    struct stat journal_stat;
+    size_t journal_size = stat(journal_path, &journal_stat) == 0 ? journal_stat.st_size : 0;
+    printf("%-28s %9zu edits %8.3f ms %10zu B journal\n", "journal recovery", recovered, elapsed * 1000.0, journal_size);
+
+    ok = ok && journal && HashTextBuffer(&buffer) == expected_hash;
+    if (!ok) {
+        fprintf(stderr, "journal recovery: text differs from what the crashed editor had\n");
+    }
+
+    // Once saved the journal holds no edits, and a clean close removes it
+    ok = ok && SaveTextBuffer(&buffer, copy_path) && RebaseEditJournal(journal, &buffer, buffer.revision);
+    ok = ok && stat(journal_path, &journal_stat) == 0 && journal_stat.st_size == sizeof(JournalHeader);
+    CloseEditJournal(journal, &buffer);
+    ok = ok && stat(journal_path, &journal_stat) != 0;
+
+    remove(copy_path);
+    remove(journal_path);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+#endif
+
+bool BenchWriteFile(const char* path, const char* text, size_t length, const char* mode) {
+    FILE* file = fopen(path, mode);
+    if (!file) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(text, 1, length, file) == length;
+    return fclose(file) == 0 && ok;
+}
+
+bool BenchBufferMatches(TextBuffer* buffer, const char* text, size_t length) {
+    char* current = GetTextRange(buffer, 0, GetTextSize(buffer));
+    bool ok = GetTextSize(buffer) == length && memcmp(current, text, length) == 0;
+    free(current);
+    return ok;
+}
+
+// A CRLF copy of the file has to load without its CRs and save back byte for byte
+bool BenchCrlfSave(const char* path) {
+    size_t size;
+    char* text = LoadFile(path, &size);
+    if (!text) return false;
+    size = StripCarriageReturns(text, size, NULL);
+    char* crlf = malloc(size * 2 + 1);
+    size_t crlf_size = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (text[i] == '\n') {
+            crlf[crlf_size++] = '\r';
+        }
+        crlf[crlf_size++] = text[i];
+    }
+    const char* crlf_path = "bench_crlf.tmp";
+    bool ok = BenchWriteFile(crlf_path, crlf, crlf_size, "wb");
+
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, crlf_path);
+    ok = ok && buffer.line_ending == LINE_ENDING_CRLF && BenchBufferMatches(&buffer, text, size);
+
+    double start = GetWallTime();
+    ok = ok && SaveTextBuffer(&buffer, crlf_path);
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu bytes  %8.3f ms %10.1f MB/s\n", "save crlf", crlf_size, elapsed * 1000.0, crlf_size / elapsed / 1e6);
+
+    size_t length = 0;
+    char* saved = ok ? LoadFile(crlf_path, &length) : NULL;
+    ok = saved && length == crlf_size && memcmp(saved, crlf, length) == 0;
+    if (!ok) {
+        printf("crlf save mismatch: wrote %zu bytes, expected %zu\n", length, crlf_size);
+    }
+
+    free(saved);
+    free(crlf);
+    free(text);
+    remove(crlf_path);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+#define BENCH_HEX_SIZE (32 << 20)
+
+// Random bytes with a marker planted twice. Rows have to show the bytes, searches have to find
+// the markers in order and wrap round, also when every step is cut short of a whole marker.
+bool BenchHexView(const char* path, size_t ops) {
+    const char marker[] = "\x7f" "ELF\0\x01" "FUNHEX";
+    size_t marker_length = sizeof(marker) - 1;
+    char* data = malloc(BENCH_HEX_SIZE);
+    for (size_t i = 0; i < BENCH_HEX_SIZE; i += sizeof(uint64_t)) {
+        uint64_t value = BenchRandom();
+        memcpy(data + i, &value, sizeof(value));
+    }
+    size_t first = 100;
+    size_t second = BENCH_HEX_SIZE - 1000;
+    memcpy(data + first, marker, marker_length);
+    memcpy(data + second, marker, marker_length);
+
+    const char* hex_path = "bench_hex.tmp";
+    bool ok = BenchWriteFile(hex_path, data, BENCH_HEX_SIZE, "wb");
+    ok = ok && IsBinaryFile(hex_path) && !IsBinaryFile(path);
+    if (!ok) {
+        printf("binary detection failed\n");
+    }
+
+    // A binary file loaded as text keeps all its bytes
+    TextBuffer buffer = {0};
+    char* copy = malloc(4096 + 1);
+    memcpy(copy, data, 4096);
+    InitTextBufferFromData(&buffer, hex_path, copy, 4096);
+    ok = ok && BenchBufferMatches(&buffer, data, 4096);
+    ClearTextBuffer(&buffer);
+
+    HexView view;
+    bool opened = ok && OpenHexView(&view, hex_path);
+    ok = opened;
+
+    char row[HEX_ROW_LENGTH + 1];
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops && ok; ++i) {
+        size_t offset = BenchRandomBelow(BENCH_HEX_SIZE);
+        JumpToHexOffset(&view, offset);
+        size_t count = FormatHexRow(&view, view.top, row, sizeof(row));
+        ok = view.top == offset - offset % HEX_ROW_BYTES && count == min((size_t)HEX_ROW_BYTES, BENCH_HEX_SIZE - (size_t)view.top);
+        for (size_t byte = 0; byte < count && ok; ++byte) {
+            unsigned value = 0;
+            ok = sscanf(row + GetHexByteColumn(&view, byte, false), "%2x", &value) == 1 && value == (unsigned char)data[view.top + byte];
+        }
+    }
+    if (ok) ReportBench("hex jump and format row", ops, GetWallTime() - start);
+
+    size_t expected[] = { first, second, first };
+    uint64_t budgets[] = { HEX_SEARCH_STEP, 5, HEX_SEARCH_STEP };
+    if (ok) JumpToHexOffset(&view, 0);
+    for (size_t i = 0; i < ARRAY_LEN(expected) && ok; ++i) {
+        // Short steps from just before the second marker, so one has to straddle it
+        if (budgets[i] < HEX_SEARCH_STEP) JumpToHexOffset(&view, second - 64);
+        ok = StartHexSearch(&view, marker, marker_length);
+        HexSearchResult result = HEX_SEARCH_RUNNING;
+        while (result == HEX_SEARCH_RUNNING) {
+            result = UpdateHexSearch(&view, budgets[i]);
+        }
+        ok = ok && result == HEX_SEARCH_FOUND && view.cursor == expected[i] && view.match_length == marker_length;
+        if (!ok) {
+            printf("hex search %zu found 0x%llx, expected 0x%zx\n", i, (unsigned long long)view.cursor, expected[i]);
+        }
+    }
+
+    char* missing;
+    size_t missing_length;
+    ok = ok && ParseHexPattern("de ad be ef ca fe ba be 00 11 22 33", &missing, &missing_length) && missing_length == 12;
+    if (ok) {
+        ok = StartHexSearch(&view, missing, missing_length);
+        start = GetWallTime();
+        HexSearchResult result = HEX_SEARCH_RUNNING;
+        while (result == HEX_SEARCH_RUNNING) {
+            result = UpdateHexSearch(&view, HEX_SEARCH_STEP);
+        }
+        double elapsed = GetWallTime() - start;
+        printf("%-28s %9zu bytes  %8.3f ms %10.1f MB/s\n", "hex search whole file", (size_t)BENCH_HEX_SIZE, elapsed * 1000.0, BENCH_HEX_SIZE / elapsed / 1e6);
+        ok = ok && result == HEX_SEARCH_NOT_FOUND;
+        free(missing);
+    }
+
+    if (opened) {
+        CloseHexView(&view);
+    }
+    remove(hex_path);
+    free(data);
+    return ok;
+}
+
+#define BENCH_LOAD_FILES 2000
+
+typedef struct {
+    const char* text;
+    size_t chunk;
+    size_t size;
+    size_t delivered;
+    bool ok;
+} BenchLoadCheck;
+
+static void BenchCheckLoadedFile(void* context, size_t index, char* data, size_t length) {
+    BenchLoadCheck* check = context;
+    size_t start = min(index * check->chunk, check->size);
+    size_t expected = min(check->chunk, check->size - start);
+    check->ok = check->ok && data && length == expected && memcmp(data, check->text + start, length) == 0;
+    check->delivered++;
+    free(data);
+}
+
+// Splits the file into many small ones, like a source tree, and reads them back one by one,
+// through io_uring and on the thread pool. The files are in the page cache after writing,
+// so this measures the syscall cost per file rather than the disk.
+bool BenchFileLoad(const char* path) {
+    size_t size;
+    char* text = LoadFile(path, &size);
+    if (!text) return false;
+    size_t chunk = size / BENCH_LOAD_FILES + 1;
+    char** paths = malloc(BENCH_LOAD_FILES * sizeof(char*));
+    bool ok = true;
+    for (size_t i = 0; i < BENCH_LOAD_FILES; ++i) {
+        paths[i] = malloc(32);
+        snprintf(paths[i], 32, "bench_load_%04zu.tmp", i);
+        size_t start = min(i * chunk, size);
+        ok = BenchWriteFile(paths[i], text + start, min(chunk, size - start), "wb") && ok;
+    }
+
+    BenchLoadCheck check = { text, chunk, size, 0, ok };
+    double start = GetWallTime();
+    for (size_t i = 0; i < BENCH_LOAD_FILES; ++i) {
+        size_t length = 0;
+        char* data = LoadFile(paths[i], &length);
+        BenchCheckLoadedFile(&check, i, data, length);
+    }
+    ReportBench("load files one by one", BENCH_LOAD_FILES, GetWallTime() - start);
+
+    check.delivered = 0;
+    start = GetWallTime();
+    if (LoadFilesWithUring((const char* const*)paths, BENCH_LOAD_FILES, BenchCheckLoadedFile, &check)) {
+        ReportBench("load files io_uring", BENCH_LOAD_FILES, GetWallTime() - start);
+        check.ok = check.ok && check.delivered == BENCH_LOAD_FILES;
+    } else {
+        printf("%-28s unavailable\n", "load files io_uring");
+    }
+
+    check.delivered = 0;
+    start = GetWallTime();
+    LoadFilesWithThreads((const char* const*)paths, BENCH_LOAD_FILES, BenchCheckLoadedFile, &check);
+    ReportBench("load files thread pool", BENCH_LOAD_FILES, GetWallTime() - start);
+    check.ok = check.ok && check.delivered == BENCH_LOAD_FILES;
+
+    if (!check.ok) {
+        printf("loaded files do not match what was written\n");
+    }
+    for (size_t i = 0; i < BENCH_LOAD_FILES; ++i) {
+        remove(paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    free(text);
+    return check.ok;
+}
+
+#define BENCH_TREE_DIRS 8
+#define BENCH_TREE_FILES 16
+
+static bool BenchMakeDir(const char* path) {
+#ifdef _WIN32
+    return _mkdir(path) == 0;
+#else
+    return mkdir(path, 0755) == 0;
+#endif
+}
+
+// Nodes reachable from node, every child's path has to be its parent's path and its name
+static size_t BenchCheckTreeNode(FileTree* tree, size_t index, bool* ok) {
+    char path[FILE_TREE_PATH_MAX];
+    char child_path[FILE_TREE_PATH_MAX];
+    size_t path_length = GetFileTreePath(tree, index, path, sizeof(path));
+    size_t reached = 1;
+    for (size_t i = 0; i < tree->child_counts[index]; ++i) {
+        size_t child = tree->children[tree->child_starts[index] + i];
+        const char* name = GetFileTreeName(tree, child);
+        size_t child_length = GetFileTreePath(tree, child, child_path, sizeof(child_path));
+        *ok = *ok && tree->parents[child] == index && child_length == path_length + 1 + strlen(name)
+            && memcmp(child_path, path, path_length) == 0 && strcmp(child_path + path_length + 1, name) == 0;
+        reached += BenchCheckTreeNode(tree, child, ok);
+    }
+    return reached;
+}
+
+static FileTree* BenchWaitForFileTree(FileCache* cache) {
+    while (cache->walking && !__atomic_load_n(&cache->walk_done, __ATOMIC_ACQUIRE)) {
+#ifdef _WIN32
+        Sleep(1);
+#else
+        usleep(100);
+#endif
+    }
+    return GetFileTree(cache);
+}
+
+#ifdef __linux__
+static bool BenchHasTreePath(FileTree* tree, const char* path) {
+    size_t index = tree->root_index;
+    char part[256];
+    while (*path && index != SIZE_MAX) {
+        size_t length = strcspn(path, "/");
+        snprintf(part, sizeof(part), "%.*s", (int)length, path);
+        index = FindFileTreeChild(tree, index, part);
+        path += length + (path[length] == '/');
+    }
+    return index != SIZE_MAX;
+}
+
+// Changes on disk have to be patched into the tree that is there, without walking it again,
+// and an update with nothing changed has to be next to free
+static bool BenchFileTreeChanges(FileCache* cache, const char* root, size_t dirs, size_t files) {
+    FileTree* tree = GetFileTree(cache);
+    size_t idle_updates = 10000;
+    double start = GetWallTime();
+    for (size_t i = 0; i < idle_updates; ++i) {
+        UpdateFileCache(cache, cache->last_scan_time);
+    }
+    ReportBench("file tree idle update", idle_updates, GetWallTime() - start);
+    bool ok = GetFileTree(cache) == tree && !cache->walking;
+
+    char path[256];
+    char other[256];
+    snprintf(path, sizeof(path), "%s/new.txt", root);
+    ok = BenchWriteFile(path, "x", 1, "wb") && ok;
+    snprintf(path, sizeof(path), "%s/made", root);
+    ok = BenchMakeDir(path) && ok;
+    snprintf(path, sizeof(path), "%s/made/deep", root);
+    ok = BenchMakeDir(path) && ok;
+    snprintf(path, sizeof(path), "%s/made/deep/x.c", root);
+    ok = BenchWriteFile(path, "x", 1, "wb") && ok;
+    snprintf(path, sizeof(path), "%s/top_1.txt", root);
+    snprintf(other, sizeof(other), "%s/dir_0/moved.txt", root);
+    ok = rename(path, other) == 0 && ok;
+    snprintf(path, sizeof(path), "%s/top_2.txt", root);
+    ok = remove(path) == 0 && ok;
+    snprintf(path, sizeof(path), "%s/dir_1", root);
+    snprintf(other, sizeof(other), "%s/dir_renamed", root);
+    ok = rename(path, other) == 0 && ok;
+
+    start = GetWallTime();
+    UpdateFileCache(cache, cache->last_scan_time);
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9d changes  %6.3f ms\n", "file tree patch", 7, elapsed * 1000.0);
+
+    bool linked = true;
+    ok = ok && GetFileTree(cache) == tree && !cache->walking;
+    ok = ok && tree->dir_count == dirs + 2 && tree->file_count == files + 1;
+    ok = ok && BenchCheckTreeNode(tree, tree->root_index, &linked) == tree->count - tree->detached_count && linked;
+    ok = ok && BenchHasTreePath(tree, "new.txt") && BenchHasTreePath(tree, "made/deep/x.c") && BenchHasTreePath(tree, "dir_0/moved.txt");
+    ok = ok && BenchHasTreePath(tree, "dir_renamed/sub_3/file_5.c") && !BenchHasTreePath(tree, "dir_1");
+    ok = ok && !BenchHasTreePath(tree, "top_1.txt") && !BenchHasTreePath(tree, "top_2.txt");
+    if (!ok) {
+        printf("file tree changes not patched in: %zu directories and %zu files\n", tree->dir_count, tree->file_count);
+    }
+
+    // Back to what the caller made, so it removes everything
+    snprintf(path, sizeof(path), "%s/dir_renamed", root);
+    snprintf(other, sizeof(other), "%s/dir_1", root);
+    rename(path, other);
+    snprintf(path, sizeof(path), "%s/dir_0/moved.txt", root);
+    snprintf(other, sizeof(other), "%s/top_1.txt", root);
+    rename(path, other);
+    snprintf(path, sizeof(path), "%s/top_2.txt", root);
+    BenchWriteFile(path, "x", 1, "wb");
+    const char* made[] = { "new.txt", "made/deep/x.c", "made/deep", "made" };
+    for (size_t i = 0; i < ARRAY_LEN(made); ++i) {
+        snprintf(path, sizeof(path), "%s/%s", root, made[i]);
+        remove(path);
+    }
+    return ok;
+}
+#endif
+
+// A directory of directories of files, with a hidden directory and node_modules left out. The
+// walk has to find all the rest and link them up, on one thread and on all of them.
+bool BenchFileTree() {
+    const char* root = "bench_tree.tmp";
+    size_t path_capacity = 4 + BENCH_TREE_DIRS * (BENCH_TREE_DIRS + 1) * (BENCH_TREE_FILES + 1) + BENCH_TREE_FILES + 4;
+    char** paths = malloc(path_capacity * sizeof(char*));
+    size_t path_count = 0;
+    char path[256];
+    bool ok = BenchMakeDir(root);
+    paths[path_count++] = strdup(root);
+
+    const char* skipped[] = { ".hidden", "node_modules" };
+    for (size_t i = 0; i < ARRAY_LEN(skipped) && ok; ++i) {
+        snprintf(path, sizeof(path), "%s/%s", root, skipped[i]);
+        ok = BenchMakeDir(path);
+        paths[path_count++] = strdup(path);
+        snprintf(path, sizeof(path), "%s/%s/left_out.txt", root, skipped[i]);
+        ok = ok && BenchWriteFile(path, "x", 1, "wb");
+        paths[path_count++] = strdup(path);
+    }
+    for (size_t i = 0; i < BENCH_TREE_FILES && ok; ++i) {
+        snprintf(path, sizeof(path), "%s/top_%zu.txt", root, i);
+        ok = BenchWriteFile(path, "x", 1, "wb");
+        paths[path_count++] = strdup(path);
+    }
+    for (size_t i = 0; i < BENCH_TREE_DIRS && ok; ++i) {
+        snprintf(path, sizeof(path), "%s/dir_%zu", root, i);
+        ok = BenchMakeDir(path);
+        paths[path_count++] = strdup(path);
+        for (size_t j = 0; j < BENCH_TREE_DIRS && ok; ++j) {
+            snprintf(path, sizeof(path), "%s/dir_%zu/sub_%zu", root, i, j);
+            ok = BenchMakeDir(path);
+            paths[path_count++] = strdup(path);
+            for (size_t k = 0; k < BENCH_TREE_FILES && ok; ++k) {
+                snprintf(path, sizeof(path), "%s/dir_%zu/sub_%zu/file_%zu.c", root, i, j, k);
+                ok = BenchWriteFile(path, "x", 1, "wb");
+                paths[path_count++] = strdup(path);
+            }
+        }
+    }
+    size_t expected_dirs = 1 + BENCH_TREE_DIRS + BENCH_TREE_DIRS * BENCH_TREE_DIRS;
+    size_t expected_files = BENCH_TREE_FILES + BENCH_TREE_DIRS * BENCH_TREE_DIRS * BENCH_TREE_FILES;
+#ifndef _WIN32
+    // Links are followed, one that leads nowhere is left out and a linked directory is not
+    // walked, a link back to the root would never end
+    const char* links[][2] = { { "top_0.txt", "link.txt" }, { "missing.txt", "dangling.txt" }, { ".", "loop" } };
+    for (size_t i = 0; i < ARRAY_LEN(links) && ok; ++i) {
+        snprintf(path, sizeof(path), "%s/%s", root, links[i][1]);
+        ok = symlink(links[i][0], path) == 0;
+        paths[path_count++] = strdup(path);
+    }
+    expected_files++;
+    expected_dirs++;
+#endif
+
+    // At least a few walkers so stealing is exercised on small machines too
+    size_t thread_counts[] = { 1, max(GetProcessorCount(), (size_t)4) };
+    for (size_t t = 0; t < ARRAY_LEN(thread_counts) && ok; ++t) {
+        FileCache cache;
+        double start = GetWallTime();
+        ok = InitFileCache(&cache, root, thread_counts[t]);
+        FileTree* tree = BenchWaitForFileTree(&cache);
+        double elapsed = GetWallTime() - start;
+        char name[64];
+        snprintf(name, sizeof(name), "file tree walk x%zu", thread_counts[t]);
+        printf("%-28s %9zu nodes  %8.3f ms\n", name, tree ? tree->count : 0, elapsed * 1000.0);
+
+        ok = ok && tree && tree->dir_count == expected_dirs && tree->file_count == expected_files;
+        bool linked = ok;
+        ok = ok && BenchCheckTreeNode(tree, tree->root_index, &linked) == tree->count && linked;
+
+        // A later walk swaps in a new tree of the same files
+        UpdateFileCache(&cache, cache.last_scan_time);
+        ok = ok && StartFileCacheWalk(&cache, GetWallTime());
+        FileTree* next = BenchWaitForFileTree(&cache);
+        UpdateFileCache(&cache, cache.last_scan_time);
+        ok = ok && next != tree && next->count == expected_dirs + expected_files && !cache.walking;
+        if (!ok) {
+            printf("file tree walk found %zu directories and %zu files, expected %zu and %zu\n",
+                tree ? tree->dir_count : 0, tree ? tree->file_count : 0, expected_dirs, expected_files);
+        }
+#ifdef __linux__
+        if (ok && cache.watch_fd >= 0) {
+            ok = BenchFileTreeChanges(&cache, root, expected_dirs, expected_files);
+        }
+#endif
+        ClearFileCache(&cache);
+    }
+
+    for (size_t i = path_count; i > 0; --i) {
+#ifdef _WIN32
+        if (remove(paths[i - 1]) != 0) _rmdir(paths[i - 1]);
+#else
+        remove(paths[i - 1]);
+#endif
+        free(paths[i - 1]);
+    }
+    free(paths);
+    return ok;
+}
+
+// Another program appends to the file and then rewrites a few of its lines. The watcher has
+// to notice both, the append has to come in as one piece and the rewrite as a few hunks.
+bool BenchFileReload(const char* path) {
+    size_t size;
+    char* text = LoadFile(path, &size);
+    const char* copy_path = "bench_reload.tmp";
+    if (!text || !BenchWriteFile(copy_path, text, size, "wb")) {
+        free(text);
+        return false;
+    }
+    size = StripCarriageReturns(text, size, NULL);
+
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, copy_path);
+    FileWatcher watcher;
+    InitFileWatcher(&watcher);
+    FileWatch* watch = WatchFile(&watcher, 0, &buffer, buffer.revision);
+
+    char appended[1024];
+    for (size_t i = 0; i < sizeof(appended); ++i) {
+        appended[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    }
+    bool ok = BenchWriteFile(copy_path, appended, sizeof(appended), "ab");
+    size_t pieces = buffer.piece_count;
+    FileReload reload;
+    double start = GetWallTime();
+    ok = ok && (watcher.fd < 0 || PollFileWatcher(&watcher) == 1) && HasFileChanged(watch) && ReloadTextBuffer(&buffer, watch, &reload);
+    double elapsed = GetWallTime() - start;
+    printf("%-28s %9zu B    %8.3f ms %10zu new pieces\n", "reload appended", reload.inserted, elapsed * 1000.0, buffer.piece_count - pieces);
+    ok = ok && reload.appended && reload.inserted == sizeof(appended);
+
+    // Rewrites a line in every few thousand and drops another, through a rename like most editors
+    text = realloc(text, size + sizeof(appended));
+    memcpy(text + size, appended, sizeof(appended));
+    size += sizeof(appended);
+    char* rewritten = malloc(size + size / 64 + 64);
+    size_t rewritten_size = 0;
+    size_t line = 0;
+    for (size_t position = 0; position < size; ++line) {
+        const char* newline = memchr(text + position, '\n', size - position);
+        size_t end = newline ? (size_t)(newline - text) + 1 : size;
+        if (line % 4000 == 1000) {
+            rewritten_size += sprintf(rewritten + rewritten_size, "line %zu rewritten\n", line);
+        } else if (line % 4000 != 3000) {
+            memcpy(rewritten + rewritten_size, text + position, end - position);
+            rewritten_size += end - position;
+        }
+        position = end;
+    }
+    const char* temp_path = "bench_reload.tmp.new";
+    ok = ok && BenchWriteFile(temp_path, rewritten, rewritten_size, "wb") && rename(temp_path, copy_path) == 0;
+
+    uint64_t before_hash = HashTextBuffer(&buffer);
+    start = GetWallTime();
+    ok = ok && (watcher.fd < 0 || PollFileWatcher(&watcher) == 1) && HasFileChanged(watch) && ReloadTextBuffer(&buffer, watch, &reload);
+    elapsed = GetWallTime() - start;
+    printf("%-28s %9zu hunks %8.3f ms %10zu lines\n", "reload rewritten", reload.hunks, elapsed * 1000.0, line);
+    ok = ok && !reload.appended && reload.hunks <= line / 4000 * 2 + 2 && BenchBufferMatches(&buffer, rewritten, rewritten_size);
+
+    // The whole reload is one undo step
+    UndoEdit(&buffer);
+    ok = ok && HashTextBuffer(&buffer) == before_hash;
+    if (!ok) {
+        fprintf(stderr, "file reload: buffer does not match the file\n");
+    }
+
+    free(rewritten);
+    free(text);
+    remove(copy_path);
+    ClearFileWatcher(&watcher);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// A log written at 50 MB/s, taken in once per 60 Hz frame. Every frame has to fit in the budget.
+// With journaled set the log has a crash journal, which should get none of the appends and is
+// reset the way the editor does it.
+bool BenchTailFollow(const char* path, bool journaled) {
+    const char* log_path = "bench_tail.tmp";
+    const char* journal_path = ".bench_tail.tmp.funwal";
+    size_t size;
+    char* text = LoadFile(path, &size);
+    if (!text || !BenchWriteFile(log_path, text, size, "wb")) {
+        free(text);
+        return false;
+    }
+    free(text);
+
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, log_path);
+    GetLineCount(&buffer);
+    FileWatcher watcher;
+    InitFileWatcher(&watcher);
+    FileWatch* watch = WatchFile(&watcher, 0, &buffer, buffer.revision);
+    watch->follow = true;
+    size_t recovered;
+    EditJournal* journal = journaled ? OpenEditJournal(&buffer, buffer.revision, &recovered) : NULL;
+    bool ok = !journaled || journal;
+
+    size_t frame_size = 50000000 / 60;
+    char* lines = malloc(frame_size);
+    for (size_t i = 0; i < frame_size; ++i) {
+        lines[i] = i % 100 == 99 ? '\n' : 'a' + i % 26;
+    }
+
+    size_t frames = 30;
+    double worst = 0;
+    double total = 0;
+    for (size_t frame = 0; frame < frames && ok; ++frame) {
+        ok = BenchWriteFile(log_path, lines, frame_size, "ab");
+        double start = GetWallTime();
+        if (watcher.fd < 0 || PollFileWatcher(&watcher) > 0) {
+            FileReload reload;
+            watch->changed = false;
+            ok = ok && FollowFile(watch, &buffer, &reload);
+        }
+        // What the frame then draws needs the new lines
+        GetLineCount(&buffer);
+        IndexToPosition(&buffer, GetTextSize(&buffer));
+        // More often than the editor's once a second, so a short run sees a few
+        if (journal && frame % 10 == 4) {
+            ok = ok && ResetEditJournal(journal, &buffer);
+        }
+        double elapsed = GetWallTime() - start;
+        worst = max(worst, elapsed);
+        total += elapsed;
+    }
+    printf("%-28s %9zu frames %7.3f ms %10.3f ms worst frame\n", journaled ? "tail follow journaled" : "tail follow 50 MB/s", frames, total * 1000.0 / frames, worst * 1000.0);
+
+    char* expected = LoadFile(log_path, &size);
+    ok = ok && expected && watch->identity.size == size && BenchBufferMatches(&buffer, expected, strlen(expected)) && buffer.undo_stack.count == 0;
+    ok = ok && GetLineCount(&buffer) == (size_t)(IndexToPosition(&buffer, GetTextSize(&buffer)).y + 1);
+    if (!ok) {
+        fprintf(stderr, "tail follow: buffer does not match the log\n");
+    }
+    if (journal) {
+        // The frames since the last reset added nothing to the header, and a clean close removes it
+        FlushEditJournal(journal);
+        struct stat journal_stat;
+        bool reset = stat(journal_path, &journal_stat) == 0 && journal_stat.st_size == sizeof(JournalHeader) && ResetEditJournal(journal, &buffer);
+        CloseEditJournal(journal, &buffer);
+        if (!reset || stat(journal_path, &journal_stat) == 0) {
+            fprintf(stderr, "tail follow: the journal took in the appends\n");
+            ok = false;
+        }
+    }
+
+    free(expected);
+    free(lines);
+    remove(log_path);
+    ClearFileWatcher(&watcher);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// Recursive backtracking over the same NFA, the baseline the lazy DFA is measured against
+bool BacktrackRegex(const RegexProgram* program, int node, const char* text, size_t length, size_t position, size_t* end) {
+    const RegexNode* current = &program->nodes[node];
+    switch (current->type) {
+        case REGEX_NODE_SET:
+            return position < length && RegexSetHas(current->set, text[position]) && BacktrackRegex(program, current->out, text, length, position + 1, end);
+        case REGEX_NODE_SPLIT:
+            return BacktrackRegex(program, current->out, text, length, position, end) || BacktrackRegex(program, current->out1, text, length, position, end);
+        case REGEX_NODE_BOL:
+            return (position == 0 || text[position - 1] == '\n') && BacktrackRegex(program, current->out, text, length, position, end);
+        case REGEX_NODE_EOL:
+            return (position == length || text[position] == '\n') && BacktrackRegex(program, current->out, text, length, position, end);
+        case REGEX_NODE_MATCH:
+            *end = position;
+            return true;
+    }
+    return false;
+}
+
+size_t BacktrackCountMatches(const RegexProgram* program, const char* text, size_t length) {
+    size_t count = 0;
+    size_t position = 0;
+    while (position <= length) {
+        size_t end;
+        size_t start = position;
+        while (start <= length && !BacktrackRegex(program, program->anchored_start, text, length, start, &end)) {
+            start++;
+        }
+        if (start > length) break;
+        count++;
+        position = end > start ? end : end + 1;
+    }
+    return count;
+}
+
+bool BenchRegex(const char* path) {
+    static const char* patterns[] = { "Pierre|Natasha|Andrew", "[A-Z][a-z]+ [A-Z][a-z]+", "^CHAPTER [IVXLC]+$", "\\d{4}", "\\w+ing ", "q[^u]" };
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, path);
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "the", 3);
+    }
+    size_t size = GetTextSize(&buffer);
+    char* text = malloc(size + 1);
+    CopyTextRange(&buffer, 0, size, text);
+
+    bool ok = true;
+    MatchList matches;
+    InitMatchList(&matches);
+    for (size_t i = 0; i < ARRAY_LEN(patterns); ++i) {
+        Regex regex;
+        if (!CompileRegex(&regex, patterns[i])) {
+            fprintf(stderr, "regex %s: %s\n", patterns[i], regex.error);
+            ok = false;
+            continue;
+        }
+
+        double start = GetWallTime();
+        FindAllRegex(&regex, GetPieceView(&buffer), &matches);
+        double elapsed = GetWallTime() - start;
+        printf("%-28s %9zu hits %9.3f ms %10.1f MB/s\n", patterns[i], matches.count, elapsed * 1000.0, size / elapsed / 1e6);
+
+        start = GetWallTime();
+        size_t backtrack_count = BacktrackCountMatches(&regex.forward.program, text, size);
+        elapsed = GetWallTime() - start;
+        printf("%-28s %9zu hits %9.3f ms %10.1f MB/s\n", "  backtracking", backtrack_count, elapsed * 1000.0, size / elapsed / 1e6);
+
+        if (backtrack_count != matches.count) {
+            fprintf(stderr, "regex %s: lazy DFA and backtracking disagree\n", patterns[i]);
+            ok = false;
+        }
+        ClearRegex(&regex);
+    }
+
+    ClearMatchList(&matches);
+    free(text);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+// long_match puts a match of that many bytes across the end of the first range
+bool BenchParallelSearch(const char* path, const char* query, bool regex, size_t long_match) {
+    // A file made of several copies so every worker gets a few ranges of original text
+    size_t size;
+    char* text = LoadFile(path, &size);
+    char big_path[] = "bench_parallel.tmp";
+    FILE* file = fopen(big_path, "wb");
+    if (!text || !file) {
+        fprintf(stderr, "Could not open file: %s\n", big_path);
+        free(text);
+        return false;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        fwrite(text, 1, size, file);
+    }
+    fclose(file);
+    free(text);
+
+    TextBuffer buffer = {0};
+    InitTextBufferFromPath(&buffer, big_path);
+    remove(big_path);
+    for (size_t i = 0; i < 1000; ++i) {
+        InsertString(&buffer, BenchRandomBelow(GetTextSize(&buffer) + 1), "the", 3);
+    }
+    if (long_match >= 2) {
+        char* run = malloc(long_match);
+        memset(run, 'x', long_match);
+        run[0] = '<';
+        run[long_match - 1] = '>';
+        InsertString(&buffer, PARALLEL_SEARCH_RANGE_SIZE - long_match / 2, run, long_match);
+        free(run);
+    }
+
+    MatchList sequential;
+    InitMatchList(&sequential);
+    double start = GetWallTime();
+    if (regex) {
+        Regex compiled;
+        CompileRegex(&compiled, query);
+        FindAllRegex(&compiled, GetPieceView(&buffer), &sequential);
+        ClearRegex(&compiled);
+    } else {
+        LiteralPattern pattern = {0};
+        InitLiteralPattern(&pattern, query, strlen(query));
+        FindAllLiteral(GetPieceView(&buffer), &pattern, &sequential);
+        ClearLiteralPattern(&pattern);
+    }
+    double sequential_time = GetWallTime() - start;
+
+    MatchList parallel;
+    InitMatchList(&parallel);
+    ParallelSearch search;
+    start = GetWallTime();
+    StartParallelSearch(&search, &buffer, query, regex, 0);
+    double first_hit_time = 0;
+    while (!IsParallelSearchDone(&search)) {
+        if (PollParallelSearch(&search, &parallel) > 0 && first_hit_time == 0) {
+            first_hit_time = GetWallTime() - start;
+        }
+        // Poll like a frame loop would instead of spinning against the workers
+#ifdef _WIN32
+        Sleep(1);
+#else
+        usleep(200);
+#endif
+    }
+    double parallel_time = GetWallTime() - start;
+    size_t threads = min(GetProcessorCount(), search.range_count);
+    ClearParallelSearch(&search);
+
+    printf("%-28s %9zu hits %9.3f ms sequential\n", query, sequential.count, sequential_time * 1000.0);
+    printf("%-28s %9zu hits %9.3f ms on %zu threads, first hit after %.3f ms\n", "", parallel.count, parallel_time * 1000.0, threads, first_hit_time * 1000.0);
+
+    bool ok = sequential.count == parallel.count && memcmp(sequential.items, parallel.items, sequential.count * sizeof(Match)) == 0;
+    if (!ok) {
+        fprintf(stderr, "parallel search %s: results differ from the sequential scan\n", query);
+    }
+    ClearMatchList(&sequential);
+    ClearMatchList(&parallel);
+    ClearTextBuffer(&buffer);
+    return ok;
+}
+
+bool BenchCountCommand(void* context, CommandArgs* args) {
+    *(size_t*)context += args->count;
+    return true;
+}
+
+void BenchCommandDispatch(size_t ops) {
+    static const char* names[] = { "goto", "quit", "q", "macro", "find", "replace", "write", "w", "edit", "e", "set", "tail", "hex", "reload", "next", "prev" };
+    CommandSystem system = InitCommandSystem();
+    for (size_t i = 0; i < ARRAY_LEN(names); ++i) {
+        RegisterCommand(&system.registry, names[i], 0, COMMAND_ARGS_UNLIMITED, BenchCountCommand);
+    }
+
+    const char* script = "goto 120; find \"hello world\"; replace foo bar\nmacro 12; set tabs 4; w";
+    size_t token_count = 0;
+    double start = GetWallTime();
+    for (size_t i = 0; i < ops; ++i) {
+        ExecuteCommandScript(&system.registry, &system.args, &token_count, script);
+    }
+    ReportBench("command dispatch", ops * 6, GetWallTime() - start);
+
+    if (token_count == 0) printf("\n");
+    ClearCommandSystem(&system);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc >= 2 ? argv[1] : BENCH_DEFAULT_PATH;
+    size_t ops = argc >= 3 ? strtoull(argv[2], NULL, 10) : BENCH_DEFAULT_OPS;
+
+    if (GetFileTypeFromPath((char*)path) != TYPE_FILE) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+        return 1;
+    }
+
+    BenchLoad(path);
+    BenchInsertRandom(path, ops);
+    BenchInsertSequential(path, ops);
+    BenchDeleteRandom(path, ops);
+    BenchLineLookup(path, ops);
+    bool view_ok = BenchPagedFile(path, ops);
+    view_ok = BenchHexView(path, ops) && view_ok;
+    BenchCommandDispatch(ops);
+    BenchFind(path);
+    bool regex_ok = BenchRegex(path);
+    regex_ok = BenchParallelSearch(path, "Pierre", false, 0) && regex_ok;
+    regex_ok = BenchParallelSearch(path, "[A-Z][a-z]+ [A-Z][a-z]+", true, 0) && regex_ok;
+    regex_ok = BenchParallelSearch(path, "<x+>", true, 200 << 10) && regex_ok;
+    regex_ok = BenchIncrementalSearch(path) && regex_ok;
+    regex_ok = BenchMatchIndex(path, "Pierre", false, 200) && regex_ok;
+    regex_ok = BenchMatchIndex(path, "[A-Z][a-z]+ [A-Z][a-z]+", true, 100) && regex_ok;
+    regex_ok = BenchSearchCount(path, "Pierre", false, 200) && regex_ok;
+    regex_ok = BenchSearchCount(path, "[A-Z][a-z]+ [A-Z][a-z]+", true, 100) && regex_ok;
+    bool replace_ok = BenchReplaceAll(path);
+    bool save_ok = BenchSave(path);
+    save_ok = BenchCrlfSave(path) && save_ok;
+    save_ok = BenchFileLoad(path) && save_ok;
+    save_ok = BenchFileTree() && save_ok;
+    save_ok = BenchFileReload(path) && save_ok;
+    save_ok = BenchTailFollow(path, false) && save_ok;
+    save_ok = BenchBackgroundSave(path) && save_ok;
+#ifndef _WIN32
+    save_ok = BenchTailFollow(path, true) && save_ok;
+    save_ok = BenchJournal(path, ops) && save_ok;
+#endif
+    bool undo_ok = BenchUndoRedoStorm(path, ops);
+    undo_ok = BenchUndoEviction(path) && undo_ok;
+    return regex_ok && replace_ok && save_ok && undo_ok && view_ok ? 0 : 1;
+}
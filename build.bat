@@ -1,2 +1,15 @@
+gcc -c funcore.c -o funcore.o
+gcc -c search.c -o search.o
+gcc -c funregex.c -o funregex.o
+gcc -c parallelsearch.c -o parallelsearch.o
+gcc -c incsearch.c -o incsearch.o
+gcc -c matchindex.c -o matchindex.o
+gcc -c filesave.c -o filesave.o
+gcc -c journal.c -o journal.o
+gcc -c filewatch.c -o filewatch.o
+gcc -c pagedfile.c -o pagedfile.o
+gcc -c fileload.c -o fileload.o
+gcc -c hexview.c -o hexview.o
+gcc -c filetree.c -o filetree.o
 gcc -c main.c -o main.o -Iinclude
-gcc main.o libraylib.a -o main.exe -lopengl32 -lgdi32 -lwinmm
\ No newline at end of file
+gcc main.o funcore.o search.o funregex.o parallelsearch.o incsearch.o matchindex.o filesave.o journal.o filewatch.o pagedfile.o fileload.o hexview.o filetree.o libraylib.a -o main.exe -lopengl32 -lgdi32 -lwinmm -lpthread
\ No newline at end of file
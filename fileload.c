@@ -0,0 +1,383 @@
+#define _GNU_SOURCE
+#include "fileload.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#endif
+#ifdef __linux__
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+#endif
+
+int OpenReadOnly(const char* path) {
+#ifdef _WIN32
+    return open(path, O_RDONLY | O_BINARY);
+#else
+    return open(path, O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+// Reads length bytes at offset, fewer only at the end of the file
+size_t ReadFileAt(int fd, char* data, size_t length, uint64_t offset) {
+    size_t done = 0;
+#ifdef _WIN32
+    if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) return 0;
+#endif
+    while (done < length) {
+#ifdef _WIN32
+        int result = _read(fd, data + done, (unsigned)(length - done));
+#else
+        ssize_t result = pread(fd, data + done, length - done, (off_t)(offset + done));
+        if (result < 0 && errno == EINTR) continue;
+#endif
+        if (result <= 0) break;
+        done += result;
+    }
+    return done;
+}
+
+static int OpenFileForLoad(const char* path, size_t* size) {
+    int fd = OpenReadOnly(path);
+    struct stat file_stat;
+    if (fd >= 0 && fstat(fd, &file_stat) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file: %s (%s)\n", path, strerror(errno));
+        return -1;
+    }
+    *size = file_stat.st_size;
+    return fd;
+}
+
+char* ReadWholeFile(const char* path, size_t* length) {
+    size_t size;
+    int fd = OpenFileForLoad(path, &size);
+    if (fd < 0) return NULL;
+
+    char* data = malloc(size + 1);
+    if (data) {
+        *length = ReadFileAt(fd, data, size, 0);
+        data[*length] = '\0';
+    }
+    close(fd);
+    return data;
+}
+
+#ifdef __linux__
+typedef struct {
+    int fd;
+    unsigned pending;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} LoadRing;
+
+// A file being read, its read is queued again until all of it is in
+typedef struct {
+    size_t index;
+    int fd;
+    char* data;
+    size_t size;
+    size_t done;
+    struct iovec iov;
+} LoadSlot;
+
+static void ClearLoadRing(LoadRing* ring) {
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+}
+
+// Sets up a ring without liburing, the kernel ABI is small enough to map by hand
+static bool InitLoadRing(LoadRing* ring, unsigned entries) {
+    *ring = (LoadRing){0};
+    struct io_uring_params params = {0};
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return false;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        ring->sq_ring_size = ring->cq_ring_size = max(ring->sq_ring_size, ring->cq_ring_size);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    void* sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sq_ring = sq_ring == MAP_FAILED ? NULL : sq_ring;
+    void* cq_ring = single_mmap ? sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->cq_ring = cq_ring == MAP_FAILED ? NULL : cq_ring;
+    void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    ring->sqes = sqes == MAP_FAILED ? NULL : sqes;
+    if (!ring->sq_ring || !ring->cq_ring || !ring->sqes) {
+        ClearLoadRing(ring);
+        return false;
+    }
+
+    char* sq = ring->sq_ring;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+// Queues a read of what is left of the slot's file, submitted with the next EnterLoadRing
+static void QueueLoadRead(LoadRing* ring, LoadSlot* slot, size_t slot_index) {
+    unsigned tail = *ring->sq_tail;
+    unsigned position = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[position];
+    memset(sqe, 0, sizeof(*sqe));
+    slot->iov = (struct iovec){ slot->data + slot->done, slot->size - slot->done };
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = slot->fd;
+    sqe->addr = (uintptr_t)&slot->iov;
+    sqe->len = 1;
+    sqe->off = slot->done;
+    sqe->user_data = slot_index;
+    ring->sq_array[position] = position;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+// Submits what is queued and waits for at least one read to finish
+static bool EnterLoadRing(LoadRing* ring) {
+    for (;;) {
+        int result = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result >= 0) {
+            ring->pending -= result;
+            return true;
+        }
+        // A full completion queue only needs reaping
+        if (errno == EAGAIN || errno == EBUSY) return true;
+        if (errno != EINTR) return false;
+    }
+}
+
+// Reads the files through one io_uring, keeping up to FILE_LOAD_QUEUE_DEPTH reads in flight
+// so opening many files costs about one syscall per batch instead of two per file. Opening
+// and sizing a file is still done here before its read is queued. False if no ring could be
+// set up, before any file was handed out.
+bool LoadFilesWithUring(const char* const* paths, size_t count, FileLoadCallback callback, void* context) {
+    LoadRing ring;
+    if (!InitLoadRing(&ring, FILE_LOAD_QUEUE_DEPTH)) return false;
+
+    LoadSlot slots[FILE_LOAD_QUEUE_DEPTH];
+    size_t free_slots[FILE_LOAD_QUEUE_DEPTH];
+    size_t free_count = FILE_LOAD_QUEUE_DEPTH;
+    for (size_t i = 0; i < FILE_LOAD_QUEUE_DEPTH; ++i) {
+        free_slots[i] = FILE_LOAD_QUEUE_DEPTH - 1 - i;
+    }
+
+    size_t next = 0;
+    size_t in_flight = 0;
+    bool broken = false;
+    while (!broken && (next < count || in_flight > 0)) {
+        while (next < count && free_count > 0) {
+            size_t index = next++;
+            size_t size = 0;
+            int fd = OpenFileForLoad(paths[index], &size);
+            char* data = fd >= 0 ? malloc(size + 1) : NULL;
+            if (!data || size == 0) {
+                // Nothing to read, or no way to read it
+                if (fd >= 0) {
+                    close(fd);
+                }
+                if (data) {
+                    data[0] = '\0';
+                }
+                callback(context, index, data, 0);
+                continue;
+            }
+            size_t slot_index = free_slots[--free_count];
+            slots[slot_index] = (LoadSlot){ .index = index, .fd = fd, .data = data, .size = size };
+            QueueLoadRead(&ring, &slots[slot_index], slot_index);
+            in_flight++;
+        }
+        if (in_flight == 0) continue;
+        if (!EnterLoadRing(&ring)) {
+            broken = true;
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            size_t slot_index = cqe->user_data;
+            LoadSlot* slot = &slots[slot_index];
+            int result = cqe->res;
+            if (result == -EINTR || result == -EAGAIN) {
+                QueueLoadRead(&ring, slot, slot_index);
+                continue;
+            }
+            if (result > 0) {
+                slot->done += result;
+                if (slot->done < slot->size) {
+                    QueueLoadRead(&ring, slot, slot_index);
+                    continue;
+                }
+            }
+
+            // All in, failed, or the file came up shorter than it was
+            close(slot->fd);
+            if (result < 0) {
+                fprintf(stderr, "Could not read file: %s (%s)\n", paths[slot->index], strerror(-result));
+                free(slot->data);
+                slot->data = NULL;
+                slot->done = 0;
+            } else {
+                slot->data[slot->done] = '\0';
+            }
+            callback(context, slot->index, slot->data, slot->done);
+            free_slots[free_count++] = slot_index;
+            in_flight--;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (broken) {
+        // The ring stopped taking reads, what it had is read the plain way
+        for (size_t i = 0; i < FILE_LOAD_QUEUE_DEPTH && in_flight > 0; ++i) {
+            bool queued = true;
+            for (size_t j = 0; j < free_count; ++j) {
+                queued = queued && free_slots[j] != i;
+            }
+            if (!queued) continue;
+            LoadSlot* slot = &slots[i];
+            slot->done += ReadFileAt(slot->fd, slot->data + slot->done, slot->size - slot->done, slot->done);
+            slot->data[slot->done] = '\0';
+            close(slot->fd);
+            callback(context, slot->index, slot->data, slot->done);
+            in_flight--;
+        }
+        ClearLoadRing(&ring);
+        if (next < count) {
+            LoadFilesWithThreads(paths + next, count - next, callback, context);
+        }
+        return true;
+    }
+
+    ClearLoadRing(&ring);
+    return true;
+}
+#else
+bool LoadFilesWithUring(const char* const* paths, size_t count, FileLoadCallback callback, void* context) {
+    return false;
+}
+#endif
+
+typedef struct {
+    size_t index;
+    char* data;
+    size_t length;
+} LoadedFile;
+
+typedef struct {
+    const char* const* paths;
+    size_t count;
+    size_t next;
+
+    // Files read so far in the order they finished, the first delivered of them belong to the caller
+    pthread_mutex_t lock;
+    pthread_cond_t finished_changed;
+    LoadedFile* finished;
+    size_t finished_count;
+} LoadPool;
+
+static void* LoadPoolWorker(void* argument) {
+    LoadPool* pool = argument;
+    for (;;) {
+        size_t index = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (index >= pool->count) break;
+
+        LoadedFile file = { index, NULL, 0 };
+        file.data = ReadWholeFile(pool->paths[index], &file.length);
+        pthread_mutex_lock(&pool->lock);
+        pool->finished[pool->finished_count++] = file;
+        pthread_cond_signal(&pool->finished_changed);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+// The same with a pool of threads each reading whole files with pread, for when there is no
+// io_uring. Files are handed over on the calling thread as the workers finish them.
+void LoadFilesWithThreads(const char* const* paths, size_t count, FileLoadCallback callback, void* context) {
+    if (count == 0) return;
+
+    LoadPool pool = { .paths = paths, .count = count };
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.finished_changed, NULL);
+    pool.finished = malloc(count * sizeof(LoadedFile));
+
+    size_t thread_count = min(count, (size_t)FILE_LOAD_THREADS);
+    pthread_t threads[FILE_LOAD_THREADS];
+    size_t started = 0;
+    for (; started < thread_count; ++started) {
+        if (pthread_create(&threads[started], NULL, LoadPoolWorker, &pool) != 0) break;
+    }
+    if (started == 0) {
+        // No thread to be had, read right here instead
+        LoadPoolWorker(&pool);
+    }
+
+    size_t delivered = 0;
+    while (delivered < count) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.finished_count == delivered) {
+            pthread_cond_wait(&pool.finished_changed, &pool.lock);
+        }
+        size_t available = pool.finished_count;
+        pthread_mutex_unlock(&pool.lock);
+
+        for (; delivered < available; ++delivered) {
+            LoadedFile file = pool.finished[delivered];
+            callback(context, file.index, file.data, file.length);
+        }
+    }
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(pool.finished);
+    pthread_cond_destroy(&pool.finished_changed);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+FileLoadMethod LoadFiles(const char* const* paths, size_t count, FileLoadCallback callback, void* context) {
+    if (LoadFilesWithUring(paths, count, callback, context)) return FILE_LOAD_URING;
+    LoadFilesWithThreads(paths, count, callback, context);
+    return FILE_LOAD_THREADS_POOL;
+}
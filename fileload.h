@@ -0,0 +1,28 @@
+#ifndef FILELOAD_H
+#define FILELOAD_H
+
+#include "funcore.h"
+
+// Files being read at once, each is one read in the ring or one file on a pool thread
+#define FILE_LOAD_QUEUE_DEPTH 64
+// Reads wait on the disk rather than the CPU, so the pool is not sized by the cores
+#define FILE_LOAD_THREADS 8
+
+typedef enum {
+    FILE_LOAD_URING,
+    FILE_LOAD_THREADS_POOL
+} FileLoadMethod;
+
+// Called on the thread that asked for the files, once per file in the order the reads finish.
+// data holds length bytes and a NUL after them and is the callee's to free, it is NULL for a
+// file that could not be read.
+typedef void (*FileLoadCallback)(void* context, size_t index, char* data, size_t length);
+
+int OpenReadOnly(const char* path);
+size_t ReadFileAt(int fd, char* data, size_t length, uint64_t offset);
+char* ReadWholeFile(const char* path, size_t* length);
+bool LoadFilesWithUring(const char* const* paths, size_t count, FileLoadCallback callback, void* context);
+void LoadFilesWithThreads(const char* const* paths, size_t count, FileLoadCallback callback, void* context);
+FileLoadMethod LoadFiles(const char* const* paths, size_t count, FileLoadCallback callback, void* context);
+
+#endif
@@ -0,0 +1,303 @@
+#define _GNU_SOURCE
+#include "filesave.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <sys/uio.h>
+    #include <libgen.h>
+#endif
+
+#ifdef _WIN32
+// No writev here, the pieces go through stdio one by one instead
+bool SavePieceView(PieceView view, const char* path, size_t* written) {
+    size_t temp_length = strlen(path) + 16;
+    char* temp_path = malloc(temp_length);
+    snprintf(temp_path, temp_length, "%s.save-tmp", path);
+
+    FILE* f = fopen(temp_path, "wb");
+    if (!f) {
+        fprintf(stderr, "Could not save file: %s\n", path);
+        free(temp_path);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < view.piece_count && ok; ++i) {
+        const char* text = GetPieceViewText(view, view.pieces[i]);
+        size_t length = view.pieces[i].length;
+        if (view.line_ending == LINE_ENDING_CRLF) {
+            const char* end = text + length;
+            const char* newline;
+            while (ok && (newline = memchr(text, '\n', end - text))) {
+                ok = fwrite(text, 1, newline - text, f) == (size_t)(newline - text) && fwrite("\r\n", 1, 2, f) == 2;
+                text = newline + 1;
+            }
+            length = end - text;
+        }
+        ok = ok && fwrite(text, 1, length, f) == length;
+        if (written) {
+            __atomic_add_fetch(written, view.pieces[i].length, __ATOMIC_RELAXED);
+        }
+    }
+    ok = ok && fflush(f) == 0 && _commit(_fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    ok = ok && MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    if (!ok) {
+        fprintf(stderr, "Could not save file: %s\n", path);
+        remove(temp_path);
+    }
+    free(temp_path);
+    return ok;
+}
+#else
+// Writes all count vectors, picking up after short writes
+static bool WriteVectors(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+static bool WritePieces(int fd, PieceView view, size_t* written) {
+    struct iovec iov[SAVE_IOV_BATCH];
+    size_t i = 0;
+    while (i < view.piece_count) {
+        int count = 0;
+        size_t batch_size = 0;
+        for (; i < view.piece_count && count < SAVE_IOV_BATCH; ++i) {
+            if (view.pieces[i].length == 0) continue;
+            iov[count].iov_base = (char*)GetPieceViewText(view, view.pieces[i]);
+            iov[count].iov_len = view.pieces[i].length;
+            batch_size += view.pieces[i].length;
+            count++;
+        }
+        if (!WriteVectors(fd, iov, count)) return false;
+        if (written) {
+            __atomic_add_fetch(written, batch_size, __ATOMIC_RELAXED);
+        }
+    }
+    return true;
+}
+
+// Writes the text with every newline turned into CRLF. The runs between newlines are
+// copied into a staging buffer, which goes out whenever it fills.
+static bool WriteCrlfPieces(int fd, PieceView view, size_t* written) {
+    char* staging = malloc(SAVE_CONVERT_BUFFER_SIZE);
+    size_t used = 0;
+    size_t staged_text = 0;
+    bool ok = true;
+    for (size_t i = 0; i < view.piece_count && ok; ++i) {
+        const char* text = GetPieceViewText(view, view.pieces[i]);
+        const char* end = text + view.pieces[i].length;
+        while (text < end && ok) {
+            const char* newline = memchr(text, '\n', end - text);
+            size_t run = (newline ? newline : end) - text;
+            // Room for the run, or at least the CRLF after it
+            size_t take = min(run, SAVE_CONVERT_BUFFER_SIZE - 2 - used);
+            memcpy(staging + used, text, take);
+            used += take;
+            text += take;
+            staged_text += take;
+            if (take == run && newline) {
+                staging[used++] = '\r';
+                staging[used++] = '\n';
+                text++;
+                staged_text++;
+            }
+            if (used + 2 >= SAVE_CONVERT_BUFFER_SIZE) {
+                ok = WriteVectors(fd, &(struct iovec){staging, used}, 1);
+                if (written) {
+                    __atomic_add_fetch(written, staged_text, __ATOMIC_RELAXED);
+                }
+                used = 0;
+                staged_text = 0;
+            }
+        }
+    }
+    if (ok && used > 0) {
+        ok = WriteVectors(fd, &(struct iovec){staging, used}, 1);
+        if (written) {
+            __atomic_add_fetch(written, staged_text, __ATOMIC_RELAXED);
+        }
+    }
+    free(staging);
+    return ok;
+}
+
+// Makes the rename itself durable
+void SyncParentDirectory(const char* path) {
+    char* copy = strdup(path);
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(copy);
+}
+
+// Opens a new file next to path. It is created with the mode of the file it replaces,
+// or with the usual 0666 minus umask for a new file.
+static int OpenTempFile(const char* path, char** temp_path) {
+    struct stat existing;
+    bool replaces = stat(path, &existing) == 0;
+
+    size_t temp_length = strlen(path) + 32;
+    *temp_path = malloc(temp_length);
+    for (unsigned attempt = 0; attempt < 100; ++attempt) {
+        snprintf(*temp_path, temp_length, "%s.save-%ld-%u", path, (long)getpid(), attempt);
+        int fd = open(*temp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0) {
+            if (replaces) {
+                fchmod(fd, existing.st_mode & 07777);
+            }
+            return fd;
+        }
+        if (errno != EEXIST) break;
+    }
+    free(*temp_path);
+    *temp_path = NULL;
+    return -1;
+}
+
+// Writes the text to a temporary file next to path and renames it over path, so the file
+// holds either the old or the new text even if we die halfway. The pieces are written
+// straight out of the buffers, only a fixed batch of iovecs is needed on top. A CRLF
+// file goes through a staging buffer instead to put its CRs back.
+bool SavePieceView(PieceView view, const char* path, size_t* written) {
+    // Saving through a symlink replaces the file it points to, not the link
+    char* target = realpath(path, NULL);
+    if (!target) {
+        target = strdup(path);
+    }
+
+    char* temp_path;
+    int fd = OpenTempFile(target, &temp_path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not save file: %s (%s)\n", path, strerror(errno));
+        free(target);
+        return false;
+    }
+
+    bool ok = (view.line_ending == LINE_ENDING_CRLF ? WriteCrlfPieces(fd, view, written) : WritePieces(fd, view, written)) &&
+              fsync(fd) == 0;
+    int error = ok ? 0 : errno;
+    if (close(fd) != 0 && ok) {
+        ok = false;
+        error = errno;
+    }
+    if (ok && rename(temp_path, target) != 0) {
+        ok = false;
+        error = errno;
+    }
+
+    if (ok) {
+        SyncParentDirectory(target);
+    } else {
+        unlink(temp_path);
+        fprintf(stderr, "Could not save file: %s (%s)\n", path, strerror(error));
+    }
+
+    free(temp_path);
+    free(target);
+    return ok;
+}
+#endif
+
+bool SaveTextBuffer(TextBuffer* buffer, const char* path) {
+    return SavePieceView(GetPieceView(buffer), path, NULL);
+}
+
+static void* BackgroundSaveWorker(void* argument) {
+    BackgroundSave* save = argument;
+    save->ok = SavePieceView(save->snapshot.view, save->path, &save->written);
+    __atomic_store_n(&save->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void LaunchBackgroundSave(BackgroundSave* save, TextBuffer* buffer, const char* path) {
+    save->path = strdup(path);
+    save->snapshot = CreateTextSnapshot(buffer);
+    save->written = 0;
+    save->finished = 0;
+    save->ok = false;
+    save->running = true;
+
+    if (pthread_create(&save->thread, NULL, BackgroundSaveWorker, save) != 0) {
+        // No thread to be had, save right here instead
+        save->running = false;
+        BackgroundSaveWorker(save);
+    }
+}
+
+// Starts saving buffer to path, or if a save is running, remembers to save again after it
+void StartBackgroundSave(BackgroundSave* save, TextBuffer* buffer, const char* path) {
+    if (save->path) {
+        free(save->pending_path);
+        save->pending_path = strdup(path);
+        return;
+    }
+    LaunchBackgroundSave(save, buffer, path);
+}
+
+// Reports SAVE_FINISHED or SAVE_FAILED once for every save that ends, then starts the pending
+// save unless the finished one already wrote the same text to the same path
+SaveState PollBackgroundSave(BackgroundSave* save, TextBuffer* buffer) {
+    if (!save->path) return SAVE_IDLE;
+    if (!__atomic_load_n(&save->finished, __ATOMIC_ACQUIRE)) return SAVE_RUNNING;
+
+    if (save->running) {
+        pthread_join(save->thread, NULL);
+        save->running = false;
+    }
+    free(save->saved_path);
+    save->saved_path = save->path;
+    save->saved_revision = save->snapshot.revision;
+    save->path = NULL;
+    ClearTextSnapshot(&save->snapshot);
+    bool ok = save->ok;
+
+    char* pending_path = save->pending_path;
+    save->pending_path = NULL;
+    if (pending_path && (!ok || buffer->revision != save->saved_revision || strcmp(pending_path, save->saved_path) != 0)) {
+        LaunchBackgroundSave(save, buffer, pending_path);
+    }
+    free(pending_path);
+    return ok ? SAVE_FINISHED : SAVE_FAILED;
+}
+
+size_t GetBackgroundSaveProgress(BackgroundSave* save) {
+    return __atomic_load_n(&save->written, __ATOMIC_RELAXED);
+}
+
+// Waits for a running save, a pending one is dropped
+void ClearBackgroundSave(BackgroundSave* save) {
+    if (save->running) {
+        pthread_join(save->thread, NULL);
+        save->running = false;
+    }
+    save->finished = 0;
+    ClearTextSnapshot(&save->snapshot);
+    free(save->path);
+    save->path = NULL;
+    free(save->saved_path);
+    save->saved_path = NULL;
+    free(save->pending_path);
+    save->pending_path = NULL;
+}
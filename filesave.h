@@ -0,0 +1,50 @@
+#ifndef FILESAVE_H
+#define FILESAVE_H
+
+#include <pthread.h>
+
+#include "funcore.h"
+
+// Pieces handed to one writev call
+#define SAVE_IOV_BATCH 64
+// Staging buffer for text whose newlines are written out as CRLF
+#define SAVE_CONVERT_BUFFER_SIZE (64 * 1024)
+
+typedef enum {
+    SAVE_IDLE,
+    SAVE_RUNNING,
+    SAVE_FINISHED,
+    SAVE_FAILED
+} SaveState;
+
+// Writes a snapshot of a buffer on its own thread so editing goes on meanwhile. Saves asked
+// for while one runs are folded into a single save of the latest text once it is done.
+typedef struct {
+    pthread_t thread;
+    TextSnapshot snapshot;
+    char* path;
+    // Bytes written so far, updated by the writer thread
+    size_t written;
+    int finished;
+    bool ok;
+    bool running;
+
+    // What the save last reported by PollBackgroundSave wrote
+    char* saved_path;
+    uint64_t saved_revision;
+
+    char* pending_path;
+} BackgroundSave;
+
+#ifndef _WIN32
+void SyncParentDirectory(const char* path);
+#endif
+bool SavePieceView(PieceView view, const char* path, size_t* written);
+bool SaveTextBuffer(TextBuffer* buffer, const char* path);
+
+void StartBackgroundSave(BackgroundSave* save, TextBuffer* buffer, const char* path);
+SaveState PollBackgroundSave(BackgroundSave* save, TextBuffer* buffer);
+size_t GetBackgroundSaveProgress(BackgroundSave* save);
+void ClearBackgroundSave(BackgroundSave* save);
+
+#endif
@@ -0,0 +1,739 @@
+#define _GNU_SOURCE
+#include "filetree.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <sys/syscall.h>
+
+    #define FILE_TREE_WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+#ifdef _WIN32
+    #define FILE_TREE_SEPARATOR '\\'
+#else
+    #define FILE_TREE_SEPARATOR '/'
+#endif
+
+static bool IsTreePathSeparator(char c) {
+#ifdef _WIN32
+    if (c == '\\') return true;
+#endif
+    return c == '/';
+}
+
+FileTree* CreateFileTree() {
+    FileTree* tree = calloc(1, sizeof(FileTree));
+    tree->capacity = INITIAL_FILE_TREE_CAPACITY;
+    tree->types = malloc(tree->capacity * sizeof(uint8_t));
+    tree->parents = malloc(tree->capacity * sizeof(uint32_t));
+    tree->name_offsets = malloc(tree->capacity * sizeof(uint32_t));
+    tree->child_starts = malloc(tree->capacity * sizeof(uint32_t));
+    tree->child_counts = malloc(tree->capacity * sizeof(uint32_t));
+    tree->watches = malloc(tree->capacity * sizeof(int));
+    tree->names_capacity = INITIAL_FILE_TREE_NAMES_CAPACITY;
+    tree->names = malloc(tree->names_capacity);
+    tree->children_capacity = INITIAL_FILE_TREE_CAPACITY;
+    tree->children = malloc(tree->children_capacity * sizeof(uint32_t));
+    tree->root_index = SIZE_MAX;
+    return tree;
+}
+
+void FreeFileTree(FileTree* tree) {
+    if (!tree) return;
+    free(tree->types);
+    free(tree->parents);
+    free(tree->name_offsets);
+    free(tree->child_starts);
+    free(tree->child_counts);
+    free(tree->watches);
+    free(tree->names);
+    free(tree->children);
+    free(tree->root_path);
+    free(tree->watch_nodes);
+    free(tree);
+}
+
+// Grows an array to capacity items, it is left as it was if that fails
+static bool GrowTreeArray(void** array, size_t capacity, size_t item_size) {
+    void* grown = realloc(*array, capacity * item_size);
+    if (!grown) return false;
+    *array = grown;
+    return true;
+}
+
+static bool GrowTreeNodes(FileTree* tree) {
+    size_t capacity = tree->capacity * 2;
+    if (capacity > FILE_TREE_NO_PARENT) return false;
+    // Arrays grown before one fails are only larger than needed
+    if (!GrowTreeArray((void**)&tree->types, capacity, sizeof(uint8_t))
+        || !GrowTreeArray((void**)&tree->parents, capacity, sizeof(uint32_t))
+        || !GrowTreeArray((void**)&tree->name_offsets, capacity, sizeof(uint32_t))
+        || !GrowTreeArray((void**)&tree->child_starts, capacity, sizeof(uint32_t))
+        || !GrowTreeArray((void**)&tree->child_counts, capacity, sizeof(uint32_t))
+        || !GrowTreeArray((void**)&tree->watches, capacity, sizeof(int))) {
+        return false;
+    }
+    tree->capacity = capacity;
+    return true;
+}
+
+// The root has no parent, parent_index is SIZE_MAX for it. Offsets into names and children are
+// 32 bits, a tree that outgrows them stops taking nodes.
+size_t AddNodeToTree(FileTree* tree, NodeType type, size_t parent_index, const char* name, size_t name_length) {
+    if (tree->count >= tree->capacity && !GrowTreeNodes(tree)) {
+        return SIZE_MAX;
+    }
+    size_t names_length = tree->names_length + name_length + 1;
+    if (names_length > UINT32_MAX) {
+        return SIZE_MAX;
+    }
+    if (names_length > tree->names_capacity) {
+        size_t capacity = max(tree->names_capacity * 2, names_length);
+        if (!GrowTreeArray((void**)&tree->names, capacity, 1)) {
+            return SIZE_MAX;
+        }
+        tree->names_capacity = capacity;
+    }
+
+    size_t index = tree->count++;
+    memcpy(tree->names + tree->names_length, name, name_length);
+    tree->names[tree->names_length + name_length] = '\0';
+    tree->types[index] = (uint8_t)type;
+    tree->parents[index] = parent_index == SIZE_MAX ? FILE_TREE_NO_PARENT : (uint32_t)parent_index;
+    tree->name_offsets[index] = (uint32_t)tree->names_length;
+    tree->child_starts[index] = (uint32_t)tree->children_length;
+    tree->child_counts[index] = 0;
+    tree->watches[index] = -1;
+    tree->names_length = names_length;
+    if (type == NODE_DIR) {
+        tree->dir_count++;
+    } else {
+        tree->file_count++;
+    }
+    return index;
+}
+
+static bool ReserveTreeChildren(FileTree* tree, size_t length) {
+    if (length > UINT32_MAX) return false;
+    if (length <= tree->children_capacity) return true;
+    size_t capacity = max(tree->children_capacity * 2, length);
+    if (!GrowTreeArray((void**)&tree->children, capacity, sizeof(uint32_t))) return false;
+    tree->children_capacity = capacity;
+    return true;
+}
+
+// Appends in place while the parent's range is the last one, which is the case for every
+// child a walker adds. Otherwise the range is moved to the end first.
+void AddChildToTreeNode(FileTree* tree, size_t parent_index, size_t child_index) {
+    if (parent_index >= tree->count || child_index == SIZE_MAX) {
+        return;
+    }
+
+    size_t start = tree->child_starts[parent_index];
+    size_t count = tree->child_counts[parent_index];
+    if (count > 0 && start + count == tree->children_length) {
+        if (!ReserveTreeChildren(tree, tree->children_length + 1)) return;
+    } else {
+        if (!ReserveTreeChildren(tree, tree->children_length + count + 1)) return;
+        memcpy(tree->children + tree->children_length, tree->children + start, count * sizeof(uint32_t));
+        tree->child_starts[parent_index] = (uint32_t)tree->children_length;
+        tree->children_length += count;
+        tree->unused_children += count;
+    }
+    tree->children[tree->children_length++] = (uint32_t)child_index;
+    tree->child_counts[parent_index]++;
+}
+
+const char* GetFileTreeName(const FileTree* tree, size_t index) {
+    return tree->names + tree->name_offsets[index];
+}
+
+// Puts the path of a node together from the names up to the root, back to front. Returns its
+// length, or 0 with out left empty when it does not fit in capacity.
+size_t GetFileTreePath(const FileTree* tree, size_t index, char* out, size_t capacity) {
+    size_t root_length = strlen(tree->root_path);
+    size_t length = root_length;
+    for (size_t at = index; at != tree->root_index; at = tree->parents[at]) {
+        length += strlen(GetFileTreeName(tree, at)) + 1;
+    }
+    // No second separator after a root such as /
+    if (index != tree->root_index && root_length > 0 && IsTreePathSeparator(tree->root_path[root_length - 1])) {
+        length--;
+    }
+    if (length + 1 > capacity) {
+        if (capacity > 0) out[0] = '\0';
+        return 0;
+    }
+
+    out[length] = '\0';
+    size_t end = length;
+    for (size_t at = index; at != tree->root_index; at = tree->parents[at]) {
+        const char* name = GetFileTreeName(tree, at);
+        size_t name_length = strlen(name);
+        end -= name_length;
+        memcpy(out + end, name, name_length);
+        out[--end] = FILE_TREE_SEPARATOR;
+    }
+    // Written over the separator after the root when the root already ends in one
+    memcpy(out, tree->root_path, root_length);
+    return length;
+}
+
+size_t FindFileTreeChild(FileTree* tree, size_t parent_index, const char* name) {
+    const uint32_t* children = tree->children + tree->child_starts[parent_index];
+    for (size_t i = 0; i < tree->child_counts[parent_index]; ++i) {
+        if (strcmp(GetFileTreeName(tree, children[i]), name) == 0) return children[i];
+    }
+    return SIZE_MAX;
+}
+
+static void SetTreeWatch(FileTree* tree, size_t index, int watch) {
+    if ((size_t)watch >= tree->watch_node_capacity) {
+        size_t capacity = max(tree->watch_node_capacity * 2, (size_t)watch + 1);
+        tree->watch_nodes = realloc(tree->watch_nodes, capacity * sizeof(size_t));
+        for (size_t i = tree->watch_node_capacity; i < capacity; ++i) {
+            tree->watch_nodes[i] = SIZE_MAX;
+        }
+        tree->watch_node_capacity = capacity;
+    }
+    tree->watch_nodes[watch] = index;
+    tree->watches[index] = watch;
+}
+
+// Hidden entries, .git among them, and installed packages are left out of the tree
+static bool IsSkippedEntry(const char* name) {
+    return name[0] == '.' || strcmp(name, "node_modules") == 0;
+}
+
+typedef struct {
+    size_t name;
+    size_t name_length;
+    bool is_dir;
+    // Linked directories are listed but not walked, a link to a parent would never end
+    bool walk;
+} DirEntry;
+
+// Entries of the directory being read, reused from one directory to the next so reading one
+// allocates nothing once the walker has seen a directory as large
+typedef struct {
+    DirEntry* items;
+    size_t count;
+    size_t capacity;
+
+    // The names one after another, each with its NUL
+    char* names;
+    size_t names_length;
+    size_t names_capacity;
+
+    // Records filled in by getdents64
+    char* records;
+} DirEntryList;
+
+static void AppendDirEntry(DirEntryList* list, const char* name, bool is_dir, bool walk) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : INITIAL_WALK_QUEUE_CAPACITY;
+        list->items = realloc(list->items, list->capacity * sizeof(DirEntry));
+    }
+    size_t name_length = strlen(name);
+    if (list->names_length + name_length + 1 > list->names_capacity) {
+        list->names_capacity = max(list->names_capacity * 2, list->names_length + name_length + 1);
+        list->names = realloc(list->names, list->names_capacity);
+    }
+    memcpy(list->names + list->names_length, name, name_length + 1);
+    list->items[list->count++] = (DirEntry){ list->names_length, name_length, is_dir, is_dir && walk };
+    list->names_length += name_length + 1;
+}
+
+static void ClearDirEntryList(DirEntryList* list) {
+    free(list->items);
+    free(list->names);
+    free(list->records);
+    *list = (DirEntryList){0};
+}
+
+#ifndef _WIN32
+typedef enum {
+    ENTRY_MISSING,
+    ENTRY_FILE,
+    ENTRY_DIR,
+    ENTRY_LINKED_DIR
+} EntryKind;
+
+// The type in the entry is enough for most file systems. The others and symbolic links, which
+// are followed, need a stat of the entry relative to the open directory.
+static EntryKind GetEntryKind(int dir_fd, const char* name, unsigned char type) {
+#ifdef DT_UNKNOWN
+    if (type == DT_DIR) return ENTRY_DIR;
+    if (type != DT_UNKNOWN && type != DT_LNK) return ENTRY_FILE;
+#endif
+    struct stat entry_stat;
+    if (fstatat(dir_fd, name, &entry_stat, 0) != 0) return ENTRY_MISSING;
+    if (!S_ISDIR(entry_stat.st_mode)) return ENTRY_FILE;
+    if (fstatat(dir_fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(entry_stat.st_mode)) return ENTRY_LINKED_DIR;
+    return ENTRY_DIR;
+}
+
+static void AppendEntryOfKind(DirEntryList* list, const char* name, EntryKind kind) {
+    if (kind != ENTRY_MISSING) {
+        AppendDirEntry(list, name, kind != ENTRY_FILE, kind == ENTRY_DIR);
+    }
+}
+#endif
+
+#ifdef __linux__
+// Layout of the records getdents64 fills its buffer with
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+#endif
+
+// Entries of one directory, read without touching the tree so walkers only lock to add them
+static void ReadDirEntries(const char* path, DirEntryList* list) {
+    list->count = 0;
+    list->names_length = 0;
+#ifdef _WIN32
+    char search_path[MAX_PATH];
+    snprintf(search_path, MAX_PATH, "%s\\*", path);
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(search_path, &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) return;
+
+    do {
+        if (IsSkippedEntry(find_data.cFileName)) continue;
+        DWORD attributes = find_data.dwFileAttributes;
+        AppendDirEntry(list, find_data.cFileName, (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0, (attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0);
+    } while (FindNextFileA(find_handle, &find_data));
+    FindClose(find_handle);
+#elif defined(__linux__)
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return;
+    if (!list->records) {
+        list->records = malloc(FILE_TREE_RECORDS_SIZE);
+    }
+
+    long length;
+    while ((length = syscall(SYS_getdents64, dir_fd, list->records, FILE_TREE_RECORDS_SIZE)) > 0) {
+        for (long at = 0; at < length;) {
+            LinuxDirent64* entry = (LinuxDirent64*)(list->records + at);
+            at += entry->d_reclen;
+            if (IsSkippedEntry(entry->d_name)) continue;
+
+            AppendEntryOfKind(list, entry->d_name, GetEntryKind(dir_fd, entry->d_name, entry->d_type));
+        }
+    }
+    close(dir_fd);
+#else
+    DIR* dir = opendir(path);
+    if (!dir) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (IsSkippedEntry(entry->d_name)) continue;
+
+#ifdef DT_UNKNOWN
+        AppendEntryOfKind(list, entry->d_name, GetEntryKind(dirfd(dir), entry->d_name, entry->d_type));
+#else
+        AppendEntryOfKind(list, entry->d_name, GetEntryKind(dirfd(dir), entry->d_name, 0));
+#endif
+    }
+    closedir(dir);
+#endif
+}
+
+static void PushWalkQueue(WalkQueue* queue, PendingDir dir) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->back >= queue->capacity && queue->front > 0) {
+        // Stolen items leave room at the front, slide the live ones there before growing
+        size_t live = queue->back - queue->front;
+        memmove(queue->items, queue->items + queue->front, live * sizeof(PendingDir));
+        queue->front = 0;
+        queue->back = live;
+    }
+    if (queue->back >= queue->capacity) {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : INITIAL_WALK_QUEUE_CAPACITY;
+        queue->items = realloc(queue->items, queue->capacity * sizeof(PendingDir));
+    }
+    queue->items[queue->back++] = dir;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool TakeWalkQueue(WalkQueue* queue, PendingDir* dir, bool steal) {
+    pthread_mutex_lock(&queue->lock);
+    bool taken = queue->front < queue->back;
+    if (taken) {
+        *dir = steal ? queue->items[queue->front++] : queue->items[--queue->back];
+    }
+    if (queue->front == queue->back) {
+        queue->front = 0;
+        queue->back = 0;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return taken;
+}
+
+static bool StealWalkWork(FileCache* cache, size_t thief, PendingDir* dir) {
+    for (size_t i = 1; i < cache->queue_count; ++i) {
+        if (TakeWalkQueue(&cache->queues[(thief + i) % cache->queue_count], dir, true)) return true;
+    }
+    return false;
+}
+
+// Adds the entries of one directory under its node and queues the directories among them.
+// In a walk those are counted as outstanding before the directory itself stops being. Their
+// paths are put together in one buffer behind the directory's path, an entry whose path does
+// not fit is left out. The directory is watched before it is read, so nothing added to it
+// later goes unseen.
+static void WalkDirectory(FileCache* cache, FileTree* tree, WalkQueue* queue, PendingDir dir, DirEntryList* entries, bool counted) {
+    char path[FILE_TREE_PATH_MAX];
+    size_t prefix = strlen(dir.path);
+    if (prefix + 2 > sizeof(path)) return;
+    memcpy(path, dir.path, prefix);
+#ifdef _WIN32
+    if (prefix > 0 && path[prefix - 1] != '\\' && path[prefix - 1] != '/') {
+        path[prefix++] = '\\';
+    }
+#else
+    if (prefix > 0 && path[prefix - 1] != '/') {
+        path[prefix++] = '/';
+    }
+#endif
+
+#ifdef __linux__
+    int watch = cache->watch_fd >= 0 ? inotify_add_watch(cache->watch_fd, dir.path, FILE_TREE_WATCH_EVENTS) : -1;
+    if (cache->watch_fd >= 0 && watch < 0 && (errno == ENOSPC || errno == ENOMEM)) {
+        __atomic_store_n(&cache->watch_failed, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    ReadDirEntries(dir.path, entries);
+
+    pthread_mutex_lock(&cache->tree_lock);
+#ifdef __linux__
+    if (watch >= 0) {
+        SetTreeWatch(tree, dir.index, watch);
+    }
+#endif
+    for (size_t i = 0; i < entries->count; ++i) {
+        DirEntry* entry = &entries->items[i];
+        const char* name = entries->names + entry->name;
+        if (prefix + entry->name_length + 1 > sizeof(path)) continue;
+
+        size_t child_index = AddNodeToTree(tree, entry->is_dir ? NODE_DIR : NODE_FILE, dir.index, name, entry->name_length);
+        AddChildToTreeNode(tree, dir.index, child_index);
+        if (entry->walk && child_index != SIZE_MAX) {
+            memcpy(path + prefix, name, entry->name_length + 1);
+            if (counted) {
+                __atomic_add_fetch(&cache->outstanding, 1, __ATOMIC_RELAXED);
+            }
+            PushWalkQueue(queue, (PendingDir){ strdup(path), child_index });
+        }
+    }
+    pthread_mutex_unlock(&cache->tree_lock);
+}
+
+// The walker that reads the last directory publishes the tree
+static void PublishFileTree(FileCache* cache) {
+    FileTree* previous = __atomic_exchange_n(&cache->active, cache->building, __ATOMIC_ACQ_REL);
+    cache->building = previous;
+    __atomic_store_n(&cache->walk_done, 1, __ATOMIC_RELEASE);
+}
+
+static void* FileWalker(void* argument) {
+    WalkQueue* queue = argument;
+    FileCache* cache = queue->cache;
+    DirEntryList entries = {0};
+
+    while (true) {
+        PendingDir dir;
+        if (!TakeWalkQueue(queue, &dir, false) && !StealWalkWork(cache, queue->index, &dir)) {
+            if (__atomic_load_n(&cache->outstanding, __ATOMIC_ACQUIRE) == 0) break;
+            // Others are still reading and may queue more
+            sched_yield();
+            continue;
+        }
+
+        WalkDirectory(cache, cache->building, queue, dir, &entries, true);
+        free(dir.path);
+        if (__atomic_sub_fetch(&cache->outstanding, 1, __ATOMIC_ACQ_REL) == 0) {
+            PublishFileTree(cache);
+        }
+    }
+
+    ClearDirEntryList(&entries);
+    return NULL;
+}
+
+// thread_count 0 uses one thread per processor
+bool InitFileCache(FileCache* cache, const char* root, size_t thread_count) {
+    *cache = (FileCache){0};
+    if (thread_count == 0) {
+        thread_count = GetProcessorCount();
+    }
+    cache->root = strdup(root);
+    cache->queue_count = min(max(thread_count, (size_t)1), (size_t)FILE_TREE_MAX_THREADS);
+    cache->scan_interval = FILE_TREE_SCAN_INTERVAL;
+#ifdef __linux__
+    cache->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+    cache->watch_fd = -1;
+#endif
+    pthread_mutex_init(&cache->tree_lock, NULL);
+    for (size_t i = 0; i < cache->queue_count; ++i) {
+        cache->queues[i].cache = cache;
+        cache->queues[i].index = i;
+        pthread_mutex_init(&cache->queues[i].lock, NULL);
+    }
+    return StartFileCacheWalk(cache, GetWallTime());
+}
+
+static const char* GetPathName(const char* path) {
+    const char* name = strrchr(path, '/');
+#ifdef _WIN32
+    const char* name_win = strrchr(path, '\\');
+    if (name_win > name) name = name_win;
+#endif
+    return name && name[1] ? name + 1 : path;
+}
+
+bool StartFileCacheWalk(FileCache* cache, double current_time) {
+    if (cache->walking) return false;
+
+    cache->building = CreateFileTree();
+    cache->building->root_path = strdup(cache->root);
+    const char* root_name = GetPathName(cache->root);
+    cache->building->root_index = AddNodeToTree(cache->building, NODE_DIR, SIZE_MAX, root_name, strlen(root_name));
+    if (cache->building->root_index == SIZE_MAX) {
+        FreeFileTree(cache->building);
+        cache->building = NULL;
+        return false;
+    }
+
+    cache->last_scan_time = current_time;
+    cache->walk_done = 0;
+    cache->outstanding = 1;
+    PushWalkQueue(&cache->queues[0], (PendingDir){ strdup(cache->root), cache->building->root_index });
+
+    cache->walking = true;
+    cache->thread_count = 0;
+    for (size_t i = 0; i < cache->queue_count; ++i) {
+        if (pthread_create(&cache->threads[cache->thread_count], NULL, FileWalker, &cache->queues[i]) == 0) {
+            cache->thread_count++;
+        }
+    }
+    // Without any thread the walk is done right here
+    if (cache->thread_count == 0) {
+        FileWalker(&cache->queues[0]);
+    }
+    return true;
+}
+
+static void JoinFileCacheWalk(FileCache* cache) {
+    for (size_t i = 0; i < cache->thread_count; ++i) {
+        pthread_join(cache->threads[i], NULL);
+    }
+    cache->thread_count = 0;
+    cache->walking = false;
+    // The tree the swap replaced, nothing reads it once the frame that saw it is over
+    FreeFileTree(cache->building);
+    cache->building = NULL;
+}
+
+#ifdef __linux__
+// Walks a directory that showed up in the tree right away, it is watched before being read
+// like any other so a subdirectory created meanwhile is not missed
+static void WalkSubtreeNow(FileCache* cache, FileTree* tree, const char* path, size_t index, DirEntryList* entries) {
+    WalkQueue queue = {0};
+    pthread_mutex_init(&queue.lock, NULL);
+    PushWalkQueue(&queue, (PendingDir){ strdup(path), index });
+
+    PendingDir dir;
+    while (TakeWalkQueue(&queue, &dir, false)) {
+        WalkDirectory(cache, tree, &queue, dir, entries, false);
+        free(dir.path);
+    }
+    free(queue.items);
+    pthread_mutex_destroy(&queue.lock);
+}
+
+// Takes a node out of its parent and stops watching the directories below it
+static void DetachTreeNode(FileCache* cache, FileTree* tree, size_t parent_index, size_t index) {
+    uint32_t* children = tree->children + tree->child_starts[parent_index];
+    size_t children_count = tree->child_counts[parent_index];
+    for (size_t i = 0; i < children_count; ++i) {
+        if (children[i] == index) {
+            memmove(children + i, children + i + 1, (children_count - i - 1) * sizeof(uint32_t));
+            tree->child_counts[parent_index]--;
+            tree->unused_children++;
+            break;
+        }
+    }
+
+    size_t* stack = malloc(sizeof(size_t) * INITIAL_WALK_QUEUE_CAPACITY);
+    size_t stack_capacity = INITIAL_WALK_QUEUE_CAPACITY;
+    size_t stack_count = 0;
+    stack[stack_count++] = index;
+    while (stack_count > 0) {
+        size_t node = stack[--stack_count];
+        tree->detached_count++;
+        if (tree->types[node] == NODE_DIR) {
+            tree->dir_count--;
+        } else {
+            tree->file_count--;
+        }
+        if (tree->watches[node] >= 0) {
+            inotify_rm_watch(cache->watch_fd, tree->watches[node]);
+            tree->watch_nodes[tree->watches[node]] = SIZE_MAX;
+            tree->watches[node] = -1;
+        }
+
+        size_t count = tree->child_counts[node];
+        if (stack_count + count > stack_capacity) {
+            stack_capacity = max(stack_capacity * 2, stack_count + count);
+            stack = realloc(stack, stack_capacity * sizeof(size_t));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            stack[stack_count++] = tree->children[tree->child_starts[node] + i];
+        }
+    }
+    free(stack);
+}
+
+static void AddChangedEntry(FileCache* cache, FileTree* tree, size_t parent_index, const char* name, DirEntryList* entries) {
+    char path[FILE_TREE_PATH_MAX];
+    size_t name_length = strlen(name);
+    size_t prefix = GetFileTreePath(tree, parent_index, path, sizeof(path));
+    if (prefix == 0 || prefix + name_length + 2 > sizeof(path)) return;
+    if (path[prefix - 1] != '/') {
+        path[prefix++] = '/';
+    }
+    memcpy(path + prefix, name, name_length + 1);
+
+    // Gone again already when the event is read, a later event says so
+    EntryKind kind = GetEntryKind(AT_FDCWD, path, DT_UNKNOWN);
+    if (kind == ENTRY_MISSING) return;
+
+    size_t index = AddNodeToTree(tree, kind == ENTRY_FILE ? NODE_FILE : NODE_DIR, parent_index, name, name_length);
+    AddChildToTreeNode(tree, parent_index, index);
+    if (kind == ENTRY_DIR && index != SIZE_MAX) {
+        WalkSubtreeNow(cache, tree, path, index, entries);
+    }
+}
+
+// Patches one change into the tree. Events may tell of what a walk already saw, so adding
+// what is there or removing what is not changes nothing. Returns false when the tree has to be
+// walked again instead.
+static bool ApplyFileEvent(FileCache* cache, FileTree* tree, const struct inotify_event* event, DirEntryList* entries) {
+    if (event->mask & IN_Q_OVERFLOW) return false;
+    if (event->wd < 0 || (size_t)event->wd >= tree->watch_node_capacity) return true;
+    size_t parent_index = tree->watch_nodes[event->wd];
+    if (parent_index == SIZE_MAX) return true;
+
+    if (event->mask & IN_IGNORED) {
+        tree->watch_nodes[event->wd] = SIZE_MAX;
+        tree->watches[parent_index] = -1;
+        return true;
+    }
+    // Other directories going away are events of their parent, only the root has none
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) return parent_index != tree->root_index;
+    if (event->len == 0 || IsSkippedEntry(event->name)) return true;
+
+    size_t index = FindFileTreeChild(tree, parent_index, event->name);
+    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (index != SIZE_MAX) {
+            DetachTreeNode(cache, tree, parent_index, index);
+        }
+    } else if (event->mask & IN_MOVED_TO) {
+        // Moved over an entry of the same name, which may have been something else
+        if (index != SIZE_MAX) {
+            DetachTreeNode(cache, tree, parent_index, index);
+        }
+        AddChangedEntry(cache, tree, parent_index, event->name, entries);
+    } else if ((event->mask & IN_CREATE) && index == SIZE_MAX) {
+        AddChangedEntry(cache, tree, parent_index, event->name, entries);
+    }
+    return true;
+}
+
+// Patches the changes since the last call into the active tree. Returns false when it has to
+// be walked again instead, after an overflow or once half of its nodes are detached or half of
+// its children entries unused.
+static bool ApplyFileEvents(FileCache* cache) {
+    FileTree* tree = cache->active;
+    char events[FILE_TREE_EVENTS_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    DirEntryList entries = {0};
+    bool ok = true;
+
+    ssize_t length;
+    while (ok && (length = read(cache->watch_fd, events, sizeof(events))) > 0) {
+        for (char* at = events; at < events + length && ok;) {
+            const struct inotify_event* event = (const struct inotify_event*)at;
+            at += sizeof(struct inotify_event) + event->len;
+            ok = !tree || ApplyFileEvent(cache, tree, event, &entries);
+        }
+    }
+    ClearDirEntryList(&entries);
+    return ok && (!tree || (tree->detached_count * 2 <= tree->count && tree->unused_children * 2 <= tree->children_length));
+}
+#endif
+
+// Called once a frame on the thread that reads the tree. With nothing changed on disk that is
+// one read of the event queue coming back empty.
+void UpdateFileCache(FileCache* cache, double current_time) {
+    if (cache->walking && __atomic_load_n(&cache->walk_done, __ATOMIC_ACQUIRE)) {
+        JoinFileCacheWalk(cache);
+    }
+    if (cache->walking) return;
+
+    if (cache->watch_fd >= 0 && __atomic_load_n(&cache->watch_failed, __ATOMIC_RELAXED)) {
+        // Some directories could not be watched, changes in them would go unseen
+        fprintf(stderr, "Could not watch all of: %s (out of watches), walking it every %.0f s instead\n", cache->root, cache->scan_interval);
+        close(cache->watch_fd);
+        cache->watch_fd = -1;
+    }
+
+    bool walk = current_time - cache->last_scan_time >= cache->scan_interval;
+#ifdef __linux__
+    if (cache->watch_fd >= 0) {
+        walk = !ApplyFileEvents(cache);
+    }
+#endif
+    if (walk) {
+        StartFileCacheWalk(cache, current_time);
+    }
+}
+
+// The last complete tree, NULL until the first walk is over
+FileTree* GetFileTree(FileCache* cache) {
+    return __atomic_load_n(&cache->active, __ATOMIC_ACQUIRE);
+}
+
+void ClearFileCache(FileCache* cache) {
+    if (cache->walking) {
+        // Walks do not stop early, a large tree would only be finished for nothing anyway
+        for (size_t i = 0; i < cache->thread_count; ++i) {
+            pthread_join(cache->threads[i], NULL);
+        }
+        cache->thread_count = 0;
+        FreeFileTree(cache->building);
+    }
+    FreeFileTree(cache->active);
+    for (size_t i = 0; i < cache->queue_count; ++i) {
+        free(cache->queues[i].items);
+        pthread_mutex_destroy(&cache->queues[i].lock);
+    }
+    pthread_mutex_destroy(&cache->tree_lock);
+    if (cache->watch_fd >= 0) {
+        close(cache->watch_fd);
+    }
+    free(cache->root);
+    *cache = (FileCache){0};
+    cache->watch_fd = -1;
+}
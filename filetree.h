@@ -0,0 +1,132 @@
+#ifndef FILETREE_H
+#define FILETREE_H
+
+#include <pthread.h>
+
+#include "funcore.h"
+
+#define FILE_TREE_MAX_THREADS 64
+#define INITIAL_FILE_TREE_CAPACITY 256
+#define INITIAL_FILE_TREE_NAMES_CAPACITY 4096
+#define INITIAL_WALK_QUEUE_CAPACITY 64
+#define FILE_TREE_NO_PARENT UINT32_MAX
+// Bytes of directory records read with one getdents64
+#define FILE_TREE_RECORDS_SIZE (64 << 10)
+// Longest path put together for an entry, deeper ones are left out of the tree
+#define FILE_TREE_PATH_MAX 4096
+// Seconds between two walks of the whole tree where changes cannot be watched
+#define FILE_TREE_SCAN_INTERVAL 3.0
+// Bytes of change events read at a time
+#define FILE_TREE_EVENTS_SIZE (64 << 10)
+
+typedef enum {
+    NODE_FILE,
+    NODE_DIR
+} NodeType;
+
+// Nodes are indices into parallel arrays. A node keeps its name and its parent, its path is
+// put together from those when asked for.
+typedef struct {
+    uint8_t* types;
+    uint32_t* parents;
+    uint32_t* name_offsets;
+    uint32_t* child_starts;
+    uint32_t* child_counts;
+    // Watch on the directory, -1 if it has none
+    int* watches;
+    size_t count;
+    size_t capacity;
+
+    // Names one after another, each with its NUL
+    char* names;
+    size_t names_length;
+    size_t names_capacity;
+
+    // The children of each node are one range of this array. Walkers add all children of a
+    // directory at once, so its range is appended in one piece. A node gaining a child while
+    // its range is not the last one moves the range to the end and leaves a hole.
+    uint32_t* children;
+    size_t children_length;
+    size_t children_capacity;
+    // Entries of children left behind by moved ranges and detached nodes
+    size_t unused_children;
+
+    char* root_path;
+    size_t root_index;
+    size_t file_count;
+    size_t dir_count;
+
+    // Node of each watch, SIZE_MAX for watches of no node
+    size_t* watch_nodes;
+    size_t watch_node_capacity;
+    // Nodes taken out of the tree by changes, they stay in nodes until the next walk
+    size_t detached_count;
+} FileTree;
+
+typedef struct {
+    char* path;
+    size_t index;
+} PendingDir;
+
+struct FileCache;
+
+// Directories one walker still has to read. The walker takes the one it queued last, so it
+// goes deep while idle walkers steal from the other end and get the large untouched subtrees.
+typedef struct {
+    struct FileCache* cache;
+    size_t index;
+
+    pthread_mutex_t lock;
+    PendingDir* items;
+    size_t front;
+    size_t back;
+    size_t capacity;
+} WalkQueue;
+
+// The tree of a directory, walked by a pool of threads. Readers only ever see a complete tree:
+// the walk builds a new one on the side and the walker finishing it swaps it in for the active
+// one. Walkers watch every directory they read with inotify, after that changes on disk are
+// patched into the active tree and it is only walked again when the event queue overflowed.
+// Without inotify the tree is walked again every FILE_TREE_SCAN_INTERVAL seconds.
+typedef struct FileCache {
+    char* root;
+
+    // active is swapped with acquire and release. After a swap building holds the tree that was
+    // replaced, until UpdateFileCache frees it on the thread that reads the tree.
+    FileTree* active;
+    FileTree* building;
+    // Held while a walker adds the entries of one directory to the tree being built
+    pthread_mutex_t tree_lock;
+
+    WalkQueue queues[FILE_TREE_MAX_THREADS];
+    size_t queue_count;
+    pthread_t threads[FILE_TREE_MAX_THREADS];
+    size_t thread_count;
+    // Directories queued or being read, the walk is over when it drops to zero
+    size_t outstanding;
+    int walk_done;
+    bool walking;
+
+    // -1 when changes are not watched. Set to stop watching, a watch could not be added.
+    int watch_fd;
+    int watch_failed;
+
+    double last_scan_time;
+    double scan_interval;
+} FileCache;
+
+FileTree* CreateFileTree();
+void FreeFileTree(FileTree* tree);
+size_t AddNodeToTree(FileTree* tree, NodeType type, size_t parent_index, const char* name, size_t name_length);
+void AddChildToTreeNode(FileTree* tree, size_t parent_index, size_t child_index);
+const char* GetFileTreeName(const FileTree* tree, size_t index);
+size_t GetFileTreePath(const FileTree* tree, size_t index, char* out, size_t capacity);
+size_t FindFileTreeChild(FileTree* tree, size_t parent_index, const char* name);
+
+bool InitFileCache(FileCache* cache, const char* root, size_t thread_count);
+bool StartFileCacheWalk(FileCache* cache, double current_time);
+void UpdateFileCache(FileCache* cache, double current_time);
+FileTree* GetFileTree(FileCache* cache);
+void ClearFileCache(FileCache* cache);
+
+#endif
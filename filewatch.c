@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include "filewatch.h"
+
+#ifdef __linux__
+    #include <errno.h>
+    #include <sys/inotify.h>
+#endif
+
+#define FILE_WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+typedef struct {
+    size_t start;
+    size_t length;
+    uint64_t hash;
+} DiffLine;
+
+typedef struct {
+    size_t old_start;
+    size_t old_length;
+    size_t new_start;
+    size_t new_length;
+} DiffHunk;
+
+bool GetFileIdentity(const char* path, FileIdentity* identity) {
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0) return false;
+
+    identity->size = file_stat.st_size;
+    identity->inode = file_stat.st_ino;
+#ifdef _WIN32
+    identity->mtime_sec = file_stat.st_mtime;
+    identity->mtime_nsec = 0;
+#else
+    identity->mtime_sec = file_stat.st_mtim.tv_sec;
+    identity->mtime_nsec = file_stat.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+void InitFileWatcher(FileWatcher* watcher) {
+#ifdef __linux__
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0) {
+        fprintf(stderr, "Could not watch files: %s\n", strerror(errno));
+    }
+#else
+    watcher->fd = -1;
+#endif
+    watcher->watches = malloc(INITIAL_FILE_WATCH_CAPACITY * sizeof(FileWatch));
+    watcher->count = 0;
+    watcher->capacity = INITIAL_FILE_WATCH_CAPACITY;
+}
+
+static int AddDirectoryWatch(FileWatcher* watcher, const char* path, const char* name) {
+#ifdef __linux__
+    if (watcher->fd < 0) return -1;
+
+    size_t directory_length = name - path;
+    char* directory = directory_length > 0 ? strndup(path, directory_length > 1 ? directory_length - 1 : 1) : strdup(".");
+    int watch_descriptor = inotify_add_watch(watcher->fd, directory, FILE_WATCH_EVENTS);
+    if (watch_descriptor < 0) {
+        fprintf(stderr, "Could not watch directory: %s (%s)\n", directory, strerror(errno));
+    }
+    free(directory);
+    return watch_descriptor;
+#else
+    return -1;
+#endif
+}
+
+FileWatch* FindFileWatch(FileWatcher* watcher, size_t buffer_index) {
+    for (size_t i = 0; i < watcher->count; ++i) {
+        if (watcher->watches[i].buffer_index == buffer_index) return &watcher->watches[i];
+    }
+    return NULL;
+}
+
+// Starts watching the file of a buffer, or follows it to its new path. The file on disk holds
+// the text the buffer had at synced_revision.
+FileWatch* WatchFile(FileWatcher* watcher, size_t buffer_index, TextBuffer* buffer, uint64_t synced_revision) {
+    if (!buffer->file_path) return NULL;
+
+    FileWatch* watch = FindFileWatch(watcher, buffer_index);
+    if (!watch) {
+        if (watcher->count >= watcher->capacity) {
+            watcher->capacity *= 2;
+            watcher->watches = realloc(watcher->watches, watcher->capacity * sizeof(FileWatch));
+        }
+        watch = &watcher->watches[watcher->count++];
+        *watch = (FileWatch){ .buffer_index = buffer_index, .watch_descriptor = -1 };
+    }
+
+    if (!watch->path || strcmp(watch->path, buffer->file_path) != 0) {
+        free(watch->path);
+        watch->path = strdup(buffer->file_path);
+        const char* slash = strrchr(watch->path, '/');
+        watch->name = slash ? slash + 1 : watch->path;
+        watch->watch_descriptor = AddDirectoryWatch(watcher, watch->path, watch->name);
+    }
+    if (!GetFileIdentity(watch->path, &watch->identity)) {
+        watch->identity = (FileIdentity){0};
+    }
+    watch->synced_revision = synced_revision;
+    watch->changed = false;
+    return watch;
+}
+
+// Reads the pending events and marks the watches whose file they name, returns how many
+// watches are marked
+size_t PollFileWatcher(FileWatcher* watcher) {
+#ifdef __linux__
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (watcher->fd >= 0) {
+        ssize_t length = read(watcher->fd, events, sizeof(events));
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) break;
+
+        for (char* next = events; next < events + length;) {
+            struct inotify_event* event = (struct inotify_event*)next;
+            next += sizeof(struct inotify_event) + event->len;
+            for (size_t i = 0; i < watcher->count; ++i) {
+                FileWatch* watch = &watcher->watches[i];
+                // Dropped events could have been about any of them
+                if ((event->mask & IN_Q_OVERFLOW) || (event->wd == watch->watch_descriptor && event->len > 0 && strcmp(event->name, watch->name) == 0)) {
+                    watch->changed = true;
+                }
+            }
+        }
+    }
+#endif
+
+    size_t changed = 0;
+    for (size_t i = 0; i < watcher->count; ++i) {
+        changed += watcher->watches[i].changed;
+    }
+    return changed;
+}
+
+// False when the file is still what the buffer last matched, as after our own save
+bool HasFileChanged(FileWatch* watch) {
+    FileIdentity identity;
+    if (!GetFileIdentity(watch->path, &identity)) return false;
+    return memcmp(&identity, &watch->identity, sizeof(FileIdentity)) != 0;
+}
+
+// Bytes at the start of text the buffer starts with too
+static size_t GetCommonPrefix(TextBuffer* buffer, const char* text, size_t length) {
+    size_t common = 0;
+    for (size_t i = 0; i < buffer->piece_count && common < length; ++i) {
+        Piece piece = buffer->pieces[i];
+        const char* piece_text = GetPieceBuffer(buffer, piece) + piece.start;
+        size_t count = min(piece.length, length - common);
+        if (memcmp(piece_text, text + common, count) != 0) {
+            size_t j = 0;
+            while (piece_text[j] == text[common + j]) j++;
+            return common + j;
+        }
+        common += count;
+    }
+    return common;
+}
+
+// Bytes at the end of text the buffer ends with too, at most limit
+static size_t GetCommonSuffix(TextBuffer* buffer, const char* text, size_t length, size_t limit) {
+    size_t common = 0;
+    for (size_t i = buffer->piece_count; i-- > 0 && common < limit;) {
+        Piece piece = buffer->pieces[i];
+        const char* piece_end = GetPieceBuffer(buffer, piece) + piece.start + piece.length;
+        const char* text_end = text + length - common;
+        size_t count = min(piece.length, limit - common);
+        if (memcmp(piece_end - count, text_end - count, count) != 0) {
+            size_t j = 0;
+            while (piece_end[-1 - (ptrdiff_t)j] == text_end[-1 - (ptrdiff_t)j]) j++;
+            return common + j;
+        }
+        common += count;
+    }
+    return common;
+}
+
+static DiffLine* SplitDiffLines(const char* text, size_t length, size_t* count) {
+    size_t capacity = 64;
+    DiffLine* lines = malloc(capacity * sizeof(DiffLine));
+    *count = 0;
+    size_t start = 0;
+    while (start < length) {
+        const char* newline = memchr(text + start, '\n', length - start);
+        size_t end = newline ? (size_t)(newline - text) + 1 : length;
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = start; i < end; ++i) {
+            hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+        }
+        if (*count >= capacity) {
+            capacity *= 2;
+            lines = realloc(lines, capacity * sizeof(DiffLine));
+        }
+        lines[(*count)++] = (DiffLine){start, end - start, hash};
+        start = end;
+    }
+    return lines;
+}
+
+static bool IsSameDiffLine(const char* old_text, DiffLine old_line, const char* new_text, DiffLine new_line) {
+    return old_line.hash == new_line.hash && old_line.length == new_line.length && memcmp(old_text + old_line.start, new_text + new_line.start, old_line.length) == 0;
+}
+
+// Myers' greedy diff over lines, marking the old lines deleted and the new lines inserted.
+// Gives up once more than FILE_DIFF_MAX_EDITS edits would be needed.
+static bool DiffLines(const char* old_text, DiffLine* old_lines, size_t old_count, const char* new_text, DiffLine* new_lines, size_t new_count, bool* deleted, bool* inserted) {
+    ptrdiff_t n = old_count;
+    ptrdiff_t m = new_count;
+    ptrdiff_t max_edits = min(n + m, (ptrdiff_t)FILE_DIFF_MAX_EDITS);
+    ptrdiff_t offset = max_edits + 1;
+    ptrdiff_t* v = calloc(2 * offset + 1, sizeof(ptrdiff_t));
+    // Furthest x on each diagonal -d..d after round d, kept to walk the path back
+    ptrdiff_t** trace = calloc(max_edits + 1, sizeof(ptrdiff_t*));
+
+    ptrdiff_t edits = -1;
+    for (ptrdiff_t d = 0; d <= max_edits && edits < 0; ++d) {
+        for (ptrdiff_t k = -d; k <= d; k += 2) {
+            ptrdiff_t x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            ptrdiff_t y = x - k;
+            while (x < n && y < m && IsSameDiffLine(old_text, old_lines[x], new_text, new_lines[y])) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                edits = d;
+                break;
+            }
+        }
+        trace[d] = malloc((2 * d + 1) * sizeof(ptrdiff_t));
+        memcpy(trace[d], v + offset - d, (2 * d + 1) * sizeof(ptrdiff_t));
+    }
+
+    ptrdiff_t x = n;
+    ptrdiff_t y = m;
+    for (ptrdiff_t d = edits; d > 0; --d) {
+        const ptrdiff_t* previous = trace[d - 1] + d - 1;
+        ptrdiff_t k = x - y;
+        bool down = k == -d || (k != d && previous[k - 1] < previous[k + 1]);
+        ptrdiff_t previous_k = down ? k + 1 : k - 1;
+        ptrdiff_t previous_x = previous[previous_k];
+        ptrdiff_t previous_y = previous_x - previous_k;
+        if (down) {
+            inserted[previous_y] = true;
+        } else {
+            deleted[previous_x] = true;
+        }
+        x = previous_x;
+        y = previous_y;
+    }
+
+    for (ptrdiff_t d = 0; d <= max_edits && trace[d]; ++d) {
+        free(trace[d]);
+    }
+    free(trace);
+    free(v);
+    return edits >= 0;
+}
+
+// Turns the lines the diff marked into byte ranges, lines left unmarked pair up in order
+static size_t CollectDiffHunks(DiffLine* old_lines, size_t old_count, size_t old_length, DiffLine* new_lines, size_t new_count, size_t new_length, const bool* deleted, const bool* inserted, DiffHunk* hunks) {
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < old_count || j < new_count) {
+        if (i < old_count && j < new_count && !deleted[i] && !inserted[j]) {
+            i++;
+            j++;
+            continue;
+        }
+        DiffHunk hunk = { i < old_count ? old_lines[i].start : old_length, 0, j < new_count ? new_lines[j].start : new_length, 0 };
+        while (i < old_count && deleted[i]) i++;
+        while (j < new_count && inserted[j]) j++;
+        hunk.old_length = (i < old_count ? old_lines[i].start : old_length) - hunk.old_start;
+        hunk.new_length = (j < new_count ? new_lines[j].start : new_length) - hunk.new_start;
+        hunks[count++] = hunk;
+    }
+    return count;
+}
+
+// Records a hunk for undo and applies it
+static void ReplaceTextRange(TextBuffer* buffer, size_t position, size_t removed, const char* text, size_t inserted) {
+    if (removed > 0) {
+        char* deleted_text = GetTextRange(buffer, position, position + removed);
+        buffer->pointer_position = position + removed;
+        PushCommand(buffer, EDIT_DELETE, position, deleted_text, removed);
+        free(deleted_text);
+        DeleteRange(buffer, position, removed);
+    }
+    if (inserted > 0) {
+        buffer->pointer_position = position;
+        PushCommand(buffer, EDIT_INSERT, position, text, inserted);
+        InsertString(buffer, position, (char*)text, inserted);
+    }
+}
+
+static size_t MapThroughHunks(size_t position, const DiffHunk* hunks, size_t count, size_t base) {
+    ptrdiff_t shift = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t start = base + hunks[i].old_start;
+        if (position < start) break;
+        if (position < start + hunks[i].old_length) return base + hunks[i].new_start;
+        shift += (ptrdiff_t)hunks[i].new_length - (ptrdiff_t)hunks[i].old_length;
+    }
+    return position + shift;
+}
+
+static bool IsLineStart(const char* text, size_t position) {
+    return position == 0 || text[position - 1] == '\n';
+}
+
+// Makes the buffer hold text by editing only the lines that differ, as one undo step. The
+// pointer and selection stay on the text they were on. Returns the number of hunks.
+size_t ApplyFileDiff(TextBuffer* buffer, const char* text, size_t length, FileReload* result) {
+    size_t prefix = GetCommonPrefix(buffer, text, length);
+    size_t suffix = GetCommonSuffix(buffer, text, length, min(buffer->text_size, length) - prefix);
+    if (prefix == length && suffix == 0 && length == buffer->text_size) return 0;
+
+    // Only whole lines are compared, the common ends have to start lines on both sides
+    while (prefix > 0 && text[prefix - 1] != '\n') prefix--;
+    while (suffix > 0 && !(IsLineStart(text, length - suffix) && (buffer->text_size == suffix || GetCharAt(buffer, buffer->text_size - suffix - 1) == '\n'))) {
+        suffix--;
+    }
+
+    size_t old_length = buffer->text_size - prefix - suffix;
+    size_t new_length = length - prefix - suffix;
+    char* old_text = malloc(max(old_length, (size_t)1));
+    CopyTextRange(buffer, prefix, old_length, old_text);
+    const char* new_text = text + prefix;
+
+    size_t old_count;
+    size_t new_count;
+    DiffLine* old_lines = SplitDiffLines(old_text, old_length, &old_count);
+    DiffLine* new_lines = SplitDiffLines(new_text, new_length, &new_count);
+    bool* deleted = calloc(old_count + 1, sizeof(bool));
+    bool* inserted = calloc(new_count + 1, sizeof(bool));
+    DiffHunk* hunks = malloc((min(old_count, new_count) + 1) * sizeof(DiffHunk));
+    size_t hunk_count;
+    if (DiffLines(old_text, old_lines, old_count, new_text, new_lines, new_count, deleted, inserted)) {
+        hunk_count = CollectDiffHunks(old_lines, old_count, old_length, new_lines, new_count, new_length, deleted, inserted, hunks);
+    } else {
+        hunks[0] = (DiffHunk){0, old_length, 0, new_length};
+        hunk_count = 1;
+    }
+
+    size_t pointer = MapThroughHunks(buffer->pointer_position, hunks, hunk_count, prefix);
+    size_t selection_start = MapThroughHunks(buffer->selection_start, hunks, hunk_count, prefix);
+    size_t selection_end = MapThroughHunks(buffer->selection_end, hunks, hunk_count, prefix);
+
+    // Back to front, so the positions of the hunks still to go stay valid
+    BeginEditTransaction(buffer);
+    for (size_t i = hunk_count; i-- > 0;) {
+        DiffHunk hunk = hunks[i];
+        ReplaceTextRange(buffer, prefix + hunk.old_start, hunk.old_length, new_text + hunk.new_start, hunk.new_length);
+        result->removed += hunk.old_length;
+        result->inserted += hunk.new_length;
+    }
+    EndEditTransaction(buffer);
+    buffer->pointer_position = pointer;
+    buffer->selection_start = selection_start;
+    buffer->selection_end = selection_end;
+    result->hunks += hunk_count;
+
+    free(hunks);
+    free(inserted);
+    free(deleted);
+    free(new_lines);
+    free(old_lines);
+    free(old_text);
+    return hunk_count;
+}
+
+// A file that only grew is read from its old end. The bytes before it are checked against
+// the end of the buffer and the rest is appended.
+static bool AppendGrownFile(TextBuffer* buffer, const char* path, size_t old_size, size_t new_size, FileReload* result) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    size_t check = min(old_size, (size_t)FILE_RELOAD_CHECK_SIZE);
+    size_t length = new_size - old_size + check;
+    char* text = malloc(length + 1);
+    bool ok = fseek(f, (long)(old_size - check), SEEK_SET) == 0 && fread(text, 1, length, f) == length;
+    fclose(f);
+
+    // Both parts lose their CRLFs on their own, as the old end did when it was read
+    size_t check_length = ok ? StripCarriageReturns(text, check, NULL) : 0;
+    size_t appended_length = 0;
+    ok = ok && check_length <= buffer->text_size;
+    if (ok) {
+        appended_length = StripCarriageReturns(text + check, length - check, NULL);
+        memmove(text + check_length, text + check, appended_length);
+        char* tail = GetTextRange(buffer, buffer->text_size - check_length, buffer->text_size);
+        ok = memcmp(tail, text, check_length) == 0;
+        free(tail);
+    }
+    if (ok && appended_length > 0) {
+        size_t pointer = buffer->pointer_position;
+        ReplaceTextRange(buffer, buffer->text_size, 0, text + check_length, appended_length);
+        buffer->pointer_position = pointer;
+        result->hunks = 1;
+        result->inserted = appended_length;
+    }
+    result->appended = ok;
+    free(text);
+    return ok;
+}
+
+// Brings the buffer in line with its file on disk and records the state it now matches
+bool ReloadTextBuffer(TextBuffer* buffer, FileWatch* watch, FileReload* result) {
+    *result = (FileReload){0};
+    FileIdentity identity;
+    if (!GetFileIdentity(watch->path, &identity)) return false;
+
+    bool untouched = buffer->revision == watch->synced_revision;
+    bool grown = identity.inode == watch->identity.inode && identity.size > watch->identity.size;
+    if (!untouched || !grown || !AppendGrownFile(buffer, watch->path, watch->identity.size, identity.size, result)) {
+        size_t length;
+        char* text = LoadFile(watch->path, &length);
+        if (!text) return false;
+        ApplyFileDiff(buffer, text, StripCarriageReturns(text, length, NULL), result);
+        free(text);
+    }
+
+    watch->identity = identity;
+    watch->synced_revision = buffer->revision;
+    watch->changed = false;
+    return true;
+}
+
+// Reads what was appended to a followed file since the last call and adds it to the end of
+// the buffer without an undo step. A file that was truncated or replaced is reloaded.
+bool FollowFile(FileWatch* watch, TextBuffer* buffer, FileReload* result) {
+    *result = (FileReload){0};
+    FileIdentity identity;
+    if (!GetFileIdentity(watch->path, &identity)) return false;
+    if (identity.inode != watch->identity.inode || identity.size < watch->identity.size) {
+        return ReloadTextBuffer(buffer, watch, result);
+    }
+    if (identity.size == watch->identity.size) {
+        watch->identity = identity;
+        return true;
+    }
+
+    FILE* f = fopen(watch->path, "rb");
+    if (!f) return false;
+    size_t offset = watch->identity.size;
+    size_t length = min(identity.size - offset, (uint64_t)FILE_FOLLOW_READ_SIZE);
+    char* text = malloc(length);
+    size_t read = fseek(f, (long)offset, SEEK_SET) == 0 ? fread(text, 1, length, f) : 0;
+    fclose(f);
+
+    // A CR at the end of what was read could be half of a CRLF, it waits for the rest
+    if (read > 1 && text[read - 1] == '\r' && offset + read < identity.size) {
+        read--;
+    }
+    bool synced = buffer->revision == watch->synced_revision;
+    size_t appended = StripCarriageReturns(text, read, NULL);
+    AppendOriginalText(buffer, text, appended);
+    free(text);
+    result->appended = true;
+    result->inserted = appended;
+    result->hunks = appended > 0;
+
+    watch->identity.size = offset + read;
+    if (watch->identity.size == identity.size) {
+        watch->identity = identity;
+    } else {
+        // More is waiting, taken in on the next poll even without another event
+        watch->changed = true;
+    }
+    if (synced) {
+        watch->synced_revision = buffer->revision;
+    }
+    return true;
+}
+
+void ClearFileWatcher(FileWatcher* watcher) {
+#ifdef __linux__
+    if (watcher->fd >= 0) {
+        close(watcher->fd);
+    }
+#endif
+    watcher->fd = -1;
+    for (size_t i = 0; i < watcher->count; ++i) {
+        free(watcher->watches[i].path);
+    }
+    free(watcher->watches);
+    watcher->watches = NULL;
+    watcher->count = 0;
+    watcher->capacity = 0;
+}
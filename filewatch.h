@@ -0,0 +1,63 @@
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include "funcore.h"
+
+// Bytes before the old end of a file that only grew compared with the buffer before the
+// new bytes are appended
+#define FILE_RELOAD_CHECK_SIZE 4096
+// Lines the diff may insert and delete before the rest of a change is taken as one hunk
+#define FILE_DIFF_MAX_EDITS 512
+#define INITIAL_FILE_WATCH_CAPACITY 8
+// Most bytes a followed file takes in per call, the rest comes in on the next one
+#define FILE_FOLLOW_READ_SIZE (4 << 20)
+
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t inode;
+} FileIdentity;
+
+// An open file and the state of it the buffer last matched. The parent directory is watched
+// rather than the file, so a file replaced by a rename is still seen.
+typedef struct {
+    char* path;
+    const char* name;
+    int watch_descriptor;
+    size_t buffer_index;
+
+    // identity.size is also how far into the file a followed buffer has read
+    FileIdentity identity;
+    uint64_t synced_revision;
+    bool changed;
+    bool follow;
+} FileWatch;
+
+// inotify watches on the files of the open buffers, changes are only noted when polled
+typedef struct {
+    int fd;
+    FileWatch* watches;
+    size_t count;
+    size_t capacity;
+} FileWatcher;
+
+typedef struct {
+    size_t hunks;
+    size_t removed;
+    size_t inserted;
+    bool appended;
+} FileReload;
+
+bool GetFileIdentity(const char* path, FileIdentity* identity);
+void InitFileWatcher(FileWatcher* watcher);
+FileWatch* WatchFile(FileWatcher* watcher, size_t buffer_index, TextBuffer* buffer, uint64_t synced_revision);
+FileWatch* FindFileWatch(FileWatcher* watcher, size_t buffer_index);
+size_t PollFileWatcher(FileWatcher* watcher);
+bool HasFileChanged(FileWatch* watch);
+size_t ApplyFileDiff(TextBuffer* buffer, const char* text, size_t length, FileReload* result);
+bool ReloadTextBuffer(TextBuffer* buffer, FileWatch* watch, FileReload* result);
+bool FollowFile(FileWatch* watch, TextBuffer* buffer, FileReload* result);
+void ClearFileWatcher(FileWatcher* watcher);
+
+#endif
@@ -0,0 +1,1361 @@
+#define _GNU_SOURCE
+#include "funcore.h"
+
+// Monotonic clock that works without a window, GetTime() only runs after InitWindow()
+double GetWallTime() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+size_t GetProcessorCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return max((size_t)1, (size_t)info.dwNumberOfProcessors);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+CommandSystem InitCommandSystem() {
+    CommandSystem system;
+    system.command_buffer = calloc(INITIAL_COMMAND_BUFFER_CAPACITY, sizeof(char));
+    system.command_buffer_capacity = INITIAL_COMMAND_BUFFER_CAPACITY;
+    system.pointer_position = 0;
+
+    InitCommandRegistry(&system.registry);
+    InitCommandArgs(&system.args);
+
+    return system;
+}
+
+void CommandSystemInsertString(CommandSystem* system, char* value, size_t len) {
+    size_t command_buffer_length = strlen(system->command_buffer);
+    while (command_buffer_length + len >= system->command_buffer_capacity) {
+        system->command_buffer = realloc(system->command_buffer, system->command_buffer_capacity * 2 * sizeof(char));
+        system->command_buffer_capacity *= 2;
+    }
+    memmove(system->command_buffer + system->pointer_position + len, system->command_buffer + system->pointer_position, command_buffer_length - system->pointer_position + 1);
+    memcpy(system->command_buffer + system->pointer_position, value, len);
+    system->pointer_position += len;
+}
+
+void CommandSystemRemoveChar(CommandSystem* system) {
+    size_t command_buffer_length = strlen(system->command_buffer);
+    
+    if (system->pointer_position >= command_buffer_length) {
+        return;
+    }
+    
+    memmove(system->command_buffer + system->pointer_position,
+            system->command_buffer + system->pointer_position + 1,
+            command_buffer_length - system->pointer_position);
+}
+
+void CommandSystemBackspace(CommandSystem* system) {
+    if (system->pointer_position == 0) {
+        return;
+    }
+    
+    system->pointer_position--;
+    CommandSystemRemoveChar(system);
+}
+
+void MoveCommandPointerLeft(CommandSystem* system) {
+    if (system->pointer_position <= 0) return;
+    system->pointer_position--;
+}
+
+void MoveCommandPointerRight(CommandSystem* system) {
+    size_t command_buffer_length = strlen(system->command_buffer);
+    if (system->pointer_position >= command_buffer_length) return;
+    system->pointer_position++;
+}
+
+void ClearCommandBuffer(CommandSystem* system) {
+    system->command_buffer[0] = '\0';
+    system->pointer_position = 0;
+}
+
+void ClearCommandSystem(CommandSystem* system) {
+    if (system->command_buffer) {
+        free(system->command_buffer);
+    }
+
+    system->command_buffer_capacity = 0;
+    system->pointer_position = 0;
+
+    ClearCommandRegistry(&system->registry);
+    ClearCommandArgs(&system->args);
+}
+
+void InitCommandArgs(CommandArgs* args) {
+    args->arena_capacity = INITIAL_COMMAND_BUFFER_CAPACITY;
+    args->arena = malloc(args->arena_capacity);
+    args->args_capacity = INITIAL_COMMAND_BUFFER_CAPACITY / 2 + 1;
+    args->args = malloc(args->args_capacity * sizeof(char*));
+    args->count = 0;
+}
+
+// Splits input into whitespace separated tokens, double quotes group words and are dropped.
+// Stops after an unquoted ';' or newline and returns where the next command starts, NULL at the end.
+const char* ParseCommandArgs(CommandArgs* args, const char* input, size_t length) {
+    // Tokens never take more than the input plus one terminator, so one check covers the whole command
+    if (length + 1 > args->arena_capacity) {
+        args->arena_capacity = length + 1;
+        args->arena = realloc(args->arena, args->arena_capacity);
+    }
+    if (length / 2 + 1 > args->args_capacity) {
+        args->args_capacity = length / 2 + 1;
+        args->args = realloc(args->args, args->args_capacity * sizeof(char*));
+    }
+
+    args->count = 0;
+    char* out = args->arena;
+    bool in_quotes = false;
+    bool in_word = false;
+    size_t i = 0;
+    for (; i < length; ++i) {
+        char c = input[i];
+        if (c == '"') {
+            in_quotes = !in_quotes;
+            if (!in_word) {
+                args->args[args->count++] = out;
+                in_word = true;
+            }
+        } else if (!in_quotes && (c == ' ' || c == '\t')) {
+            if (in_word) {
+                *out++ = '\0';
+                in_word = false;
+            }
+        } else if (!in_quotes && (c == ';' || c == '\n')) {
+            break;
+        } else {
+            if (!in_word) {
+                args->args[args->count++] = out;
+                in_word = true;
+            }
+            *out++ = c;
+        }
+    }
+    if (in_word) {
+        *out = '\0';
+    }
+
+    return i < length ? input + i + 1 : NULL;
+}
+
+void ClearCommandArgs(CommandArgs* args) {
+    if (args->arena) {
+        free(args->arena);
+        args->arena = NULL;
+    }
+    if (args->args) {
+        free(args->args);
+        args->args = NULL;
+    }
+    args->arena_capacity = 0;
+    args->args_capacity = 0;
+    args->count = 0;
+}
+
+uint64_t HashCommandName(const char* name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *name; ++name) {
+        hash ^= (unsigned char)*name;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void InitCommandRegistry(CommandRegistry* registry) {
+    registry->capacity = INITIAL_COMMAND_REGISTRY_CAPACITY;
+    registry->slots = calloc(registry->capacity, sizeof(Command));
+    registry->count = 0;
+}
+
+static Command* FindCommandSlot(Command* slots, size_t capacity, const char* name, uint64_t hash) {
+    size_t index = hash & (capacity - 1);
+    while (slots[index].name && (slots[index].hash != hash || strcmp(slots[index].name, name) != 0)) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &slots[index];
+}
+
+// name must outlive the registry, it is not copied
+void RegisterCommand(CommandRegistry* registry, const char* name, size_t min_args, size_t max_args, CommandHandler handler) {
+    if ((registry->count + 1) * 2 > registry->capacity) {
+        size_t new_capacity = registry->capacity * 2;
+        Command* new_slots = calloc(new_capacity, sizeof(Command));
+        for (size_t i = 0; i < registry->capacity; ++i) {
+            if (registry->slots[i].name) {
+                *FindCommandSlot(new_slots, new_capacity, registry->slots[i].name, registry->slots[i].hash) = registry->slots[i];
+            }
+        }
+        free(registry->slots);
+        registry->slots = new_slots;
+        registry->capacity = new_capacity;
+    }
+
+    uint64_t hash = HashCommandName(name);
+    Command* slot = FindCommandSlot(registry->slots, registry->capacity, name, hash);
+    if (!slot->name) {
+        registry->count++;
+    }
+    *slot = (Command){ .name = name, .hash = hash, .min_args = min_args, .max_args = max_args, .handler = handler };
+}
+
+Command* FindCommand(CommandRegistry* registry, const char* name) {
+    Command* slot = FindCommandSlot(registry->slots, registry->capacity, name, HashCommandName(name));
+    return slot->name ? slot : NULL;
+}
+
+CommandResult ExecuteCommandArgs(CommandRegistry* registry, CommandArgs* args, void* context) {
+    if (args->count == 0) return COMMAND_EMPTY;
+
+    Command* command = FindCommand(registry, args->args[0]);
+    if (!command) return COMMAND_UNKNOWN;
+
+    size_t arg_count = args->count - 1;
+    if (arg_count < command->min_args || arg_count > command->max_args) return COMMAND_BAD_ARITY;
+
+    return command->handler(context, args) ? COMMAND_OK : COMMAND_FAILED;
+}
+
+// Runs every command of a ';' or newline separated script, stops at the first one that fails
+CommandResult ExecuteCommandScript(CommandRegistry* registry, CommandArgs* args, void* context, const char* script) {
+    CommandResult result = COMMAND_EMPTY;
+    const char* end = script + strlen(script);
+    const char* next = script;
+    while (next) {
+        next = ParseCommandArgs(args, next, end - next);
+        CommandResult command_result = ExecuteCommandArgs(registry, args, context);
+        if (command_result == COMMAND_EMPTY) continue;
+
+        result = command_result;
+        if (result != COMMAND_OK) break;
+    }
+    return result;
+}
+
+const char* CommandResultToString(CommandResult result) {
+    switch (result) {
+        case COMMAND_OK: return "ok";
+        case COMMAND_EMPTY: return "empty command";
+        case COMMAND_UNKNOWN: return "unknown command";
+        case COMMAND_BAD_ARITY: return "wrong number of arguments";
+        case COMMAND_FAILED: return "command failed";
+        default: return "unknown result";
+    }
+}
+
+void ClearCommandRegistry(CommandRegistry* registry) {
+    if (registry->slots) {
+        free(registry->slots);
+        registry->slots = NULL;
+    }
+    registry->capacity = 0;
+    registry->count = 0;
+}
+
+// Turns CRLF into LF in place and returns the new length, a CR on its own is kept. The text
+// between CRs moves in whole runs, so this goes at about the speed of memmove.
+size_t StripCarriageReturns(char* text, size_t length, size_t* crlf_count) {
+    const char* end = text + length;
+    const char* in = text;
+    char* out = text;
+    size_t count = 0;
+    for (const char* cr = memchr(in, '\r', end - in); cr; cr = memchr(in, '\r', end - in)) {
+        bool pair = cr + 1 < end && cr[1] == '\n';
+        size_t run = cr + !pair - in;
+        if (out != in) {
+            memmove(out, in, run);
+        }
+        out += run;
+        in = cr + 1;
+        count += pair;
+    }
+    if (out != in) {
+        memmove(out, in, end - in);
+    }
+    out += end - in;
+
+    if (crlf_count) *crlf_count = count;
+    return out - text;
+}
+
+FileType GetFileTypeFromPath(char* path) {
+    struct stat path_stat;
+    if (stat(path, &path_stat) != 0) {
+        return TYPE_ERROR;
+    } else if (S_ISDIR(path_stat.st_mode)) {
+        return TYPE_DIR;
+    } else if (S_ISREG(path_stat.st_mode)) {
+        return TYPE_FILE;
+    }
+
+    return TYPE_ERROR;
+}
+
+char* LoadFile(const char* filename, size_t* out_len) {
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "Could not open file: %s\n", filename);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = ftell(f);
+    rewind(f);
+
+    char* buf = malloc(len + 1);
+    if (!buf) {
+        fclose(f);
+        fprintf(stderr, "Out of memory!\n");
+        return NULL;
+    }
+    fread(buf, 1, len, f);
+    buf[len] = '\0';
+    fclose(f);
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+void ReleaseAddBuffer(char* add_buffer, int* refs) {
+    if (!refs) {
+        free(add_buffer);
+    } else if (__atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(add_buffer);
+        free(refs);
+    }
+}
+
+void ClearEditEntry(EditEntry* entry) {
+    if (!entry) return;
+    
+    if (entry->text) {
+        free(entry->text);
+        entry->text = NULL;
+        entry->length = 0;
+    }
+
+    if (entry->pieces) {
+        free(entry->pieces);
+        entry->pieces = NULL;
+        entry->piece_count = 0;
+        entry->piece_capacity = 0;
+    }
+}
+
+UndoStack InitUndoStack()  {
+    UndoStack stack;
+    stack.entries = calloc(INITIAL_UNDO_STACK_CAPACITY, sizeof(EditEntry));
+    stack.capacity = INITIAL_UNDO_STACK_CAPACITY;
+    stack.count = 0;
+    stack.current = 0;
+    stack.next_group = 0;
+    stack.transaction_group = 0;
+    stack.transaction_depth = 0;
+    return stack;
+}
+
+void ClearUndoStack(UndoStack* stack) {
+    if (!stack) return;
+
+    if (stack->entries) {
+        for (size_t i = 0; i < stack->count; i++) {
+            ClearEditEntry(&stack->entries[i]);
+        }
+        free(stack->entries);
+    }
+    stack->capacity = 0;
+    stack->current = 0;
+    stack->count = 0;
+    stack->transaction_depth = 0;
+}
+
+LineCache InitLineCache() {
+    LineCache cache;
+    cache.capacity = 1024;
+    cache.line_positions = calloc(cache.capacity, sizeof(Position));
+    cache.line_count = 0;
+    cache.is_valid = false;
+    cache.pending_line = 0;
+    cache.pending_shift = 0;
+    return cache;
+}
+
+size_t GetLineStart(LineCache* cache, size_t index) {
+    size_t start = cache->line_positions[index].x;
+    if (index >= cache->pending_line) {
+        start += cache->pending_shift;
+    }
+    return start;
+}
+
+static void ResolveLineShift(LineCache* cache, size_t end_line) {
+    if (end_line > cache->line_count) end_line = cache->line_count;
+    if (end_line <= cache->pending_line) return;
+
+    if (cache->pending_shift != 0) {
+        for (size_t i = cache->pending_line; i < end_line; ++i) {
+            cache->line_positions[i].x += cache->pending_shift;
+        }
+    }
+    cache->pending_line = end_line;
+}
+
+static void ShiftLinesFrom(LineCache* cache, size_t from_line, ptrdiff_t shift) {
+    if (cache->pending_shift == 0) {
+        cache->pending_line = from_line;
+    } else if (from_line >= cache->pending_line) {
+        ResolveLineShift(cache, from_line);
+    } else {
+        for (size_t i = from_line; i < cache->pending_line; ++i) {
+            cache->line_positions[i].x += shift;
+        }
+    }
+    cache->pending_shift += shift;
+}
+
+static void EnsureLineCacheCapacity(LineCache* cache, size_t needed) {
+    while (needed >= cache->capacity) {
+        cache->capacity *= 2;
+        cache->line_positions = realloc(cache->line_positions, cache->capacity * sizeof(Position));
+    }
+}
+
+size_t FindLineIndex(LineCache* cache, size_t position) {
+    size_t low = 0;
+    size_t high = cache->line_count - 1;
+    while (low < high) {
+        size_t mid = low + (high - low + 1) / 2;
+        if (GetLineStart(cache, mid) <= position) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+void LineCacheInsert(LineCache* cache, size_t position, const char* value, size_t len) {
+    if (!cache->is_valid) return;
+
+    size_t line = FindLineIndex(cache, position);
+    ResolveLineShift(cache, line + 1);
+
+    size_t new_lines = 0;
+    for (const char* nl = memchr(value, '\n', len); nl; nl = memchr(nl + 1, '\n', len - (nl + 1 - value))) {
+        new_lines++;
+    }
+
+    if (new_lines == 0) {
+        cache->line_positions[line].y += len;
+    } else {
+        EnsureLineCacheCapacity(cache, cache->line_count + new_lines);
+        Position* lines = cache->line_positions;
+        size_t tail = lines[line].x + lines[line].y - position;
+        memmove(&lines[line + 1 + new_lines], &lines[line + 1], (cache->line_count - line - 1) * sizeof(Position));
+
+        size_t current = line;
+        size_t line_start = lines[line].x;
+        for (const char* nl = memchr(value, '\n', len); nl; nl = memchr(nl + 1, '\n', len - (nl + 1 - value))) {
+            size_t i = nl - value;
+            lines[current].x = line_start;
+            lines[current].y = position + i - line_start;
+            line_start = position + i + 1;
+            current++;
+        }
+        lines[current].x = line_start;
+        lines[current].y = position + len - line_start + tail;
+
+        cache->line_count += new_lines;
+        cache->pending_line += new_lines;
+    }
+    ShiftLinesFrom(cache, line + 1 + new_lines, (ptrdiff_t)len);
+}
+
+void LineCacheDelete(LineCache* cache, size_t position, size_t length) {
+    if (!cache->is_valid) return;
+
+    size_t first = FindLineIndex(cache, position);
+    size_t last = FindLineIndex(cache, position + length);
+    ResolveLineShift(cache, last + 1);
+
+    Position* lines = cache->line_positions;
+    size_t last_end = lines[last].x + lines[last].y;
+    lines[first].y = position - lines[first].x + last_end - (position + length);
+
+    size_t removed = last - first;
+    if (removed > 0) {
+        memmove(&lines[first + 1], &lines[last + 1], (cache->line_count - last - 1) * sizeof(Position));
+        cache->line_count -= removed;
+        cache->pending_line -= removed;
+    }
+    ShiftLinesFrom(cache, first + 1, -(ptrdiff_t)length);
+}
+void ClearLineCache(LineCache* cache) {
+    if (!cache) return;
+    
+    if (cache->line_positions) {
+        free(cache->line_positions);
+        cache->line_positions = NULL;
+    }
+    cache->line_count = 0;
+    cache->capacity = 0;
+    cache->is_valid = false;
+}
+
+size_t GetTextSize(TextBuffer* buffer) {
+    return buffer->text_size;
+}
+
+char* GetPieceBuffer(TextBuffer* buffer, Piece piece) {
+    return piece.source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
+}
+
+// Returns the piece containing position and its text offset in piece_start.
+// Returns piece_count and the text size when position is at the end of the text.
+size_t FindPieceIndex(TextBuffer* buffer, size_t position, size_t* piece_start) {
+    size_t index = buffer->piece_hint;
+    size_t start = buffer->piece_hint_start;
+    if (index > buffer->piece_count) {
+        index = 0;
+        start = 0;
+    }
+
+    while (index > 0 && start > position) {
+        index--;
+        start -= buffer->pieces[index].length;
+    }
+    while (index < buffer->piece_count && start + buffer->pieces[index].length <= position) {
+        start += buffer->pieces[index].length;
+        index++;
+    }
+
+    buffer->piece_hint = index;
+    buffer->piece_hint_start = start;
+    *piece_start = start;
+    return index;
+}
+
+void ReplacePieces(TextBuffer* buffer, size_t index, size_t remove_count, Piece* insert, size_t insert_count) {
+    size_t new_count = buffer->piece_count - remove_count + insert_count;
+    while (new_count > buffer->piece_capacity) {
+        buffer->piece_capacity *= 2;
+        buffer->pieces = realloc(buffer->pieces, buffer->piece_capacity * sizeof(Piece));
+    }
+
+    memmove(&buffer->pieces[index + insert_count], &buffer->pieces[index + remove_count], (buffer->piece_count - index - remove_count) * sizeof(Piece));
+    memcpy(&buffer->pieces[index], insert, insert_count * sizeof(Piece));
+    buffer->piece_count = new_count;
+}
+
+void CopyTextRange(TextBuffer* buffer, size_t start, size_t length, char* out) {
+    size_t piece_start;
+    size_t index = FindPieceIndex(buffer, start, &piece_start);
+    size_t offset = start - piece_start;
+    size_t copied = 0;
+
+    for (; index < buffer->piece_count && copied < length; ++index) {
+        Piece piece = buffer->pieces[index];
+        size_t to_copy = min(piece.length - offset, length - copied);
+        memcpy(out + copied, GetPieceBuffer(buffer, piece) + piece.start + offset, to_copy);
+        copied += to_copy;
+        offset = 0;
+    }
+}
+
+void PushCommand(TextBuffer* buffer, EditType type, size_t position, const char* text, size_t length) {
+    UndoStack* stack = &buffer->undo_stack;
+    for (size_t i = stack->current; i < stack->count; i++) {
+        ClearEditEntry(&stack->entries[i]);      
+    }
+    stack->count = stack->current;
+
+    if (stack->count >= stack->capacity) {
+        if (stack->transaction_depth > 0) {
+            // Dropping the oldest entry could cut into the open transaction, grow instead
+            stack->capacity *= 2;
+            stack->entries = realloc(stack->entries, stack->capacity * sizeof(EditEntry));
+        } else {
+            // The oldest group goes as a whole, undoing part of a macro or a replace all would
+            // leave text that never existed
+            size_t evicted = 0;
+            while (evicted < stack->count && stack->entries[evicted].group == stack->entries[0].group) {
+                ClearEditEntry(&stack->entries[evicted++]);
+            }
+            memmove(stack->entries, stack->entries + evicted, (stack->count - evicted) * sizeof(EditEntry));
+            stack->count -= evicted;
+        }
+    }
+    
+    EditEntry* entry = &stack->entries[stack->count];
+    entry->type = type;
+    entry->group = stack->transaction_depth > 0 ? stack->transaction_group : stack->next_group++;
+    entry->position = position;
+    entry->length = length;
+    entry->cursor_before = buffer->pointer_position;
+    switch (entry->type)
+    {
+        case EDIT_INSERT:
+            entry->cursor_after = buffer->pointer_position + entry->length;
+            break;
+        case EDIT_DELETE:
+            entry->cursor_after = buffer->pointer_position - entry->length;
+            break;
+        case EDIT_REPLACE_PIECES:
+            entry->cursor_after = buffer->pointer_position;
+            break;
+    }
+    entry->pieces = NULL;
+    entry->piece_count = 0;
+    entry->piece_capacity = 0;
+
+    if (text && length > 0) {
+        entry->text = malloc(length + 1);
+        memcpy(entry->text, text, length);
+        entry->text[length] = '\0';
+    } else {
+        entry->text = NULL;
+    }
+
+    stack->count++;
+    stack->current = stack->count;
+}
+
+// Called once the change is in the pieces, inserted_text is NULL for a swapped piece list
+static void RecordTextChange(TextBuffer* buffer, size_t position, size_t removed, size_t inserted, const char* inserted_text) {
+    TextChange change = {position, removed, inserted};
+    buffer->revision++;
+    buffer->changes[buffer->revision % TEXT_CHANGE_LOG_SIZE] = change;
+    if (buffer->change_hook) {
+        buffer->change_hook(buffer->change_hook_context, buffer, change, inserted_text);
+    }
+}
+
+static void SwapPieceList(TextBuffer* buffer, EditEntry* entry) {
+    Piece* pieces = buffer->pieces;
+    size_t piece_count = buffer->piece_count;
+    size_t piece_capacity = buffer->piece_capacity;
+    size_t text_size = buffer->text_size;
+
+    buffer->pieces = entry->pieces;
+    buffer->piece_count = entry->piece_count;
+    buffer->piece_capacity = entry->piece_capacity;
+    buffer->text_size = entry->length;
+
+    entry->pieces = pieces;
+    entry->piece_count = piece_count;
+    entry->piece_capacity = piece_capacity;
+    entry->length = text_size;
+
+    // Piece lists only ever point into the append-only buffers, so either list stays valid.
+    // Everything positional has to be worked out again though.
+    buffer->piece_hint = 0;
+    buffer->piece_hint_start = 0;
+    buffer->line_cache.is_valid = false;
+    buffer->request_revalidate_pointer_cache = true;
+    RecordTextChange(buffer, 0, text_size, buffer->text_size, NULL);
+}
+
+// Installs a whole new piece list as one undo step, the buffer takes ownership of pieces.
+// Used by edits that touch too many places to go through InsertString and DeleteRange.
+void ReplaceTextPieces(TextBuffer* buffer, Piece* pieces, size_t piece_count, size_t piece_capacity, size_t text_size, size_t pointer_position) {
+    PushCommand(buffer, EDIT_REPLACE_PIECES, 0, NULL, 0);
+    EditEntry* entry = &buffer->undo_stack.entries[buffer->undo_stack.current - 1];
+    entry->pieces = pieces;
+    entry->piece_count = piece_count;
+    entry->piece_capacity = piece_capacity;
+    entry->length = text_size;
+    SwapPieceList(buffer, entry);
+
+    buffer->pointer_position = min(pointer_position, text_size);
+    buffer->has_selection = false;
+    entry->cursor_after = buffer->pointer_position;
+}
+
+char GetCharAt(TextBuffer* buffer, size_t position) {
+    if (position >= buffer->text_size) return '\0';
+
+    size_t piece_start;
+    size_t index = FindPieceIndex(buffer, position, &piece_start);
+    Piece piece = buffer->pieces[index];
+    return GetPieceBuffer(buffer, piece)[piece.start + position - piece_start];
+}
+
+void BeginEditTransaction(TextBuffer* buffer) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (stack->transaction_depth++ == 0) {
+        stack->transaction_group = stack->next_group++;
+    }
+}
+
+void EndEditTransaction(TextBuffer* buffer) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (stack->transaction_depth == 0) return;
+    stack->transaction_depth--;
+    buffer->request_revalidate_pointer_cache = true;
+}
+
+bool CanMergeWithPreviousEdit(UndoStack* stack) {
+    if (stack->current == 0) return false;
+
+    EditEntry* prev = &stack->entries[stack->current - 1];
+    if (stack->transaction_depth > 0) {
+        return prev->group == stack->transaction_group;
+    }
+    return stack->current < 2 || stack->entries[stack->current - 2].group != prev->group;
+}
+
+bool TryToMergeCharacterRemove(TextBuffer* buffer, double current_time) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (CanMergeWithPreviousEdit(stack) && current_time - buffer->time_since_last_edit < 1.0) {
+        EditEntry* prev = &stack->entries[stack->current - 1];
+        if (prev->type == EDIT_DELETE && prev->position == buffer->pointer_position) {
+            char deleted = GetCharAt(buffer, buffer->pointer_position - 1);
+
+            char* new_text = malloc(prev->length + 2);
+            new_text[0] = deleted;
+            memcpy(new_text + 1, prev->text, prev->length);
+            new_text[prev->length + 1] = '\0';
+
+            free(prev->text);
+            prev->text = new_text;
+            prev->length++;
+            prev->position--;
+            prev->cursor_after = buffer->pointer_position - 1;
+            
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TryToMergeCharacterInsert(TextBuffer* buffer, char* value, size_t len, double current_time) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (CanMergeWithPreviousEdit(stack) && current_time - buffer->time_since_last_edit < 1.0) {
+        EditEntry* prev = &stack->entries[stack->current - 1];
+        if (prev->type == EDIT_INSERT && 
+            prev->position + prev->length == buffer->pointer_position &&
+            memchr(value, '\n', len) == NULL) {
+            
+            char* new_text = realloc(prev->text, prev->length + len + 1);
+            if (!new_text) {
+                return false;
+            }
+            memcpy(new_text + prev->length, value, len);
+            new_text[prev->length + len] = '\0';
+            prev->text = new_text;
+            prev->length += len;
+            prev->cursor_after = buffer->pointer_position + len;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RebuildLineCache(TextBuffer* buffer) {
+    buffer->line_cache.line_count = 0;
+    buffer->line_cache.line_positions[0].x = 0;
+    buffer->line_cache.line_positions[0].y = 0;
+    size_t current_pos = 0;
+    char* work_buffer;
+
+    for (size_t i = 0; i < buffer->piece_count; ++i) {
+        work_buffer = buffer->pieces[i].source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
+
+        for (size_t j = 0; j < buffer->pieces[i].length; ++j) {
+            if (work_buffer[buffer->pieces[i].start + j] == '\n') {
+                
+                while (buffer->line_cache.line_count + 1 >= buffer->line_cache.capacity) {
+                    buffer->line_cache.capacity *= 2;
+                    buffer->line_cache.line_positions = realloc(buffer->line_cache.line_positions, buffer->line_cache.capacity * sizeof(Position));
+                }
+
+                buffer->line_cache.line_positions[buffer->line_cache.line_count].y = current_pos - buffer->line_cache.line_positions[buffer->line_cache.line_count].x;
+                buffer->line_cache.line_count++;
+                buffer->line_cache.line_positions[buffer->line_cache.line_count].x = current_pos + 1;
+                buffer->line_cache.line_positions[buffer->line_cache.line_count].y = 0;
+            }
+            current_pos++;
+        }
+    }
+    buffer->line_cache.line_positions[buffer->line_cache.line_count].y = current_pos - buffer->line_cache.line_positions[buffer->line_cache.line_count].x;
+    buffer->line_cache.line_count++;
+    buffer->line_cache.pending_line = buffer->line_cache.line_count;
+    buffer->line_cache.pending_shift = 0;
+    buffer->line_cache.is_valid = true;
+}
+
+void InitTextBuffer(TextBuffer* buffer) {
+    buffer->add_buffer = calloc(INITIAL_ADD_BUFFER_CAPACITY, sizeof(char));
+    buffer->add_buffer_capacity = INITIAL_ADD_BUFFER_CAPACITY;    
+    buffer->add_buffer_count = 0;
+    buffer->add_buffer_refs = NULL;
+    buffer->line_ending = LINE_ENDING_LF;
+    buffer->revision = 0;
+    buffer->change_hook = NULL;
+    buffer->change_hook_context = NULL;
+    buffer->journal = NULL;
+
+    buffer->line_cache = InitLineCache();
+    
+    buffer->line_anchor = 0;
+    buffer->offset_x = 0;
+    buffer->pointer_position = 0;
+    buffer->pointer_position_cache = (Position){0, 0};
+    buffer->last_pointer_position_cached = 0;
+    buffer->request_revalidate_pointer_cache = false;
+    buffer->time_since_last_edit = 0;
+
+    buffer->selection_start = 0;
+    buffer->selection_end = 0;
+    buffer->has_selection = false;
+
+    buffer->undo_stack = InitUndoStack();
+}
+
+char* GetTextRange(TextBuffer* buffer, size_t start, size_t end) {
+    size_t length = end - start;
+    char* result = malloc(length + 1);
+    CopyTextRange(buffer, start, length, result);
+    result[length] = '\0';
+    return result;
+}
+
+void InitPieceBuffer(TextBuffer* buffer) {
+    buffer->pieces = calloc(INITIAL_PIECE_BUFFER_CAPACITY, sizeof(Piece));
+    buffer->piece_capacity = INITIAL_PIECE_BUFFER_CAPACITY;
+    buffer->pieces[0].source = ORIGINAL;
+    buffer->pieces[0].start = 0;
+    // The file may hold NUL bytes, the size read is what counts
+    buffer->pieces[0].length = buffer->org_buffer_size;
+    
+    buffer->piece_count = 1;
+    buffer->text_size = buffer->pieces[0].length;
+    buffer->piece_hint = 0;
+    buffer->piece_hint_start = 0;
+}
+
+void InitEmptyTextBuffer(TextBuffer* buffer) {
+    InitTextBuffer(buffer);
+
+    buffer->file_path = NULL;
+    buffer->org_buffer = strdup("");
+    buffer->org_buffer_size = 0;
+
+    InitPieceBuffer(buffer);
+    RebuildLineCache(buffer);
+}
+
+void InitTextBufferFromPath(TextBuffer* buffer, const char* path) {
+    size_t length = 0;
+    char* data = LoadFile(path, &length);
+    InitTextBufferFromData(buffer, path, data, length);
+}
+
+// Makes a buffer of a file read elsewhere, taking over data. data needs room for a NUL after
+// length bytes, a NULL data opens the file empty.
+void InitTextBufferFromData(TextBuffer* buffer, const char* path, char* data, size_t length) {
+    InitTextBuffer(buffer);
+    
+    buffer->file_path = strdup(path);
+    buffer->org_buffer = data ? data : strdup("");
+    size_t crlf_count = 0;
+    buffer->org_buffer_size = StripCarriageReturns(buffer->org_buffer, data ? length : 0, &crlf_count);
+    buffer->org_buffer[buffer->org_buffer_size] = '\0';
+
+    InitPieceBuffer(buffer);
+    RebuildLineCache(buffer);
+    // A file mixing both is saved the way most of its lines end
+    if (crlf_count > 0 && crlf_count * 2 >= buffer->line_cache.line_count - 1) {
+        buffer->line_ending = LINE_ENDING_CRLF;
+    }
+}
+
+Position GetLinePosition(TextBuffer* buffer, size_t index) {
+    if (!buffer->line_cache.is_valid) {
+        RebuildLineCache(buffer);
+    }
+
+    return (Position){GetLineStart(&buffer->line_cache, index), buffer->line_cache.line_positions[index].y};
+}
+
+Position GetLineByIndex(TextBuffer* buffer, size_t index) {
+    return GetLinePosition(buffer, index);
+}
+
+size_t GetLineCount(TextBuffer* buffer)  {
+    if (!buffer->line_cache.is_valid) {
+        RebuildLineCache(buffer);
+    }
+    return buffer->line_cache.line_count;
+}
+
+char* GenerateLine(TextBuffer* buffer, size_t index) {
+    Position line_position = GetLineByIndex(buffer, index);
+    char* line = malloc(line_position.y + 1);
+    CopyTextRange(buffer, line_position.x, line_position.y, line);
+    line[line_position.y] = '\0';
+    return line;
+}
+
+Position IndexToPosition(TextBuffer* buffer, size_t index) {  
+    if (!buffer->line_cache.is_valid) {
+        RebuildLineCache(buffer);
+    }
+
+    size_t line = FindLineIndex(&buffer->line_cache, index);
+    return (Position){index - GetLineStart(&buffer->line_cache, line), line};
+}
+
+Position GetPointerPosition(TextBuffer* buffer) {
+    if (!buffer->request_revalidate_pointer_cache && buffer->pointer_position == buffer->last_pointer_position_cached) return buffer->pointer_position_cache;
+    Position out = IndexToPosition(buffer, buffer->pointer_position);
+
+    buffer->request_revalidate_pointer_cache = false;
+    buffer->pointer_position_cache = out;
+    buffer->last_pointer_position_cached = buffer->pointer_position;
+    return out;
+}
+
+void ClearTextBuffer(TextBuffer* buffer) {
+    if (!buffer) return;
+
+    if (buffer->file_path) {
+        free(buffer->file_path);
+        buffer->file_path = NULL;
+    }
+
+    if (buffer->org_buffer) {
+        free(buffer->org_buffer);
+        buffer->org_buffer = NULL;
+    }
+    buffer->org_buffer_size = 0;
+
+    if (buffer->add_buffer) {
+        ReleaseAddBuffer(buffer->add_buffer, buffer->add_buffer_refs);
+        buffer->add_buffer = NULL;
+        buffer->add_buffer_refs = NULL;
+    }
+    buffer->add_buffer_capacity = 0;
+    buffer->add_buffer_count = 0;
+
+    if (buffer->pieces) {
+        free(buffer->pieces);
+        buffer->pieces = NULL;
+    }
+    buffer->piece_capacity = 0;
+    buffer->piece_count = 0;
+    buffer->text_size = 0;
+    buffer->piece_hint = 0;
+    buffer->piece_hint_start = 0;
+
+    ClearLineCache(&buffer->line_cache);
+
+    buffer->line_anchor = 0;
+    buffer->pointer_position = 0;
+    buffer->selection_start = 0;
+    buffer->selection_end = 0;
+    buffer->has_selection = false;
+
+    ClearUndoStack(&buffer->undo_stack);
+}
+
+void MovePointerLeft(TextBuffer* buffer) {
+    if (buffer->pointer_position > 0) {
+        buffer->pointer_position--;
+        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+    }
+}
+
+void MovePointerRight(TextBuffer* buffer) {
+    if (buffer->pointer_position < GetTextSize(buffer)) {
+        buffer->pointer_position++;
+        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+    }
+}
+
+void MovePointerUp(TextBuffer* buffer) {
+    Position pointer = GetPointerPosition(buffer);
+    if (pointer.y == 0) {
+        return;
+    }
+    Position nextLine = GetLineByIndex(buffer, pointer.y - 1);
+    if (buffer->pointer_position != nextLine.x + min(nextLine.y, pointer.x)) {
+        buffer->pointer_position = nextLine.x + min(nextLine.y, pointer.x);
+        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+    }   
+}
+
+void MovePointerDown(TextBuffer* buffer) {
+    Position pointer = GetPointerPosition(buffer);
+    size_t max_lines = GetLineCount(buffer);
+    if (pointer.y >= max_lines - 1) {
+        return;
+    }
+    Position nextLine = GetLineByIndex(buffer, pointer.y + 1);
+    if (buffer->pointer_position != nextLine.x + min(nextLine.y, pointer.x)) {
+        buffer->pointer_position = nextLine.x + min(nextLine.y, pointer.x);
+        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+    }
+}
+
+bool IsWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool IsPunct(char c) {
+    return c && !IsWordChar(c) && c != ' ' && c != '\t' && c != '\n';
+}
+
+void MovePointerWordRight(TextBuffer* buffer) {
+    size_t size = GetTextSize(buffer);
+    if (buffer->pointer_position >= size) return;
+    char c = GetCharAt(buffer, buffer->pointer_position);
+    
+    if (c == '\n') {
+        buffer->pointer_position++;
+        return;
+    }
+    
+    if (IsWordChar(c)) {
+        while (buffer->pointer_position < size && IsWordChar(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
+    } else if (IsPunct(c)) {
+        while (buffer->pointer_position < size && IsPunct(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
+    } else {
+        while (buffer->pointer_position < size && (c = GetCharAt(buffer, buffer->pointer_position), c == ' ' || c == '\t')) buffer->pointer_position++;
+        if (buffer->pointer_position < size && GetCharAt(buffer, buffer->pointer_position) == '\n') return;
+        while (buffer->pointer_position < size && IsPunct(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
+    }
+}
+
+void MovePointerWordLeft(TextBuffer* buffer) {
+    size_t size = GetTextSize(buffer);
+    if (buffer->pointer_position == 0) return;
+    buffer->pointer_position--;
+    
+    char c = GetCharAt(buffer, buffer->pointer_position);
+    if (c == '\n') return;
+    
+    while (buffer->pointer_position > 0 && (c = GetCharAt(buffer, buffer->pointer_position), c == ' ' || c == '\t')) {
+        if (GetCharAt(buffer, buffer->pointer_position - 1) == '\n') return;
+        buffer->pointer_position--;
+    }
+    
+    c = GetCharAt(buffer, buffer->pointer_position);
+    if (IsWordChar(c)) {
+        while (buffer->pointer_position > 0 && IsWordChar(GetCharAt(buffer, buffer->pointer_position - 1))) buffer->pointer_position--;
+    } else if (IsPunct(c)) {
+        while (buffer->pointer_position > 0 && IsPunct(GetCharAt(buffer, buffer->pointer_position - 1))) buffer->pointer_position--;
+    }
+}
+
+size_t AppendAddBuffer(TextBuffer* buffer, char* value, size_t len) {
+    if (buffer->add_buffer_count + len >= buffer->add_buffer_capacity) {
+        while (buffer->add_buffer_count + len >= buffer->add_buffer_capacity) {
+            buffer->add_buffer_capacity *= 2;
+        }
+        if (buffer->add_buffer_refs) {
+            // Snapshots still read the old block, move out and leave it to them
+            char* grown = malloc(buffer->add_buffer_capacity * sizeof(char));
+            memcpy(grown, buffer->add_buffer, buffer->add_buffer_count);
+            ReleaseAddBuffer(buffer->add_buffer, buffer->add_buffer_refs);
+            buffer->add_buffer = grown;
+            buffer->add_buffer_refs = NULL;
+        } else {
+            buffer->add_buffer = (char*)realloc(buffer->add_buffer, buffer->add_buffer_capacity * sizeof(char));
+        }
+    }
+
+    size_t index = buffer->add_buffer_count;
+    
+    memcpy(&buffer->add_buffer[buffer->add_buffer_count], value, len);
+
+    buffer->add_buffer_count += len;
+    
+    return index;
+}
+
+// The change that produced revision, false once it has dropped out of the log
+bool GetTextChange(TextBuffer* buffer, uint64_t revision, TextChange* change) {
+    if (revision == 0 || revision > buffer->revision || buffer->revision - revision >= TEXT_CHANGE_LOG_SIZE) return false;
+    *change = buffer->changes[revision % TEXT_CHANGE_LOG_SIZE];
+    return true;
+}
+
+void InsertString(TextBuffer* buffer, size_t position, char* value, size_t len) {
+    if (len == 0) return;
+
+    size_t new_start = AppendAddBuffer(buffer, value, len);
+    LineCacheInsert(&buffer->line_cache, position, value, len);
+    buffer->text_size += len;
+    buffer->request_revalidate_pointer_cache = true;
+
+    size_t piece_start;
+    size_t index = FindPieceIndex(buffer, position, &piece_start);
+    Piece* prev = index > 0 ? &buffer->pieces[index - 1] : NULL;
+
+    if (prev && piece_start == position && prev->source == ADD && prev->start + prev->length == new_start) {
+        // Typing right after the previous insert just extends its piece
+        buffer->piece_hint = index - 1;
+        buffer->piece_hint_start = piece_start - prev->length;
+        prev->length += len;
+    } else {
+        Piece new_piece = {ADD, new_start, len};
+        size_t offset = position - piece_start;
+        if (offset == 0) {
+            ReplacePieces(buffer, index, 0, &new_piece, 1);
+        } else {
+            Piece split[3] = { buffer->pieces[index], new_piece, buffer->pieces[index] };
+            split[0].length = offset;
+            split[2].start += offset;
+            split[2].length -= offset;
+            ReplacePieces(buffer, index, 1, split, 3);
+        }
+    }
+    RecordTextChange(buffer, position, 0, len, value);
+}
+
+// Appends text that belongs to the file rather than being an edit, as when a followed log
+// grows. It is not undone, so the piece lists kept for undo get it too. The text is on disk
+// already, so the change hook is not told and a journal does not write it out again.
+void AppendOriginalText(TextBuffer* buffer, char* value, size_t len) {
+    if (len == 0) return;
+
+    Piece piece = {ADD, buffer->add_buffer_count, len};
+    TextChangeHook hook = buffer->change_hook;
+    buffer->change_hook = NULL;
+    InsertString(buffer, buffer->text_size, value, len);
+    buffer->change_hook = hook;
+
+    UndoStack* stack = &buffer->undo_stack;
+    for (size_t i = 0; i < stack->count; ++i) {
+        EditEntry* entry = &stack->entries[i];
+        if (entry->type != EDIT_REPLACE_PIECES) continue;
+        if (entry->piece_count >= entry->piece_capacity) {
+            entry->piece_capacity = max(entry->piece_capacity * 2, (size_t)INITIAL_PIECE_BUFFER_CAPACITY);
+            entry->pieces = realloc(entry->pieces, entry->piece_capacity * sizeof(Piece));
+        }
+        entry->pieces[entry->piece_count++] = piece;
+        entry->length += len;
+    }
+}
+
+void DeleteRange(TextBuffer* buffer, size_t position, size_t length) {
+    if (position >= buffer->text_size || length == 0) return;
+    length = min(length, buffer->text_size - position);
+
+    LineCacheDelete(&buffer->line_cache, position, length);
+    buffer->request_revalidate_pointer_cache = true;
+
+    size_t end = position + length;
+    size_t first_start;
+    size_t first = FindPieceIndex(buffer, position, &first_start);
+    size_t last = first;
+    size_t last_start = first_start;
+    while (last_start + buffer->pieces[last].length < end) {
+        last_start += buffer->pieces[last].length;
+        last++;
+    }
+
+    Piece kept[2];
+    size_t kept_count = 0;
+    if (position > first_start) {
+        kept[kept_count] = buffer->pieces[first];
+        kept[kept_count].length = position - first_start;
+        kept_count++;
+    }
+    size_t last_end = last_start + buffer->pieces[last].length;
+    if (end < last_end) {
+        kept[kept_count] = buffer->pieces[last];
+        kept[kept_count].start += end - last_start;
+        kept[kept_count].length = last_end - end;
+        kept_count++;
+    }
+
+    ReplacePieces(buffer, first, last - first + 1, kept, kept_count);
+    buffer->text_size -= length;
+    RecordTextChange(buffer, position, length, 0, NULL);
+}
+
+bool RemoveCharacter(TextBuffer* buffer, size_t position) {
+    if (position > 0) {
+        DeleteRange(buffer, position - 1, 1);
+        return true;
+    }
+    return false;
+}
+
+void ExecuteDelete(TextBuffer* buffer, size_t position, size_t length) {
+    DeleteRange(buffer, position, length);
+    buffer->pointer_position = position;
+}
+
+void RemoveArea(TextBuffer* buffer, size_t position, size_t length) {
+    char* deleted_text = GetTextRange(buffer, position, position + length);
+    PushCommand(buffer, EDIT_DELETE, position, deleted_text, length);
+    free(deleted_text);
+
+    ExecuteDelete(buffer, position, length);
+}
+
+void RemoveSelection(TextBuffer* buffer) {
+    size_t selection_length = abs((int)(buffer->selection_end) - (int)(buffer->selection_start));
+    RemoveArea(buffer, min(buffer->selection_start, buffer->selection_end), selection_length);
+    buffer->has_selection = false;
+}
+
+void InsertTextAtPointer(TextBuffer* buffer, char* value, size_t len, double current_time) {
+    if (buffer->has_selection) {
+        RemoveSelection(buffer);
+    }
+    if (!TryToMergeCharacterInsert(buffer, value, len, current_time)) {
+        PushCommand(buffer, EDIT_INSERT, buffer->pointer_position, value, len);
+    }
+    InsertString(buffer, buffer->pointer_position, value, len);
+    buffer->pointer_position += len;
+    buffer->time_since_last_edit = current_time;
+}
+
+void RemoveBackwardsAtPointer(TextBuffer* buffer, double current_time) {
+    if (buffer->has_selection) {
+        RemoveSelection(buffer);
+    } else {
+        if (buffer->pointer_position == 0) return;
+
+        if (!TryToMergeCharacterRemove(buffer, current_time)) {
+            char deleted_char = GetCharAt(buffer, buffer->pointer_position - 1);
+            PushCommand(buffer, EDIT_DELETE, buffer->pointer_position - 1, &deleted_char, 1);
+        }
+
+        if (RemoveCharacter(buffer, buffer->pointer_position)) {
+            buffer->pointer_position--;
+        }
+        buffer->time_since_last_edit = current_time;
+    }
+}
+
+void UndoEdit(TextBuffer* buffer) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (stack->current == 0) return;
+
+    size_t group = stack->entries[stack->current - 1].group;
+    while (stack->current > 0 && stack->entries[stack->current - 1].group == group) {
+        stack->current--;
+        EditEntry* entry = &stack->entries[stack->current];
+
+        switch (entry->type) 
+        {
+            case EDIT_INSERT:
+                ExecuteDelete(buffer, entry->position, entry->length);        
+                break;
+            case EDIT_DELETE:
+                InsertString(buffer, entry->position, entry->text, entry->length);
+                break;
+            case EDIT_REPLACE_PIECES:
+                SwapPieceList(buffer, entry);
+                break;
+        }
+
+        buffer->pointer_position = entry->cursor_before;
+    }
+}
+
+void RedoEdit(TextBuffer* buffer) {
+    UndoStack* stack = &buffer->undo_stack;
+    if (stack->current >= stack->count) return;
+    
+    size_t group = stack->entries[stack->current].group;
+    while (stack->current < stack->count && stack->entries[stack->current].group == group) {
+        EditEntry* entry = &stack->entries[stack->current];
+    
+        switch (entry->type) {
+            case EDIT_INSERT: {
+                InsertString(buffer, entry->position, entry->text, entry->length);
+                break;
+            }
+            case EDIT_DELETE: {
+                ExecuteDelete(buffer, entry->position, entry->length);
+                break;
+            }
+            case EDIT_REPLACE_PIECES: {
+                SwapPieceList(buffer, entry);
+                break;
+            }
+        }
+    
+        buffer->pointer_position = entry->cursor_after;
+        stack->current++;
+    }
+}
+
+uint64_t HashTextBuffer(TextBuffer* buffer) {
+    // FNV-1a over the piece contents, used to compare replay results
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < buffer->piece_count; ++i) {
+        char* work_buffer = buffer->pieces[i].source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
+        for (size_t j = 0; j < buffer->pieces[i].length; ++j) {
+            hash ^= (unsigned char)work_buffer[buffer->pieces[i].start + j];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+PieceView GetPieceView(TextBuffer* buffer) {
+    return (PieceView){
+        .org_buffer = buffer->org_buffer,
+        .add_buffer = buffer->add_buffer,
+        .pieces = buffer->pieces,
+        .piece_count = buffer->piece_count,
+        .text_size = buffer->text_size,
+        .line_ending = buffer->line_ending
+    };
+}
+
+const char* GetPieceViewText(PieceView view, Piece piece) {
+    return (piece.source == ORIGINAL ? view.org_buffer : view.add_buffer) + piece.start;
+}
+
+TextSnapshot CreateTextSnapshot(TextBuffer* buffer) {
+    TextSnapshot snapshot;
+    snapshot.pieces = malloc(max(buffer->piece_count, (size_t)1) * sizeof(Piece));
+    memcpy(snapshot.pieces, buffer->pieces, buffer->piece_count * sizeof(Piece));
+    if (!buffer->add_buffer_refs) {
+        buffer->add_buffer_refs = malloc(sizeof(int));
+        *buffer->add_buffer_refs = 1;
+    }
+    __atomic_add_fetch(buffer->add_buffer_refs, 1, __ATOMIC_RELAXED);
+    snapshot.add_buffer = buffer->add_buffer;
+    snapshot.add_buffer_refs = buffer->add_buffer_refs;
+    snapshot.revision = buffer->revision;
+
+    snapshot.view = GetPieceView(buffer);
+    snapshot.view.pieces = snapshot.pieces;
+    snapshot.view.add_buffer = snapshot.add_buffer;
+    return snapshot;
+}
+
+void ClearTextSnapshot(TextSnapshot* snapshot) {
+    if (snapshot->pieces) {
+        free(snapshot->pieces);
+        snapshot->pieces = NULL;
+    }
+    if (snapshot->add_buffer) {
+        ReleaseAddBuffer(snapshot->add_buffer, snapshot->add_buffer_refs);
+        snapshot->add_buffer = NULL;
+        snapshot->add_buffer_refs = NULL;
+    }
+    snapshot->view = (PieceView){0};
+}
@@ -0,0 +1,343 @@
+#ifndef FUNCORE_H
+#define FUNCORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN 
+    #define NOGDI             
+    #define NOUSER               
+    #include <windows.h>
+    #undef WIN32_LEAN_AND_MEAN
+    #undef NOGDI
+    #undef NOUSER
+    
+    #ifndef S_ISDIR
+        #define S_ISDIR(m) (((m) & _S_IFMT) == _S_IFDIR)
+    #endif
+    #ifndef S_ISREG
+        #define S_ISREG(m) (((m) & _S_IFMT) == _S_IFREG)
+    #endif
+#else
+    #include <dirent.h>
+    #include <unistd.h>
+    #include <time.h>
+#endif
+
+#ifndef _WIN32
+    #define min(a, b) ((a) < (b) ? (a) : (b))
+    #define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define ARRAY_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define INITIAL_ADD_BUFFER_CAPACITY 4096
+#define INITIAL_UNDO_STACK_CAPACITY 4096
+#define INITIAL_PIECE_BUFFER_CAPACITY 1024
+#define INITIAL_COMMAND_BUFFER_CAPACITY 1024
+#define INITIAL_COMMAND_REGISTRY_CAPACITY 64
+#define COMMAND_ARGS_UNLIMITED SIZE_MAX
+#define TEXT_CHANGE_LOG_SIZE 64
+
+typedef enum { ORIGINAL, ADD } BufferType;
+typedef enum { TYPE_DIR, TYPE_FILE, TYPE_ERROR } FileType;
+
+// Tokens of one command, all stored in a single arena that is reused between commands
+typedef struct {
+    char* arena;
+    size_t arena_capacity;
+    char** args;
+    size_t args_capacity;
+    size_t count;
+} CommandArgs;
+
+// args->args[0] is the command name, context is whatever the caller passed to ExecuteCommandScript
+typedef bool (*CommandHandler)(void* context, CommandArgs* args);
+
+typedef struct {
+    const char* name;
+    uint64_t hash;
+    size_t min_args;
+    size_t max_args;
+    CommandHandler handler;
+} Command;
+
+// Open addressing hash table keyed by command name, capacity is a power of two
+typedef struct {
+    Command* slots;
+    size_t capacity;
+    size_t count;
+} CommandRegistry;
+
+typedef enum {
+    COMMAND_OK,
+    COMMAND_EMPTY,
+    COMMAND_UNKNOWN,
+    COMMAND_BAD_ARITY,
+    COMMAND_FAILED
+} CommandResult;
+
+typedef struct {
+    char* command_buffer;
+    size_t command_buffer_capacity;
+
+
+    size_t pointer_position;
+
+    CommandRegistry registry;
+    CommandArgs args;
+} CommandSystem;
+
+typedef enum {
+    EDIT_INSERT,
+    EDIT_DELETE,
+    EDIT_REPLACE_PIECES
+} EditType;
+
+typedef struct {
+    BufferType source;
+    size_t start;
+    size_t length;
+} Piece;
+
+typedef struct {
+    EditType type;
+    size_t position;
+    size_t length;
+    char* text;
+    size_t cursor_before;
+    size_t cursor_after;
+    size_t group;
+
+    // EDIT_REPLACE_PIECES keeps the piece list that is not current, undo and redo swap it in.
+    // length holds the text size that goes with it.
+    Piece* pieces;
+    size_t piece_count;
+    size_t piece_capacity;
+} EditEntry;
+
+// Entries sharing a group are undone and redone together, a transaction puts all its edits into one group
+typedef struct {
+    EditEntry* entries;
+    size_t count;
+    size_t capacity;
+    size_t current;
+
+    size_t next_group;
+    size_t transaction_group;
+    size_t transaction_depth;
+} UndoStack;
+
+typedef struct {
+    size_t x;
+    size_t y;
+} Position;
+
+// What one revision did to the text: removed bytes at position were replaced by inserted bytes
+typedef struct {
+    size_t position;
+    size_t removed;
+    size_t inserted;
+} TextChange;
+
+// Edits patch the cache in place. Moving the starts of all following lines is deferred:
+// lines from pending_line on still need pending_shift added to their x.
+typedef struct {
+    Position* line_positions;
+    size_t line_count;
+    size_t capacity;
+    bool is_valid;
+
+    size_t pending_line;
+    ptrdiff_t pending_shift;
+} LineCache;
+
+// How the file writes line breaks. The text itself always uses LF, CRLF is put back on save.
+typedef enum {
+    LINE_ENDING_LF,
+    LINE_ENDING_CRLF
+} LineEnding;
+
+struct TextBuffer;
+struct EditJournal;
+
+// Told about every change to the text once it is made, with the bytes it inserted.
+// inserted is NULL when the whole piece list was swapped, the new text is then in the buffer.
+typedef void (*TextChangeHook)(void* context, struct TextBuffer* buffer, TextChange change, const char* inserted);
+
+typedef struct TextBuffer {
+    char* file_path;
+    LineEnding line_ending;
+
+    char* org_buffer;
+    size_t org_buffer_size;
+
+    char* add_buffer;
+    size_t add_buffer_capacity;
+    size_t add_buffer_count;
+    // Reference count of add_buffer once a snapshot shares it, NULL while the buffer owns it alone
+    int* add_buffer_refs;
+
+    Piece* pieces;
+    size_t piece_capacity;
+    size_t piece_count;
+    size_t text_size;
+    // Bumped by every change to the text, lets caches built on the text tell they are stale
+    uint64_t revision;
+    // The change that led to revision r sits at r % TEXT_CHANGE_LOG_SIZE, so a cache that is
+    // only a few revisions behind can patch the changed regions instead of starting over
+    TextChange changes[TEXT_CHANGE_LOG_SIZE];
+    TextChangeHook change_hook;
+    void* change_hook_context;
+    // Write-ahead log of the edits since the file was saved, NULL when the buffer has none
+    struct EditJournal* journal;
+
+    // Last piece found by FindPieceIndex and its text offset, edits and lookups tend to stay local
+    size_t piece_hint;
+    size_t piece_hint_start;
+
+    LineCache line_cache;
+
+    size_t line_anchor;
+    size_t offset_x;
+
+    size_t pointer_position;
+    size_t selection_start;
+    size_t selection_end;
+
+    double time_since_last_edit;
+
+    Position pointer_position_cache;
+    size_t last_pointer_position_cached;
+    bool request_revalidate_pointer_cache;
+    bool has_selection;
+
+    UndoStack undo_stack;
+} TextBuffer;
+
+// Read-only view of a piece table, either a live TextBuffer or a TextSnapshot
+typedef struct {
+    const char* org_buffer;
+    const char* add_buffer;
+    const Piece* pieces;
+    size_t piece_count;
+    size_t text_size;
+    LineEnding line_ending;
+} PieceView;
+
+// Piece table that other threads can read while the buffer keeps changing. Only the pieces
+// are copied: the original buffer never changes and the add buffer is only appended to.
+// When the add buffer has to grow the buffer moves to a new block and leaves the shared
+// one to its snapshots, the last one to let go frees it.
+typedef struct {
+    PieceView view;
+    Piece* pieces;
+    char* add_buffer;
+    int* add_buffer_refs;
+    uint64_t revision;
+} TextSnapshot;
+
+double GetWallTime();
+size_t GetProcessorCount();
+
+CommandSystem InitCommandSystem();
+void CommandSystemInsertString(CommandSystem* system, char* value, size_t len);
+void CommandSystemRemoveChar(CommandSystem* system);
+void CommandSystemBackspace(CommandSystem* system);
+void MoveCommandPointerLeft(CommandSystem* system);
+void MoveCommandPointerRight(CommandSystem* system);
+void ClearCommandBuffer(CommandSystem* system);
+void ClearCommandSystem(CommandSystem* system);
+
+void InitCommandArgs(CommandArgs* args);
+const char* ParseCommandArgs(CommandArgs* args, const char* input, size_t length);
+void ClearCommandArgs(CommandArgs* args);
+uint64_t HashCommandName(const char* name);
+void InitCommandRegistry(CommandRegistry* registry);
+void RegisterCommand(CommandRegistry* registry, const char* name, size_t min_args, size_t max_args, CommandHandler handler);
+Command* FindCommand(CommandRegistry* registry, const char* name);
+CommandResult ExecuteCommandArgs(CommandRegistry* registry, CommandArgs* args, void* context);
+CommandResult ExecuteCommandScript(CommandRegistry* registry, CommandArgs* args, void* context, const char* script);
+const char* CommandResultToString(CommandResult result);
+void ClearCommandRegistry(CommandRegistry* registry);
+
+size_t StripCarriageReturns(char* text, size_t length, size_t* crlf_count);
+FileType GetFileTypeFromPath(char* path);
+char* LoadFile(const char* filename, size_t* out_len);
+
+void ReleaseAddBuffer(char* add_buffer, int* refs);
+void ClearEditEntry(EditEntry* entry);
+UndoStack InitUndoStack();
+void ClearUndoStack(UndoStack* stack);
+
+LineCache InitLineCache();
+size_t GetLineStart(LineCache* cache, size_t index);
+size_t FindLineIndex(LineCache* cache, size_t position);
+void LineCacheInsert(LineCache* cache, size_t position, const char* value, size_t len);
+void LineCacheDelete(LineCache* cache, size_t position, size_t length);
+void ClearLineCache(LineCache* cache);
+
+size_t GetTextSize(TextBuffer* buffer);
+char* GetPieceBuffer(TextBuffer* buffer, Piece piece);
+size_t FindPieceIndex(TextBuffer* buffer, size_t position, size_t* piece_start);
+void ReplacePieces(TextBuffer* buffer, size_t index, size_t remove_count, Piece* insert, size_t insert_count);
+void CopyTextRange(TextBuffer* buffer, size_t start, size_t length, char* out);
+void PushCommand(TextBuffer* buffer, EditType type, size_t position, const char* text, size_t length);
+void ReplaceTextPieces(TextBuffer* buffer, Piece* pieces, size_t piece_count, size_t piece_capacity, size_t text_size, size_t pointer_position);
+char GetCharAt(TextBuffer* buffer, size_t position);
+void BeginEditTransaction(TextBuffer* buffer);
+void EndEditTransaction(TextBuffer* buffer);
+bool CanMergeWithPreviousEdit(UndoStack* stack);
+bool TryToMergeCharacterRemove(TextBuffer* buffer, double current_time);
+bool TryToMergeCharacterInsert(TextBuffer* buffer, char* value, size_t len, double current_time);
+void RebuildLineCache(TextBuffer* buffer);
+void InitTextBuffer(TextBuffer* buffer);
+char* GetTextRange(TextBuffer* buffer, size_t start, size_t end);
+void InitPieceBuffer(TextBuffer* buffer);
+void InitEmptyTextBuffer(TextBuffer* buffer);
+void InitTextBufferFromPath(TextBuffer* buffer, const char* path);
+void InitTextBufferFromData(TextBuffer* buffer, const char* path, char* data, size_t length);
+Position GetLinePosition(TextBuffer* buffer, size_t index);
+Position GetLineByIndex(TextBuffer* buffer, size_t index);
+size_t GetLineCount(TextBuffer* buffer);
+char* GenerateLine(TextBuffer* buffer, size_t index);
+Position IndexToPosition(TextBuffer* buffer, size_t index);
+Position GetPointerPosition(TextBuffer* buffer);
+void ClearTextBuffer(TextBuffer* buffer);
+
+void MovePointerLeft(TextBuffer* buffer);
+void MovePointerRight(TextBuffer* buffer);
+void MovePointerUp(TextBuffer* buffer);
+void MovePointerDown(TextBuffer* buffer);
+bool IsWordChar(char c);
+bool IsPunct(char c);
+void MovePointerWordRight(TextBuffer* buffer);
+void MovePointerWordLeft(TextBuffer* buffer);
+
+size_t AppendAddBuffer(TextBuffer* buffer, char* value, size_t len);
+bool GetTextChange(TextBuffer* buffer, uint64_t revision, TextChange* change);
+void InsertString(TextBuffer* buffer, size_t position, char* value, size_t len);
+void AppendOriginalText(TextBuffer* buffer, char* value, size_t len);
+void DeleteRange(TextBuffer* buffer, size_t position, size_t length);
+bool RemoveCharacter(TextBuffer* buffer, size_t position);
+void ExecuteDelete(TextBuffer* buffer, size_t position, size_t length);
+void RemoveArea(TextBuffer* buffer, size_t position, size_t length);
+void RemoveSelection(TextBuffer* buffer);
+void InsertTextAtPointer(TextBuffer* buffer, char* value, size_t len, double current_time);
+void RemoveBackwardsAtPointer(TextBuffer* buffer, double current_time);
+void UndoEdit(TextBuffer* buffer);
+void RedoEdit(TextBuffer* buffer);
+
+uint64_t HashTextBuffer(TextBuffer* buffer);
+
+PieceView GetPieceView(TextBuffer* buffer);
+const char* GetPieceViewText(PieceView view, Piece piece);
+TextSnapshot CreateTextSnapshot(TextBuffer* buffer);
+void ClearTextSnapshot(TextSnapshot* snapshot);
+
+#endif // FUNCORE_H
@@ -0,0 +1,846 @@
+#define _GNU_SOURCE
+#include "funregex.h"
+
+#define REGEX_REPEAT_INFINITE -1
+#define REGEX_MAX_REPEAT 1000
+
+typedef enum {
+    REGEX_AST_EMPTY,
+    REGEX_AST_SET,
+    REGEX_AST_CONCAT,
+    REGEX_AST_ALT,
+    REGEX_AST_REPEAT,
+    REGEX_AST_BOL,
+    REGEX_AST_EOL
+} RegexAstType;
+
+typedef struct {
+    RegexAstType type;
+    int left;
+    int right;
+    int min;
+    int max;
+    bool greedy;
+    uint8_t set[32];
+} RegexAst;
+
+typedef struct {
+    const char* pattern;
+    const char* cursor;
+    RegexAst* nodes;
+    size_t count;
+    size_t capacity;
+    char* error;
+    size_t error_capacity;
+} RegexParser;
+
+bool RegexSetHas(const uint8_t* set, unsigned char c) {
+    return set[c >> 3] & (1 << (c & 7));
+}
+
+static void RegexSetAdd(uint8_t* set, unsigned char c) {
+    set[c >> 3] |= 1 << (c & 7);
+}
+
+static void RegexSetAddRange(uint8_t* set, unsigned char from, unsigned char to) {
+    for (unsigned c = from; c <= to; ++c) {
+        RegexSetAdd(set, c);
+    }
+}
+
+static void RegexSetInvert(uint8_t* set) {
+    for (size_t i = 0; i < 32; ++i) {
+        set[i] = ~set[i];
+    }
+}
+
+static bool RegexFail(RegexParser* parser, const char* message) {
+    if (parser->error[0] == '\0') {
+        snprintf(parser->error, parser->error_capacity, "%s at offset %zu", message, (size_t)(parser->cursor - parser->pattern));
+    }
+    return false;
+}
+
+static int AddRegexAst(RegexParser* parser, RegexAstType type) {
+    if (parser->count >= parser->capacity) {
+        parser->capacity = parser->capacity ? parser->capacity * 2 : 64;
+        parser->nodes = realloc(parser->nodes, parser->capacity * sizeof(RegexAst));
+    }
+    parser->nodes[parser->count] = (RegexAst){ .type = type, .left = -1, .right = -1 };
+    return parser->count++;
+}
+
+static int AddRegexAstPair(RegexParser* parser, RegexAstType type, int left, int right) {
+    int index = AddRegexAst(parser, type);
+    parser->nodes[index].left = left;
+    parser->nodes[index].right = right;
+    return index;
+}
+
+// \d \w \s and their negations, returns false for anything else
+static bool AddRegexClassEscape(uint8_t* set, char c) {
+    uint8_t class_set[32] = {0};
+    switch (c) {
+        case 'd': case 'D':
+            RegexSetAddRange(class_set, '0', '9');
+            break;
+        case 'w': case 'W':
+            RegexSetAddRange(class_set, 'a', 'z');
+            RegexSetAddRange(class_set, 'A', 'Z');
+            RegexSetAddRange(class_set, '0', '9');
+            RegexSetAdd(class_set, '_');
+            break;
+        case 's': case 'S':
+            RegexSetAdd(class_set, ' ');
+            RegexSetAddRange(class_set, '\t', '\r');
+            break;
+        default:
+            return false;
+    }
+    if (c == 'D' || c == 'W' || c == 'S') {
+        RegexSetInvert(class_set);
+    }
+    for (size_t i = 0; i < 32; ++i) {
+        set[i] |= class_set[i];
+    }
+    return true;
+}
+
+static int HexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Single byte escape after the backslash, the cursor is left after it
+static bool ParseRegexEscapedByte(RegexParser* parser, unsigned char* out) {
+    char c = *parser->cursor;
+    if (c == '\0') return RegexFail(parser, "trailing backslash");
+    parser->cursor++;
+
+    switch (c) {
+        case 'n': *out = '\n'; return true;
+        case 't': *out = '\t'; return true;
+        case 'r': *out = '\r'; return true;
+        case 'f': *out = '\f'; return true;
+        case 'v': *out = '\v'; return true;
+        case '0': *out = '\0'; return true;
+        case 'x': {
+            int high = HexDigitValue(parser->cursor[0]);
+            int low = high < 0 ? -1 : HexDigitValue(parser->cursor[1]);
+            if (low < 0) return RegexFail(parser, "\\x needs two hex digits");
+            parser->cursor += 2;
+            *out = (unsigned char)(high * 16 + low);
+            return true;
+        }
+        default:
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+                parser->cursor--;
+                return RegexFail(parser, "unknown escape");
+            }
+            *out = (unsigned char)c;
+            return true;
+    }
+}
+
+static int ParseRegexClass(RegexParser* parser) {
+    int index = AddRegexAst(parser, REGEX_AST_SET);
+    uint8_t set[32] = {0};
+    bool negate = false;
+    if (*parser->cursor == '^') {
+        negate = true;
+        parser->cursor++;
+    }
+
+    bool first = true;
+    while (*parser->cursor != ']' || first) {
+        if (*parser->cursor == '\0') return RegexFail(parser, "missing ]"), -1;
+        first = false;
+
+        unsigned char low;
+        if (*parser->cursor == '\\') {
+            parser->cursor++;
+            if (AddRegexClassEscape(set, *parser->cursor)) {
+                parser->cursor++;
+                continue;
+            }
+            if (!ParseRegexEscapedByte(parser, &low)) return -1;
+        } else {
+            low = (unsigned char)*parser->cursor++;
+        }
+
+        unsigned char high = low;
+        if (parser->cursor[0] == '-' && parser->cursor[1] != ']' && parser->cursor[1] != '\0') {
+            parser->cursor++;
+            if (*parser->cursor == '\\') {
+                parser->cursor++;
+                if (!ParseRegexEscapedByte(parser, &high)) return -1;
+            } else {
+                high = (unsigned char)*parser->cursor++;
+            }
+            if (high < low) return RegexFail(parser, "invalid range"), -1;
+        }
+        RegexSetAddRange(set, low, high);
+    }
+    parser->cursor++;
+
+    if (negate) {
+        RegexSetInvert(set);
+    }
+    memcpy(parser->nodes[index].set, set, sizeof(set));
+    return index;
+}
+
+static int ParseRegexAlternation(RegexParser* parser);
+
+static int ParseRegexAtom(RegexParser* parser) {
+    char c = *parser->cursor;
+    switch (c) {
+        case '(': {
+            parser->cursor++;
+            if (parser->cursor[0] == '?' && parser->cursor[1] == ':') {
+                parser->cursor += 2;
+            }
+            int inner = ParseRegexAlternation(parser);
+            if (inner < 0) return -1;
+            if (*parser->cursor != ')') return RegexFail(parser, "missing )"), -1;
+            parser->cursor++;
+            return inner;
+        }
+        case '[':
+            parser->cursor++;
+            return ParseRegexClass(parser);
+        case '^':
+            parser->cursor++;
+            return AddRegexAst(parser, REGEX_AST_BOL);
+        case '$':
+            parser->cursor++;
+            return AddRegexAst(parser, REGEX_AST_EOL);
+        case '*': case '+': case '?':
+            return RegexFail(parser, "nothing to repeat"), -1;
+        default:
+            break;
+    }
+
+    int index = AddRegexAst(parser, REGEX_AST_SET);
+    uint8_t* set = parser->nodes[index].set;
+    parser->cursor++;
+    if (c == '.') {
+        RegexSetAddRange(set, 0, 255);
+        set['\n' >> 3] &= ~(1 << ('\n' & 7));
+    } else if (c == '\\') {
+        if (AddRegexClassEscape(set, *parser->cursor)) {
+            parser->cursor++;
+        } else {
+            unsigned char byte;
+            if (!ParseRegexEscapedByte(parser, &byte)) return -1;
+            RegexSetAdd(set, byte);
+        }
+    } else {
+        RegexSetAdd(set, (unsigned char)c);
+    }
+    return index;
+}
+
+// {m}, {m,} or {m,n}, anything else is taken as a literal brace by the caller
+static bool ParseRegexBounds(RegexParser* parser, int* min_count, int* max_count) {
+    const char* c = parser->cursor + 1;
+    if (*c < '0' || *c > '9') return false;
+
+    long low = strtol(c, (char**)&c, 10);
+    long high = low;
+    if (*c == ',') {
+        c++;
+        high = REGEX_REPEAT_INFINITE;
+        if (*c >= '0' && *c <= '9') {
+            high = strtol(c, (char**)&c, 10);
+        }
+    }
+    if (*c != '}') return false;
+
+    parser->cursor = c + 1;
+    *min_count = (int)min(low, (long)REGEX_MAX_REPEAT + 1);
+    *max_count = high == REGEX_REPEAT_INFINITE ? REGEX_REPEAT_INFINITE : (int)min(high, (long)REGEX_MAX_REPEAT + 1);
+    return true;
+}
+
+static int ParseRegexRepeat(RegexParser* parser) {
+    int atom = ParseRegexAtom(parser);
+    if (atom < 0) return -1;
+
+    for (;;) {
+        int min_count, max_count;
+        char c = *parser->cursor;
+        if (c == '*') {
+            min_count = 0;
+            max_count = REGEX_REPEAT_INFINITE;
+            parser->cursor++;
+        } else if (c == '+') {
+            min_count = 1;
+            max_count = REGEX_REPEAT_INFINITE;
+            parser->cursor++;
+        } else if (c == '?') {
+            min_count = 0;
+            max_count = 1;
+            parser->cursor++;
+        } else if (c == '{' && ParseRegexBounds(parser, &min_count, &max_count)) {
+            if (min_count > REGEX_MAX_REPEAT || max_count > REGEX_MAX_REPEAT) return RegexFail(parser, "repeat count too large"), -1;
+            if (max_count != REGEX_REPEAT_INFINITE && max_count < min_count) return RegexFail(parser, "invalid repeat bounds"), -1;
+        } else {
+            return atom;
+        }
+
+        bool greedy = true;
+        if (*parser->cursor == '?') {
+            greedy = false;
+            parser->cursor++;
+        }
+
+        int repeat = AddRegexAstPair(parser, REGEX_AST_REPEAT, atom, -1);
+        parser->nodes[repeat].min = min_count;
+        parser->nodes[repeat].max = max_count;
+        parser->nodes[repeat].greedy = greedy;
+        atom = repeat;
+    }
+}
+
+static int ParseRegexConcat(RegexParser* parser) {
+    int node = -1;
+    while (*parser->cursor != '\0' && *parser->cursor != '|' && *parser->cursor != ')') {
+        int next = ParseRegexRepeat(parser);
+        if (next < 0) return -1;
+        node = node < 0 ? next : AddRegexAstPair(parser, REGEX_AST_CONCAT, node, next);
+    }
+    return node < 0 ? AddRegexAst(parser, REGEX_AST_EMPTY) : node;
+}
+
+static int ParseRegexAlternation(RegexParser* parser) {
+    int node = ParseRegexConcat(parser);
+    while (node >= 0 && *parser->cursor == '|') {
+        parser->cursor++;
+        int right = ParseRegexConcat(parser);
+        if (right < 0) return -1;
+        node = AddRegexAstPair(parser, REGEX_AST_ALT, node, right);
+    }
+    return node;
+}
+
+static int AddRegexNode(RegexProgram* program, RegexNodeType type, int out, int out1) {
+    if (program->count >= program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 64;
+        program->nodes = realloc(program->nodes, program->capacity * sizeof(RegexNode));
+    }
+    program->nodes[program->count] = (RegexNode){ .type = type, .out = out, .out1 = out1 };
+    return program->count++;
+}
+
+// Continuation passing Thompson construction, returns the entry node of ast followed by next.
+// The reversed program matches the text backwards, so concatenations flip and ^ and $ swap.
+static int CompileRegexAst(RegexProgram* program, const RegexAst* nodes, int ast, int next, bool reverse) {
+    if (next < 0 || program->count >= REGEX_MAX_NODES) return -1;
+
+    const RegexAst* node = &nodes[ast];
+    switch (node->type) {
+        case REGEX_AST_EMPTY:
+            return next;
+        case REGEX_AST_SET: {
+            int index = AddRegexNode(program, REGEX_NODE_SET, next, -1);
+            memcpy(program->nodes[index].set, node->set, sizeof(node->set));
+            return index;
+        }
+        case REGEX_AST_BOL:
+            return AddRegexNode(program, reverse ? REGEX_NODE_EOL : REGEX_NODE_BOL, next, -1);
+        case REGEX_AST_EOL:
+            return AddRegexNode(program, reverse ? REGEX_NODE_BOL : REGEX_NODE_EOL, next, -1);
+        case REGEX_AST_CONCAT:
+            if (reverse) {
+                return CompileRegexAst(program, nodes, node->right, CompileRegexAst(program, nodes, node->left, next, reverse), reverse);
+            }
+            return CompileRegexAst(program, nodes, node->left, CompileRegexAst(program, nodes, node->right, next, reverse), reverse);
+        case REGEX_AST_ALT: {
+            int left = CompileRegexAst(program, nodes, node->left, next, reverse);
+            int right = CompileRegexAst(program, nodes, node->right, next, reverse);
+            if (left < 0 || right < 0) return -1;
+            return AddRegexNode(program, REGEX_NODE_SPLIT, left, right);
+        }
+        case REGEX_AST_REPEAT: {
+            int cont = next;
+            if (node->max == REGEX_REPEAT_INFINITE) {
+                int split = AddRegexNode(program, REGEX_NODE_SPLIT, -1, -1);
+                int body = CompileRegexAst(program, nodes, node->left, split, reverse);
+                if (body < 0) return -1;
+                program->nodes[split].out = node->greedy ? body : next;
+                program->nodes[split].out1 = node->greedy ? next : body;
+                cont = split;
+            } else {
+                // x{2,4} becomes xx(x(x)?)?, every optional copy can skip straight to next
+                for (int i = node->min; i < node->max; ++i) {
+                    int body = CompileRegexAst(program, nodes, node->left, cont, reverse);
+                    if (body < 0) return -1;
+                    cont = node->greedy ? AddRegexNode(program, REGEX_NODE_SPLIT, body, next) : AddRegexNode(program, REGEX_NODE_SPLIT, next, body);
+                }
+            }
+            for (int i = 0; i < node->min; ++i) {
+                cont = CompileRegexAst(program, nodes, node->left, cont, reverse);
+                if (cont < 0) return -1;
+            }
+            return cont;
+        }
+    }
+    return -1;
+}
+
+static bool CompileRegexProgram(RegexProgram* program, const RegexAst* nodes, int root, bool reverse, bool unanchored) {
+    *program = (RegexProgram){0};
+    int match = AddRegexNode(program, REGEX_NODE_MATCH, -1, -1);
+    program->start = CompileRegexAst(program, nodes, root, match, reverse);
+    program->anchored_start = program->start;
+    program->restart = -1;
+    if (program->start < 0) return false;
+
+    if (unanchored) {
+        // Lowest priority loop over any byte in front, so earlier starts always win
+        int split = AddRegexNode(program, REGEX_NODE_SPLIT, program->start, -1);
+        int any = AddRegexNode(program, REGEX_NODE_SET, split, -1);
+        memset(program->nodes[any].set, 0xFF, sizeof(program->nodes[any].set));
+        program->nodes[split].out1 = any;
+        program->start = split;
+        program->restart = any;
+    }
+    return true;
+}
+
+static void ClearRegexProgram(RegexProgram* program) {
+    if (program->nodes) {
+        free(program->nodes);
+        program->nodes = NULL;
+    }
+    program->count = 0;
+    program->capacity = 0;
+}
+
+static void ResetDfaStates(LazyDfa* dfa) {
+    memset(dfa->table, 0, dfa->table_capacity * sizeof(int32_t));
+    dfa->list_count = 0;
+    dfa->start_states[0] = -1;
+    dfa->start_states[1] = -1;
+
+    // State 0 is the dead state with no threads left
+    dfa->states[DFA_DEAD] = (DfaState){0};
+    dfa->state_count = 1;
+    memset(dfa->transitions, 0xFF, DFA_STRIDE * sizeof(int32_t));
+}
+
+static void InitLazyDfa(LazyDfa* dfa, bool longest) {
+    size_t node_count = dfa->program.count;
+    dfa->longest = longest;
+
+    dfa->state_capacity = 64;
+    dfa->states = malloc(dfa->state_capacity * sizeof(DfaState));
+    dfa->transitions = malloc(dfa->state_capacity * DFA_STRIDE * sizeof(int32_t));
+    dfa->list_capacity = 1024;
+    dfa->lists = malloc(dfa->list_capacity * sizeof(int));
+    dfa->table_capacity = 128;
+    dfa->table = malloc(dfa->table_capacity * sizeof(int32_t));
+
+    dfa->next_list = malloc(node_count * sizeof(int));
+    dfa->next_count = 0;
+    dfa->next_cut = false;
+    dfa->stack = malloc((node_count * 2 + 1) * sizeof(int));
+    dfa->step_stack = malloc((node_count * 2 + 1) * sizeof(int));
+    dfa->next_marks = calloc(node_count, sizeof(uint32_t));
+    dfa->step_marks = calloc(node_count, sizeof(uint32_t));
+    dfa->next_mark = 0;
+    dfa->step_mark = 0;
+
+    ResetDfaStates(dfa);
+}
+
+static void ClearLazyDfa(LazyDfa* dfa) {
+    ClearRegexProgram(&dfa->program);
+    free(dfa->states);
+    free(dfa->transitions);
+    free(dfa->lists);
+    free(dfa->table);
+    free(dfa->next_list);
+    free(dfa->stack);
+    free(dfa->step_stack);
+    free(dfa->next_marks);
+    free(dfa->step_marks);
+    *dfa = (LazyDfa){0};
+}
+
+static uint64_t HashDfaList(const int* list, size_t count, bool line_start) {
+    uint64_t hash = 14695981039346656037ULL ^ line_start;
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= (uint32_t)list[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool DfaStateEquals(LazyDfa* dfa, int32_t index, const int* list, size_t count, bool line_start) {
+    DfaState* state = &dfa->states[index];
+    return state->line_start == line_start && state->list_length == count && memcmp(dfa->lists + state->list_start, list, count * sizeof(int)) == 0;
+}
+
+static void InsertDfaTable(LazyDfa* dfa, int32_t index) {
+    DfaState* state = &dfa->states[index];
+    uint64_t hash = HashDfaList(dfa->lists + state->list_start, state->list_length, state->line_start);
+    size_t slot = hash & (dfa->table_capacity - 1);
+    while (dfa->table[slot]) {
+        slot = (slot + 1) & (dfa->table_capacity - 1);
+    }
+    dfa->table[slot] = index + 1;
+}
+
+static int32_t AddDfaState(LazyDfa* dfa, const int* list, size_t count, bool line_start) {
+    if (count == 0) return DFA_DEAD;
+
+    uint64_t hash = HashDfaList(list, count, line_start);
+    size_t slot = hash & (dfa->table_capacity - 1);
+    while (dfa->table[slot]) {
+        if (DfaStateEquals(dfa, dfa->table[slot] - 1, list, count, line_start)) return dfa->table[slot] - 1;
+        slot = (slot + 1) & (dfa->table_capacity - 1);
+    }
+
+    if (dfa->state_count >= dfa->state_capacity) {
+        dfa->state_capacity *= 2;
+        dfa->states = realloc(dfa->states, dfa->state_capacity * sizeof(DfaState));
+        dfa->transitions = realloc(dfa->transitions, dfa->state_capacity * DFA_STRIDE * sizeof(int32_t));
+    }
+    while (dfa->list_count + count > dfa->list_capacity) {
+        dfa->list_capacity *= 2;
+        dfa->lists = realloc(dfa->lists, dfa->list_capacity * sizeof(int));
+    }
+
+    int32_t index = dfa->state_count++;
+    memcpy(dfa->lists + dfa->list_count, list, count * sizeof(int));
+    dfa->states[index] = (DfaState){ .list_start = dfa->list_count, .list_length = count, .line_start = line_start };
+    dfa->list_count += count;
+    memset(dfa->transitions + (size_t)index * DFA_STRIDE, 0xFF, DFA_STRIDE * sizeof(int32_t));
+
+    if (dfa->state_count * 2 > dfa->table_capacity) {
+        dfa->table_capacity *= 2;
+        dfa->table = realloc(dfa->table, dfa->table_capacity * sizeof(int32_t));
+        memset(dfa->table, 0, dfa->table_capacity * sizeof(int32_t));
+        for (int32_t i = 1; i < (int32_t)dfa->state_count; ++i) {
+            InsertDfaTable(dfa, i);
+        }
+    } else {
+        dfa->table[slot] = index + 1;
+    }
+    return index;
+}
+
+static void BeginDfaList(LazyDfa* dfa) {
+    if (dfa->next_mark >= UINT32_MAX - 2 || dfa->step_mark >= UINT32_MAX - 2) {
+        memset(dfa->next_marks, 0, dfa->program.count * sizeof(uint32_t));
+        memset(dfa->step_marks, 0, dfa->program.count * sizeof(uint32_t));
+        dfa->next_mark = 0;
+        dfa->step_mark = 0;
+    }
+    dfa->next_mark++;
+    dfa->step_mark++;
+    dfa->next_count = 0;
+    dfa->next_cut = false;
+}
+
+// Appends the nodes reachable from node without consuming a byte in priority order.
+// Anything after a match has lower priority than it and is dropped unless longest is set.
+static void AddDfaClosure(LazyDfa* dfa, int node, bool line_start) {
+    const RegexNode* nodes = dfa->program.nodes;
+    int* stack = dfa->stack;
+    size_t top = 0;
+    stack[top++] = node;
+    while (top > 0) {
+        int id = stack[--top];
+        if (dfa->next_marks[id] == dfa->next_mark) continue;
+        dfa->next_marks[id] = dfa->next_mark;
+
+        switch (nodes[id].type) {
+            case REGEX_NODE_SPLIT:
+                stack[top++] = nodes[id].out1;
+                stack[top++] = nodes[id].out;
+                break;
+            case REGEX_NODE_BOL:
+                if (line_start) stack[top++] = nodes[id].out;
+                break;
+            case REGEX_NODE_MATCH:
+                if (dfa->next_cut) break;
+                dfa->next_list[dfa->next_count++] = id;
+                dfa->next_cut = !dfa->longest;
+                break;
+            default:
+                if (dfa->next_cut) break;
+                dfa->next_list[dfa->next_count++] = id;
+                break;
+        }
+    }
+}
+
+// Steps a set or match node on c, returns true when a match cuts off the remaining threads
+static bool StepDfaNode(LazyDfa* dfa, int id, int c, bool* matched) {
+    const RegexNode* node = &dfa->program.nodes[id];
+    if (node->type == REGEX_NODE_MATCH) {
+        *matched = true;
+        return !dfa->longest;
+    }
+    if (node->type == REGEX_NODE_SET && c != DFA_END_OF_TEXT && RegexSetHas(node->set, (unsigned char)c)) {
+        AddDfaClosure(dfa, node->out, c == '\n');
+    }
+    return false;
+}
+
+// $ holds in front of c, follow what comes after it without consuming anything
+static bool StepDfaLineEnd(LazyDfa* dfa, int node, int c, bool line_start, bool* matched) {
+    const RegexNode* nodes = dfa->program.nodes;
+    int* stack = dfa->step_stack;
+    size_t top = 0;
+    stack[top++] = node;
+    while (top > 0) {
+        int id = stack[--top];
+        if (dfa->step_marks[id] == dfa->step_mark) continue;
+        dfa->step_marks[id] = dfa->step_mark;
+
+        switch (nodes[id].type) {
+            case REGEX_NODE_SPLIT:
+                stack[top++] = nodes[id].out1;
+                stack[top++] = nodes[id].out;
+                break;
+            case REGEX_NODE_BOL:
+                if (line_start) stack[top++] = nodes[id].out;
+                break;
+            case REGEX_NODE_EOL:
+                stack[top++] = nodes[id].out;
+                break;
+            default:
+                if (StepDfaNode(dfa, id, c, matched)) return true;
+                break;
+        }
+    }
+    return false;
+}
+
+static int32_t ComputeDfaTransition(LazyDfa* dfa, int32_t state_index, int c) {
+    if (dfa->state_count >= DFA_MAX_STATES) {
+        // Keep the current state, everything else is rebuilt on demand
+        DfaState state = dfa->states[state_index];
+        memcpy(dfa->next_list, dfa->lists + state.list_start, state.list_length * sizeof(int));
+        ResetDfaStates(dfa);
+        state_index = AddDfaState(dfa, dfa->next_list, state.list_length, state.line_start);
+    }
+
+    DfaState state = dfa->states[state_index];
+    bool line_end = c == DFA_END_OF_TEXT || c == '\n';
+    bool matched = false;
+    BeginDfaList(dfa);
+    for (size_t i = 0; i < state.list_length; ++i) {
+        int id = dfa->lists[state.list_start + i];
+        bool cut;
+        if (dfa->program.nodes[id].type == REGEX_NODE_EOL) {
+            cut = line_end && StepDfaLineEnd(dfa, dfa->program.nodes[id].out, c, state.line_start, &matched);
+        } else {
+            cut = StepDfaNode(dfa, id, c, &matched);
+        }
+        if (cut) break;
+    }
+
+    int32_t next = c == DFA_END_OF_TEXT ? DFA_DEAD : AddDfaState(dfa, dfa->next_list, dfa->next_count, c == '\n');
+    int32_t transition = (next << 1) | matched;
+    dfa->transitions[(size_t)state_index * DFA_STRIDE + c] = transition;
+    return transition;
+}
+
+static int32_t GetDfaTransition(LazyDfa* dfa, int32_t state, int c) {
+    int32_t transition = dfa->transitions[(size_t)state * DFA_STRIDE + c];
+    return transition >= 0 ? transition : ComputeDfaTransition(dfa, state, c);
+}
+
+static int32_t GetDfaStartState(LazyDfa* dfa, bool line_start) {
+    if (dfa->start_states[line_start] < 0) {
+        BeginDfaList(dfa);
+        AddDfaClosure(dfa, dfa->program.start, line_start);
+        dfa->start_states[line_start] = AddDfaState(dfa, dfa->next_list, dfa->next_count, line_start);
+    }
+    return dfa->start_states[line_start];
+}
+
+// The same threads without the unanchored loop, no thread starts after this and the DFA dies
+// as soon as the ones already running do
+static int32_t DropDfaRestart(LazyDfa* dfa, int32_t state_index) {
+    if (dfa->program.restart < 0 || state_index == DFA_DEAD) return state_index;
+
+    DfaState state = dfa->states[state_index];
+    size_t count = 0;
+    for (size_t i = 0; i < state.list_length; ++i) {
+        int id = dfa->lists[state.list_start + i];
+        if (id != dfa->program.restart) {
+            dfa->next_list[count++] = id;
+        }
+    }
+    return AddDfaState(dfa, dfa->next_list, count, state.line_start);
+}
+
+bool CompileRegex(Regex* regex, const char* pattern) {
+    *regex = (Regex){0};
+    RegexParser parser = {
+        .pattern = pattern,
+        .cursor = pattern,
+        .error = regex->error,
+        .error_capacity = sizeof(regex->error)
+    };
+
+    int root = ParseRegexAlternation(&parser);
+    if (root >= 0 && *parser.cursor == ')') {
+        root = -1;
+        RegexFail(&parser, "unmatched )");
+    }
+
+    bool compiled = false;
+    if (root >= 0) {
+        compiled = CompileRegexProgram(&regex->forward.program, parser.nodes, root, false, true) &&
+                   CompileRegexProgram(&regex->reverse.program, parser.nodes, root, true, false);
+        if (!compiled) {
+            snprintf(regex->error, sizeof(regex->error), "pattern too large");
+        }
+    }
+    free(parser.nodes);
+
+    if (!compiled) {
+        ClearRegexProgram(&regex->forward.program);
+        ClearRegexProgram(&regex->reverse.program);
+        return false;
+    }
+
+    InitLazyDfa(&regex->forward, false);
+    InitLazyDfa(&regex->reverse, true);
+    return true;
+}
+
+void ClearRegex(Regex* regex) {
+    if (regex->forward.states) ClearLazyDfa(&regex->forward);
+    if (regex->reverse.states) ClearLazyDfa(&regex->reverse);
+}
+
+// Leftmost-first match inside [from, to) that starts before start_to. The forward DFA finds
+// where it ends, running the reversed program backwards from there finds the leftmost start.
+// Both scan the pieces in place. No thread is started past start_to, so the scan stops once
+// the ones started before it are over.
+static bool FindRegexStartingIn(Regex* regex, PieceCursor* cursor, size_t from, size_t start_to, size_t to, Match* match) {
+    if (from >= start_to) return false;
+    PieceView view = cursor->view;
+    LazyDfa* dfa = &regex->forward;
+
+    // Position whose byte the last thread is started on
+    size_t last_start = start_to <= to ? start_to - 1 : SIZE_MAX;
+    int32_t state = GetDfaStartState(dfa, from == 0 || PieceCursorByteAt(cursor, from - 1) == '\n');
+    size_t end = SIZE_MAX;
+    size_t position = from;
+    while (position < to && state != DFA_DEAD) {
+        if (position == last_start) {
+            state = DropDfaRestart(dfa, state);
+            if (state == DFA_DEAD) break;
+        }
+        SeekPieceCursor(cursor, position);
+        Piece piece = view.pieces[cursor->index];
+        size_t offset = position - cursor->piece_start;
+        size_t length = min(piece.length - offset, (position < last_start ? min(last_start, to) : to) - position);
+        const unsigned char* text = (const unsigned char*)GetPieceViewText(view, piece) + offset;
+
+        const int32_t* transitions = dfa->transitions;
+        for (size_t i = 0; i < length; ++i) {
+            int32_t next = transitions[(size_t)state * DFA_STRIDE + text[i]];
+            if (next < 0) {
+                next = ComputeDfaTransition(dfa, state, text[i]);
+                transitions = dfa->transitions;
+            }
+            if (next & 1) end = position + i;
+            state = next >> 1;
+            if (state == DFA_DEAD) break;
+        }
+        position += length;
+    }
+    if (state != DFA_DEAD) {
+        int c = to < view.text_size ? (unsigned char)PieceCursorByteAt(cursor, to) : DFA_END_OF_TEXT;
+        if (GetDfaTransition(dfa, state, c) & 1) end = to;
+    }
+    if (end == SIZE_MAX) return false;
+
+    dfa = &regex->reverse;
+    state = GetDfaStartState(dfa, end == view.text_size || PieceCursorByteAt(cursor, end) == '\n');
+    size_t start = end;
+    position = end;
+    while (position > from && state != DFA_DEAD) {
+        SeekPieceCursor(cursor, position - 1);
+        Piece piece = view.pieces[cursor->index];
+        size_t chunk_start = max(from, cursor->piece_start);
+        const unsigned char* text = (const unsigned char*)GetPieceViewText(view, piece);
+
+        const int32_t* transitions = dfa->transitions;
+        for (size_t i = position; i > chunk_start; --i) {
+            unsigned char c = text[i - 1 - cursor->piece_start];
+            int32_t next = transitions[(size_t)state * DFA_STRIDE + c];
+            if (next < 0) {
+                next = ComputeDfaTransition(dfa, state, c);
+                transitions = dfa->transitions;
+            }
+            if (next & 1) start = i;
+            state = next >> 1;
+            if (state == DFA_DEAD) break;
+        }
+        position = chunk_start;
+    }
+    if (state != DFA_DEAD) {
+        int c = from > 0 ? (unsigned char)PieceCursorByteAt(cursor, from - 1) : DFA_END_OF_TEXT;
+        if (GetDfaTransition(dfa, state, c) & 1) start = from;
+    }
+
+    *match = (Match){ start, end - start };
+    return true;
+}
+
+// Leftmost-first match inside [from, to)
+bool FindRegexInRange(Regex* regex, PieceCursor* cursor, size_t from, size_t to, Match* match) {
+    return FindRegexStartingIn(regex, cursor, from, to + 1, to, match);
+}
+
+static size_t SearchRegexMatches(Regex* regex, PieceView view, size_t from, size_t start_to, size_t to, MatchCallback callback, void* context) {
+    PieceCursor cursor = InitPieceCursor(view);
+    size_t found = 0;
+    size_t position = from;
+    Match match;
+    while (position <= to && FindRegexStartingIn(regex, &cursor, position, start_to, to, &match)) {
+        found++;
+        if (!callback(context, match.start, match.length)) break;
+        position = match.start + match.length + (match.length == 0);
+    }
+    return found;
+}
+
+// Reports every non-overlapping match inside [from, to), empty matches included
+size_t SearchRegex(Regex* regex, PieceView view, size_t from, size_t to, MatchCallback callback, void* context) {
+    to = min(to, view.text_size);
+    return SearchRegexMatches(regex, view, from, to + 1, to, callback, context);
+}
+
+// Reports every non-overlapping match starting inside [from, start_to), each one followed to
+// its end however far past start_to that is. Together the matches of neighbouring ranges are
+// what one scan of the whole text finds, once the matches overlapping an earlier one are redone.
+size_t SearchRegexStarts(Regex* regex, PieceView view, size_t from, size_t start_to, MatchCallback callback, void* context) {
+    return SearchRegexMatches(regex, view, from, start_to, view.text_size, callback, context);
+}
+
+// First match at or after from, wrapping around to the start of the text
+bool FindNextRegex(Regex* regex, PieceView view, size_t from, Match* match) {
+    PieceCursor cursor = InitPieceCursor(view);
+    from = min(from, view.text_size);
+    if (FindRegexInRange(regex, &cursor, from, view.text_size, match)) return true;
+    return FindRegexInRange(regex, &cursor, 0, view.text_size, match) && match->start < from;
+}
+
+size_t FindAllRegex(Regex* regex, PieceView view, MatchList* matches) {
+    matches->count = 0;
+    return SearchRegex(regex, view, 0, view.text_size, MatchListCollect, matches);
+}
@@ -0,0 +1,98 @@
+#ifndef FUNREGEX_H
+#define FUNREGEX_H
+
+#include "search.h"
+
+#define REGEX_MAX_NODES 65536
+#define DFA_MAX_STATES 4096
+#define DFA_DEAD 0
+#define DFA_END_OF_TEXT 256
+// One transition per byte plus one for the end of the text
+#define DFA_STRIDE 257
+
+typedef enum {
+    REGEX_NODE_SET,
+    REGEX_NODE_SPLIT,
+    REGEX_NODE_BOL,
+    REGEX_NODE_EOL,
+    REGEX_NODE_MATCH
+} RegexNodeType;
+
+typedef struct {
+    RegexNodeType type;
+    // Bytes accepted by a REGEX_NODE_SET
+    uint8_t set[32];
+    int out;
+    // Lower priority branch of a REGEX_NODE_SPLIT
+    int out1;
+} RegexNode;
+
+// Thompson NFA over bytes
+typedef struct {
+    RegexNode* nodes;
+    size_t count;
+    size_t capacity;
+    int start;
+    // Same as start unless the program was made unanchored
+    int anchored_start;
+    // Node of the unanchored loop that starts a thread at every byte, -1 without one
+    int restart;
+} RegexProgram;
+
+typedef struct {
+    size_t list_start;
+    size_t list_length;
+    bool line_start;
+} DfaState;
+
+// DFA built lazily from a program, each state is an ordered set of NFA nodes so the
+// first match found keeps leftmost-first semantics. When DFA_MAX_STATES is reached the
+// cache is dropped and rebuilt from the current state.
+typedef struct {
+    RegexProgram program;
+    // Keep running after a match to find the longest one, used for the reverse scan
+    bool longest;
+
+    DfaState* states;
+    size_t state_count;
+    size_t state_capacity;
+    // (next state << 1) | matched before the byte, -1 when not computed yet
+    int32_t* transitions;
+    int* lists;
+    size_t list_count;
+    size_t list_capacity;
+    // State index + 1 by hash of its node list, 0 is an empty slot
+    int32_t* table;
+    size_t table_capacity;
+    int32_t start_states[2];
+
+    int* next_list;
+    size_t next_count;
+    bool next_cut;
+    int* stack;
+    int* step_stack;
+    uint32_t* next_marks;
+    uint32_t* step_marks;
+    uint32_t next_mark;
+    uint32_t step_mark;
+} LazyDfa;
+
+typedef struct {
+    // Unanchored program run forwards to find where the match ends
+    LazyDfa forward;
+    // Reversed anchored program run backwards from the end to find where it starts
+    LazyDfa reverse;
+    char error[96];
+} Regex;
+
+bool CompileRegex(Regex* regex, const char* pattern);
+void ClearRegex(Regex* regex);
+bool FindRegexInRange(Regex* regex, PieceCursor* cursor, size_t from, size_t to, Match* match);
+size_t SearchRegex(Regex* regex, PieceView view, size_t from, size_t to, MatchCallback callback, void* context);
+size_t SearchRegexStarts(Regex* regex, PieceView view, size_t from, size_t start_to, MatchCallback callback, void* context);
+bool FindNextRegex(Regex* regex, PieceView view, size_t from, Match* match);
+size_t FindAllRegex(Regex* regex, PieceView view, MatchList* matches);
+
+bool RegexSetHas(const uint8_t* set, unsigned char c);
+
+#endif
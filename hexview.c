@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include "hexview.h"
+#include "fileload.h"
+
+#include <ctype.h>
+#include <errno.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Text has no NUL bytes, so one near the start is taken as the mark of a binary file
+bool IsBinaryData(const char* data, size_t length) {
+    return memchr(data, '\0', min(length, (size_t)BINARY_DETECT_SIZE)) != NULL;
+}
+
+bool IsBinaryFile(const char* path) {
+    int fd = OpenReadOnly(path);
+    if (fd < 0) return false;
+    char head[BINARY_DETECT_SIZE];
+    size_t length = ReadFileAt(fd, head, sizeof(head), 0);
+    close(fd);
+    return IsBinaryData(head, length);
+}
+
+bool OpenHexView(HexView* view, const char* path) {
+    *view = (HexView){0};
+    view->fd = -1;
+    int fd = OpenReadOnly(path);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0) {
+        fprintf(stderr, "Could not open file: %s (%s)\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    if ((uint64_t)file_stat.st_size > SIZE_MAX) {
+        fprintf(stderr, "Could not map file: %s (too large to map)\n", path);
+        close(fd);
+        return false;
+    }
+
+    // An empty file has nothing to map
+    const char* data = NULL;
+    size_t size = file_stat.st_size;
+    if (size > 0) {
+#ifdef _WIN32
+        HANDLE mapping = CreateFileMappingA((HANDLE)_get_osfhandle(fd), NULL, PAGE_READONLY, 0, 0, NULL);
+        data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (!data) {
+            fprintf(stderr, "Could not map file: %s (error %lu)\n", path, GetLastError());
+            close(fd);
+            return false;
+        }
+#else
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            fprintf(stderr, "Could not map file: %s (%s)\n", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        data = mapped;
+#endif
+    }
+
+    view->path = strdup(path);
+    view->fd = fd;
+    view->size = size;
+    view->data = data;
+    view->mapped_size = size;
+    view->offset_digits = 8;
+    while (view->offset_digits < 16 && (view->size - (view->size > 0)) >> (view->offset_digits * 4)) {
+        view->offset_digits++;
+    }
+    return true;
+}
+
+// Writes the row holding offset as its offset, the bytes in hex and the bytes as text, and
+// returns how many bytes the row has. out needs HEX_ROW_LENGTH + 1 bytes.
+size_t FormatHexRow(const HexView* view, uint64_t offset, char* out, size_t capacity) {
+    if (capacity < HEX_ROW_LENGTH + 1) {
+        if (capacity > 0) out[0] = '\0';
+        return 0;
+    }
+    uint64_t row = offset - offset % HEX_ROW_BYTES;
+    size_t count = row < view->size ? min(view->size - row, (uint64_t)HEX_ROW_BYTES) : 0;
+    const unsigned char* bytes = (const unsigned char*)view->data + row;
+
+    char* at = out;
+    for (int digit = view->offset_digits - 1; digit >= 0; --digit) {
+        *at++ = hex_digits[(row >> (digit * 4)) & 0xf];
+    }
+    *at++ = ' ';
+    *at++ = ' ';
+    for (size_t i = 0; i < HEX_ROW_BYTES; ++i) {
+        *at++ = i < count ? hex_digits[bytes[i] >> 4] : ' ';
+        *at++ = i < count ? hex_digits[bytes[i] & 0xf] : ' ';
+        *at++ = ' ';
+        if (i + 1 == HEX_ROW_BYTES / 2) {
+            *at++ = ' ';
+        }
+    }
+    *at++ = '|';
+    for (size_t i = 0; i < count; ++i) {
+        *at++ = bytes[i] >= 0x20 && bytes[i] < 0x7f ? bytes[i] : '.';
+    }
+    *at++ = '|';
+    *at = '\0';
+    return count;
+}
+
+// Column of byte index of a row in FormatHexRow's output, in the hex part or in the text part
+size_t GetHexByteColumn(const HexView* view, size_t index, bool text) {
+    size_t hex_start = view->offset_digits + 2;
+    if (text) return hex_start + HEX_ROW_BYTES * 3 + 1 + 1 + index;
+    return hex_start + index * 3 + (index >= HEX_ROW_BYTES / 2);
+}
+
+void JumpToHexOffset(HexView* view, uint64_t offset) {
+    view->cursor = view->size > 0 ? min(offset, view->size - 1) : 0;
+    view->top = view->cursor - view->cursor % HEX_ROW_BYTES;
+    view->match_length = 0;
+}
+
+// Moves the cursor by delta bytes and scrolls just enough to keep it within page_rows rows
+void MoveHexCursor(HexView* view, int64_t delta, size_t page_rows) {
+    if (view->size == 0) return;
+    if (delta < 0 && (uint64_t)-delta > view->cursor) {
+        view->cursor = 0;
+    } else {
+        view->cursor = min(view->cursor + delta, view->size - 1);
+    }
+    view->match_length = 0;
+
+    uint64_t row = view->cursor - view->cursor % HEX_ROW_BYTES;
+    uint64_t page_bytes = (uint64_t)max(page_rows, (size_t)1) * HEX_ROW_BYTES;
+    if (row < view->top) {
+        view->top = row;
+    } else if (row >= view->top + page_bytes) {
+        view->top = row - page_bytes + HEX_ROW_BYTES;
+    }
+}
+
+// Bytes written as pairs of hex digits, spaces between them are allowed
+bool ParseHexPattern(const char* text, char** bytes, size_t* length) {
+    size_t digits = 0;
+    for (const char* at = text; *at; ++at) {
+        if (isxdigit((unsigned char)*at)) {
+            digits++;
+        } else if (!isspace((unsigned char)*at)) {
+            return false;
+        }
+    }
+    if (digits == 0 || digits % 2 != 0) return false;
+
+    *bytes = malloc(digits / 2);
+    *length = 0;
+    int high = -1;
+    for (const char* at = text; *at; ++at) {
+        if (!isxdigit((unsigned char)*at)) continue;
+        int value = isdigit((unsigned char)*at) ? *at - '0' : tolower((unsigned char)*at) - 'a' + 10;
+        if (high < 0) {
+            high = value;
+        } else {
+            (*bytes)[(*length)++] = (char)(high << 4 | value);
+            high = -1;
+        }
+    }
+    return true;
+}
+
+// Looks for the bytes after the cursor, UpdateHexSearch does the looking
+bool StartHexSearch(HexView* view, const char* bytes, size_t length) {
+    ClearLiteralPattern(&view->pattern);
+    view->searching = false;
+    if (!InitLiteralPattern(&view->pattern, bytes, length)) return false;
+
+    view->searching = true;
+    view->search_wrapped = false;
+    view->search_from = view->size > 0 ? min(view->cursor + 1, view->size) : 0;
+    view->search_position = view->search_from;
+    return true;
+}
+
+// Searches about budget more bytes. A match moves the cursor to it.
+HexSearchResult UpdateHexSearch(HexView* view, uint64_t budget) {
+    if (!view->searching) return HEX_SEARCH_IDLE;
+
+    size_t m = view->pattern.length;
+    while (budget > 0) {
+        uint64_t limit = view->search_wrapped ? view->search_from : view->size;
+        if (view->search_position >= limit) {
+            if (view->search_wrapped) {
+                view->searching = false;
+                return HEX_SEARCH_NOT_FOUND;
+            }
+            view->search_wrapped = true;
+            view->search_position = 0;
+            continue;
+        }
+
+        // The text reaches past the step so a match straddling two steps is seen by the first
+        uint64_t end = min(view->search_position + budget, limit);
+        uint64_t text_end = min(end + m - 1, view->size);
+        size_t hit = FindLiteralInText(&view->pattern, view->data + view->search_position, text_end - view->search_position);
+        if (hit != SIZE_MAX && view->search_position + hit < end) {
+            JumpToHexOffset(view, view->search_position + hit);
+            view->match_length = m;
+            view->searching = false;
+            return HEX_SEARCH_FOUND;
+        }
+        budget -= end - view->search_position;
+        view->search_position = end;
+    }
+    return HEX_SEARCH_RUNNING;
+}
+
+double GetHexSearchProgress(const HexView* view) {
+    if (view->size == 0) return 1.0;
+    uint64_t scanned = view->search_wrapped ? view->size - view->search_from + view->search_position : view->search_position - view->search_from;
+    return (double)scanned / view->size;
+}
+
+// Bytes of the mapping past the end of a file that shrank can no longer be read, so the view
+// stops short of them. Growth is not followed, the view shows the file as it was opened.
+void UpdateHexView(HexView* view) {
+    struct stat file_stat;
+    if (fstat(view->fd, &file_stat) != 0 || (uint64_t)file_stat.st_size >= view->size) return;
+
+    view->size = file_stat.st_size;
+    if (view->size == 0) {
+        view->cursor = 0;
+        view->top = 0;
+        view->searching = false;
+    } else if (view->cursor >= view->size) {
+        JumpToHexOffset(view, view->size - 1);
+    }
+    view->search_from = min(view->search_from, view->size);
+    view->search_position = min(view->search_position, view->size);
+}
+
+void CloseHexView(HexView* view) {
+    if (view->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(view->data);
+#else
+        munmap((void*)view->data, view->mapped_size);
+#endif
+    }
+    if (view->fd >= 0) {
+        close(view->fd);
+    }
+    ClearLiteralPattern(&view->pattern);
+    free(view->path);
+    *view = (HexView){0};
+    view->fd = -1;
+}
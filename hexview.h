@@ -0,0 +1,60 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include "funcore.h"
+#include "search.h"
+
+#define HEX_ROW_BYTES 16
+// Bytes looked at for a NUL when telling a binary file from text
+#define BINARY_DETECT_SIZE 8192
+// Bytes a search goes through per frame, a search over gigabytes keeps the view responsive
+#define HEX_SEARCH_STEP (32 << 20)
+// Offset digits, hex bytes with a gap after the first half and the bytes as text between bars
+#define HEX_ROW_LENGTH (16 + 2 + HEX_ROW_BYTES * 3 + 1 + 1 + HEX_ROW_BYTES + 1)
+
+typedef enum {
+    HEX_SEARCH_IDLE,
+    HEX_SEARCH_RUNNING,
+    HEX_SEARCH_FOUND,
+    HEX_SEARCH_NOT_FOUND
+} HexSearchResult;
+
+// A file shown as bytes. It is mapped whole and rows are formatted straight from the
+// mapping, the system pages it in as rows are looked at, so nothing is read ahead or indexed.
+typedef struct {
+    char* path;
+    int fd;
+    uint64_t size;
+    const char* data;
+    size_t mapped_size;
+    int offset_digits;
+
+    // First row shown and the byte the cursor is on, with the match it starts if any
+    uint64_t top;
+    uint64_t cursor;
+    size_t match_length;
+
+    // A search goes a step per update from after the cursor to the end, then from the
+    // start back round to where it began
+    LiteralPattern pattern;
+    bool searching;
+    bool search_wrapped;
+    uint64_t search_from;
+    uint64_t search_position;
+} HexView;
+
+bool IsBinaryData(const char* data, size_t length);
+bool IsBinaryFile(const char* path);
+bool OpenHexView(HexView* view, const char* path);
+size_t FormatHexRow(const HexView* view, uint64_t offset, char* out, size_t capacity);
+size_t GetHexByteColumn(const HexView* view, size_t index, bool text);
+void JumpToHexOffset(HexView* view, uint64_t offset);
+void MoveHexCursor(HexView* view, int64_t delta, size_t page_rows);
+bool ParseHexPattern(const char* text, char** bytes, size_t* length);
+bool StartHexSearch(HexView* view, const char* bytes, size_t length);
+HexSearchResult UpdateHexSearch(HexView* view, uint64_t budget);
+double GetHexSearchProgress(const HexView* view);
+void UpdateHexView(HexView* view);
+void CloseHexView(HexView* view);
+
+#endif
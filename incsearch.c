@@ -0,0 +1,153 @@
+#define _GNU_SOURCE
+#include "incsearch.h"
+
+// True when a proper prefix of the needle is also a suffix, only then can two occurrences overlap
+static bool LiteralHasBorder(const char* needle, size_t length) {
+    size_t* border = malloc(length * sizeof(size_t));
+    border[0] = 0;
+    for (size_t i = 1; i < length; ++i) {
+        size_t k = border[i - 1];
+        while (k > 0 && needle[i] != needle[k]) {
+            k = border[k - 1];
+        }
+        border[i] = needle[i] == needle[k] ? k + 1 : 0;
+    }
+    bool result = border[length - 1] > 0;
+    free(border);
+    return result;
+}
+
+static void ClearIncrementalSearchStep(IncrementalSearchStep* step) {
+    free(step->query);
+    step->query = NULL;
+    step->length = 0;
+    ClearMatchList(&step->matches);
+    step->scanned_to = 0;
+}
+
+// Keeps the matches of the previous query that go on with the rest of the new one. Without
+// a border the previous query never overlaps itself, so its matches are all its occurrences
+// and every occurrence of the new query starts at one of them.
+static void NarrowIncrementalSearchStep(PieceView view, const IncrementalSearchStep* previous, IncrementalSearchStep* step) {
+    PieceCursor cursor = InitPieceCursor(view);
+    size_t last_end = 0;
+    for (size_t i = 0; i < previous->matches.count; ++i) {
+        size_t start = previous->matches.items[i].start;
+        if (start + step->length > previous->scanned_to) break;
+        if (start < last_end) continue;
+
+        size_t j = previous->length;
+        while (j < step->length && PieceCursorByteAt(&cursor, start + j) == step->query[j]) {
+            j++;
+        }
+        if (j == step->length) {
+            MatchListAppend(&step->matches, start, step->length);
+            last_end = start + step->length;
+        }
+    }
+    step->scanned_to = previous->scanned_to;
+}
+
+static void ResetIncrementalSearchPattern(IncrementalSearch* search) {
+    ClearLiteralPattern(&search->pattern);
+    if (search->step_count > 0) {
+        IncrementalSearchStep* step = &search->steps[search->step_count - 1];
+        InitLiteralPattern(&search->pattern, step->query, step->length);
+    }
+}
+
+void InitIncrementalSearch(IncrementalSearch* search) {
+    *search = (IncrementalSearch){0};
+    search->steps = calloc(INITIAL_INCREMENTAL_SEARCH_STEPS, sizeof(IncrementalSearchStep));
+    search->step_capacity = INITIAL_INCREMENTAL_SEARCH_STEPS;
+}
+
+// Moves the search to a new query. Typing on narrows the current matches, deleting back to an
+// earlier query reuses its matches, anything else starts over. No scanning happens here.
+void UpdateIncrementalSearch(IncrementalSearch* search, TextBuffer* buffer, const char* query, size_t length) {
+    if (search->revision != buffer->revision || length == 0) {
+        ResetIncrementalSearch(search);
+        search->revision = buffer->revision;
+        if (length == 0) return;
+    }
+
+    bool changed = false;
+    while (search->step_count > 0) {
+        IncrementalSearchStep* top = &search->steps[search->step_count - 1];
+        if (top->length <= length && memcmp(top->query, query, top->length) == 0) break;
+        ClearIncrementalSearchStep(top);
+        search->step_count--;
+        changed = true;
+    }
+
+    if (search->step_count == 0 || search->steps[search->step_count - 1].length < length) {
+        if (search->step_count >= search->step_capacity) {
+            search->step_capacity *= 2;
+            search->steps = realloc(search->steps, search->step_capacity * sizeof(IncrementalSearchStep));
+        }
+        IncrementalSearchStep* step = &search->steps[search->step_count];
+        step->query = malloc(length);
+        memcpy(step->query, query, length);
+        step->length = length;
+        step->scanned_to = 0;
+        InitMatchList(&step->matches);
+
+        IncrementalSearchStep* previous = search->step_count > 0 ? &search->steps[search->step_count - 1] : NULL;
+        if (previous && !LiteralHasBorder(previous->query, previous->length)) {
+            NarrowIncrementalSearchStep(GetPieceView(buffer), previous, step);
+        }
+        search->step_count++;
+        changed = true;
+    }
+
+    if (changed) {
+        ResetIncrementalSearchPattern(search);
+    }
+}
+
+// Scans up to budget more bytes for the current query. Returns true once the whole text is covered.
+bool StepIncrementalSearch(IncrementalSearch* search, TextBuffer* buffer, size_t budget) {
+    if (search->step_count == 0 || search->revision != buffer->revision) return true;
+
+    IncrementalSearchStep* step = &search->steps[search->step_count - 1];
+    PieceView view = GetPieceView(buffer);
+    if (step->scanned_to >= view.text_size) return true;
+
+    // Matches fully before scanned_to are known, one may still start in the last length - 1 bytes
+    size_t from = step->scanned_to >= step->length ? step->scanned_to - step->length + 1 : 0;
+    if (step->matches.count > 0) {
+        Match last = step->matches.items[step->matches.count - 1];
+        from = max(from, last.start + last.length);
+    }
+    size_t to = min(step->scanned_to + budget, view.text_size);
+    SearchLiteral(view, &search->pattern, from, to, MatchListCollect, &step->matches);
+    step->scanned_to = to;
+    return to >= view.text_size;
+}
+
+bool IsIncrementalSearchActive(IncrementalSearch* search) {
+    return search->step_count > 0;
+}
+
+bool IsIncrementalSearchComplete(IncrementalSearch* search, TextBuffer* buffer) {
+    return search->step_count == 0 || search->steps[search->step_count - 1].scanned_to >= buffer->text_size;
+}
+
+const IncrementalSearchStep* GetIncrementalSearchStep(IncrementalSearch* search) {
+    return search->step_count > 0 ? &search->steps[search->step_count - 1] : NULL;
+}
+
+void ResetIncrementalSearch(IncrementalSearch* search) {
+    for (size_t i = 0; i < search->step_count; ++i) {
+        ClearIncrementalSearchStep(&search->steps[i]);
+    }
+    search->step_count = 0;
+    ClearLiteralPattern(&search->pattern);
+}
+
+void ClearIncrementalSearch(IncrementalSearch* search) {
+    ResetIncrementalSearch(search);
+    free(search->steps);
+    search->steps = NULL;
+    search->step_capacity = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef INCSEARCH_H
+#define INCSEARCH_H
+
+#include "search.h"
+
+// Bytes scanned per call to StepIncrementalSearch, small enough to fit in a frame
+#define INCREMENTAL_SEARCH_SLICE_SIZE (8 << 20)
+#define INITIAL_INCREMENTAL_SEARCH_STEPS 16
+
+// The matches of one query. matches holds every match lying fully before scanned_to.
+typedef struct {
+    char* query;
+    size_t length;
+    MatchList matches;
+    size_t scanned_to;
+} IncrementalSearchStep;
+
+// Search as you type. Each step is the previous query plus what was typed after it, so a
+// longer query narrows the matches of the step before and backspace just drops steps.
+typedef struct {
+    IncrementalSearchStep* steps;
+    size_t step_count;
+    size_t step_capacity;
+
+    // Pattern of the last step
+    LiteralPattern pattern;
+    uint64_t revision;
+} IncrementalSearch;
+
+void InitIncrementalSearch(IncrementalSearch* search);
+void UpdateIncrementalSearch(IncrementalSearch* search, TextBuffer* buffer, const char* query, size_t length);
+bool StepIncrementalSearch(IncrementalSearch* search, TextBuffer* buffer, size_t budget);
+bool IsIncrementalSearchActive(IncrementalSearch* search);
+bool IsIncrementalSearchComplete(IncrementalSearch* search, TextBuffer* buffer);
+const IncrementalSearchStep* GetIncrementalSearchStep(IncrementalSearch* search);
+void ResetIncrementalSearch(IncrementalSearch* search);
+void ClearIncrementalSearch(IncrementalSearch* search);
+
+#endif
@@ -0,0 +1,454 @@
+#define _GNU_SOURCE
+#include "journal.h"
+#include "filesave.h"
+
+#ifdef _WIN32
+// No flock or fdatasync here, buffers are not journaled
+EditJournal* OpenEditJournal(TextBuffer* buffer, uint64_t base_revision, size_t* recovered) {
+    *recovered = 0;
+    return NULL;
+}
+
+void FlushEditJournal(EditJournal* journal) {}
+
+bool RebaseEditJournal(EditJournal* journal, TextBuffer* buffer, uint64_t saved_revision) {
+    return false;
+}
+
+bool ResetEditJournal(EditJournal* journal, TextBuffer* buffer) {
+    return false;
+}
+
+void CloseEditJournal(EditJournal* journal, TextBuffer* buffer) {}
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+static const char JOURNAL_MAGIC[8] = {'F', 'U', 'N', 'W', 'A', 'L', '0', '1'};
+
+static uint32_t HashJournalBytes(uint32_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t ChecksumJournalRecord(const JournalRecord* record, const char* text, size_t length) {
+    uint32_t hash = HashJournalBytes(2166136261u, &record->type, sizeof(JournalRecord) - offsetof(JournalRecord, type));
+    return HashJournalBytes(hash, text, length);
+}
+
+static size_t GetJournalTextLength(const JournalRecord* record) {
+    return record->type == JOURNAL_DELETE ? 0 : record->length;
+}
+
+static char* GetJournalPath(const char* file_path) {
+    const char* name = strrchr(file_path, '/');
+    name = name ? name + 1 : file_path;
+    size_t directory_length = name - file_path;
+
+    size_t length = strlen(file_path) + 16;
+    char* path = malloc(length);
+    snprintf(path, length, "%.*s.%s.funwal", (int)directory_length, file_path, name);
+    return path;
+}
+
+static bool GetJournalHeader(const char* file_path, JournalHeader* header) {
+    struct stat file_stat;
+    if (stat(file_path, &file_stat) != 0) return false;
+
+    *header = (JournalHeader){0};
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header->size = file_stat.st_size;
+    header->mtime_sec = file_stat.st_mtim.tv_sec;
+    header->mtime_nsec = file_stat.st_mtim.tv_nsec;
+    header->inode = file_stat.st_ino;
+    return true;
+}
+
+static bool WriteJournalBytes(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+static char* ReadJournalFile(int fd, size_t* size) {
+    struct stat journal_stat;
+    *size = 0;
+    if (fstat(fd, &journal_stat) != 0) return NULL;
+
+    char* data = malloc(max(journal_stat.st_size, (off_t)1));
+    while (*size < (size_t)journal_stat.st_size) {
+        ssize_t count = pread(fd, data + *size, journal_stat.st_size - *size, *size);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        *size += count;
+    }
+    return data;
+}
+
+// Reads the record at offset, false at the end of the journal or at a torn or damaged record
+static bool ReadJournalRecord(const char* data, size_t size, size_t* offset, JournalRecord* record, const char** text) {
+    if (size - *offset < sizeof(JournalRecord)) return false;
+    memcpy(record, data + *offset, sizeof(JournalRecord));
+    if (record->type < JOURNAL_INSERT || record->type > JOURNAL_REPLACE) return false;
+
+    size_t length = GetJournalTextLength(record);
+    if (length > size - *offset - sizeof(JournalRecord)) return false;
+    *text = data + *offset + sizeof(JournalRecord);
+    if (ChecksumJournalRecord(record, *text, length) != record->checksum) return false;
+
+    *offset += sizeof(JournalRecord) + length;
+    return true;
+}
+
+static bool ReplayJournalRecord(TextBuffer* buffer, const JournalRecord* record, const char* text) {
+    switch (record->type) {
+        case JOURNAL_INSERT:
+            if (record->position > buffer->text_size) return false;
+            InsertString(buffer, record->position, (char*)text, record->length);
+            return true;
+        case JOURNAL_DELETE:
+            if (record->position > buffer->text_size || record->length > buffer->text_size - record->position) return false;
+            DeleteRange(buffer, record->position, record->length);
+            return true;
+        case JOURNAL_REPLACE: {
+            Piece* pieces = malloc(INITIAL_PIECE_BUFFER_CAPACITY * sizeof(Piece));
+            pieces[0] = (Piece){ORIGINAL, 0, 0};
+            if (record->length > 0) {
+                pieces[0] = (Piece){ADD, AppendAddBuffer(buffer, (char*)text, record->length), record->length};
+            }
+            ReplaceTextPieces(buffer, pieces, 1, INITIAL_PIECE_BUFFER_CAPACITY, record->length, buffer->pointer_position);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes a journal for the file described by header holding the records of data newer than
+// min_revision. With replay set they are applied to it first and numbered by its revisions.
+// Returns the new journal, locked and open for appending, in place of path.
+static int RewriteJournal(const char* path, JournalHeader header, const char* data, size_t size, uint64_t min_revision, TextBuffer* replay, size_t* count) {
+    size_t temp_length = strlen(path) + 32;
+    char* temp_path = malloc(temp_length);
+    snprintf(temp_path, temp_length, "%s.tmp-%ld", path, (long)getpid());
+    int fd = open(temp_path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create journal: %s (%s)\n", temp_path, strerror(errno));
+        free(temp_path);
+        return -1;
+    }
+    flock(fd, LOCK_EX | LOCK_NB);
+
+    // The kept records never take more room than the old journal, they go out in one write
+    char* records = malloc(sizeof(JournalHeader) + size);
+    memcpy(records, &header, sizeof(JournalHeader));
+    size_t records_size = sizeof(JournalHeader);
+    size_t offset = sizeof(JournalHeader);
+    JournalRecord record;
+    const char* text;
+    size_t kept = 0;
+    while (data && ReadJournalRecord(data, size, &offset, &record, &text)) {
+        size_t length = GetJournalTextLength(&record);
+        if (replay) {
+            if (!ReplayJournalRecord(replay, &record, text)) break;
+            record.revision = replay->revision;
+            record.checksum = ChecksumJournalRecord(&record, text, length);
+        } else if (record.revision <= min_revision) {
+            continue;
+        }
+        memcpy(records + records_size, &record, sizeof(JournalRecord));
+        memcpy(records + records_size + sizeof(JournalRecord), text, length);
+        records_size += sizeof(JournalRecord) + length;
+        kept++;
+    }
+
+    bool ok = WriteJournalBytes(fd, records, records_size) && fdatasync(fd) == 0 && rename(temp_path, path) == 0;
+    free(records);
+    if (!ok) {
+        fprintf(stderr, "Could not write journal: %s (%s)\n", path, strerror(errno));
+        close(fd);
+        unlink(temp_path);
+        fd = -1;
+    } else {
+        SyncParentDirectory(path);
+    }
+
+    if (count) *count = kept;
+    free(temp_path);
+    return fd;
+}
+
+// Adds a record to what the writer syncs next, the text of a replace is taken from the buffer
+static void QueueJournalRecord(EditJournal* journal, TextBuffer* buffer, JournalRecord record, const char* text) {
+    size_t length = GetJournalTextLength(&record);
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->lock);
+        return;
+    }
+    size_t required = journal->pending_size + sizeof(JournalRecord) + length;
+    if (required > journal->pending_capacity) {
+        journal->pending_capacity = max(journal->pending_capacity * 2, required);
+        journal->pending = realloc(journal->pending, journal->pending_capacity);
+    }
+
+    char* record_text = journal->pending + journal->pending_size + sizeof(JournalRecord);
+    if (record.type == JOURNAL_REPLACE) {
+        CopyTextRange(buffer, 0, length, record_text);
+    } else if (length > 0) {
+        memcpy(record_text, text, length);
+    }
+    record.checksum = ChecksumJournalRecord(&record, record_text, length);
+    memcpy(journal->pending + journal->pending_size, &record, sizeof(JournalRecord));
+
+    // With records already queued the writer is waiting for a deadline this only moves later
+    double now = GetWallTime();
+    journal->last_append_time = now;
+    if (journal->pending_size == 0) {
+        journal->first_pending_time = now;
+        pthread_cond_signal(&journal->wake);
+    }
+    journal->pending_size = required;
+    pthread_mutex_unlock(&journal->lock);
+}
+
+static void AppendJournalRecord(void* context, TextBuffer* buffer, TextChange change, const char* inserted) {
+    JournalRecord record = {0, JOURNAL_DELETE, buffer->revision, change.position, change.removed};
+    if (change.inserted > 0) {
+        record.type = inserted ? JOURNAL_INSERT : JOURNAL_REPLACE;
+        record.length = change.inserted;
+    }
+    QueueJournalRecord(context, buffer, record, inserted);
+}
+
+// Syncs the queued records once the oldest has waited the interval or the edits pause
+static void* RunJournalWriter(void* data) {
+    EditJournal* journal = data;
+    pthread_mutex_lock(&journal->lock);
+    while (true) {
+        if (journal->pending_size == 0) {
+            if (journal->stopping) break;
+            pthread_cond_wait(&journal->wake, &journal->lock);
+            continue;
+        }
+
+        double deadline = min(journal->first_pending_time + JOURNAL_SYNC_INTERVAL, journal->last_append_time + JOURNAL_IDLE_DELAY);
+        if (!journal->flush_requested && !journal->stopping && GetWallTime() < deadline) {
+            struct timespec until = { (time_t)deadline, (long)((deadline - (time_t)deadline) * 1e9) };
+            pthread_cond_timedwait(&journal->wake, &journal->lock, &until);
+            continue;
+        }
+
+        char* records = journal->pending;
+        size_t size = journal->pending_size;
+        journal->pending = journal->writing;
+        journal->writing = records;
+        size_t capacity = journal->pending_capacity;
+        journal->pending_capacity = journal->writing_capacity;
+        journal->writing_capacity = capacity;
+        journal->pending_size = 0;
+        journal->writing_active = true;
+        int fd = journal->fd;
+        pthread_mutex_unlock(&journal->lock);
+
+        bool ok = WriteJournalBytes(fd, records, size) && fdatasync(fd) == 0;
+        int error = errno;
+
+        pthread_mutex_lock(&journal->lock);
+        journal->writing_active = false;
+        if (!ok && !journal->failed) {
+            fprintf(stderr, "Could not write journal: %s (%s)\n", journal->path, strerror(error));
+            journal->failed = true;
+            journal->pending_size = 0;
+        }
+        if (journal->pending_size == 0) {
+            journal->flush_requested = false;
+        }
+        pthread_cond_broadcast(&journal->synced);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+// Starts journaling the edits of buffer, whose text at base_revision is what its file holds.
+// A journal a crashed editor left for the file is replayed first when the buffer still matches
+// the file, recovered is then the number of edits it brought back.
+EditJournal* OpenEditJournal(TextBuffer* buffer, uint64_t base_revision, size_t* recovered) {
+    *recovered = 0;
+    JournalHeader header;
+    if (!buffer->file_path || !GetJournalHeader(buffer->file_path, &header)) return NULL;
+
+    char* path = GetJournalPath(buffer->file_path);
+    char* data = NULL;
+    size_t size = 0;
+    int orphan = open(path, O_RDONLY | O_CLOEXEC);
+    if (orphan >= 0) {
+        if (flock(orphan, LOCK_EX | LOCK_NB) != 0) {
+            fprintf(stderr, "Could not lock journal, the file is open in another editor: %s\n", path);
+            close(orphan);
+            free(path);
+            return NULL;
+        }
+
+        data = ReadJournalFile(orphan, &size);
+        bool matches = data && size >= sizeof(header) && memcmp(data, &header, sizeof(header)) == 0;
+        if (!matches || buffer->revision != base_revision) {
+            size_t stale_length = strlen(path) + 8;
+            char* stale_path = malloc(stale_length);
+            snprintf(stale_path, stale_length, "%s.stale", path);
+            rename(path, stale_path);
+            fprintf(stderr, "Journal does not match %s, moved it to %s\n", buffer->file_path, stale_path);
+            free(stale_path);
+            free(data);
+            data = NULL;
+            size = 0;
+        }
+    }
+
+    // The recovered edits are written again under the new revisions, the orphan stays locked
+    // until the new journal has taken its place
+    size_t count = 0;
+    int fd = RewriteJournal(path, header, data, size, 0, data ? buffer : NULL, &count);
+    if (orphan >= 0) {
+        close(orphan);
+    }
+    free(data);
+    if (fd < 0) {
+        free(path);
+        return NULL;
+    }
+
+    EditJournal* journal = calloc(1, sizeof(EditJournal));
+    journal->path = path;
+    journal->fd = fd;
+    journal->base_revision = base_revision;
+    journal->pending = malloc(INITIAL_JOURNAL_BUFFER_CAPACITY);
+    journal->pending_capacity = INITIAL_JOURNAL_BUFFER_CAPACITY;
+    journal->writing = malloc(INITIAL_JOURNAL_BUFFER_CAPACITY);
+    journal->writing_capacity = INITIAL_JOURNAL_BUFFER_CAPACITY;
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->synced, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&journal->wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_create(&journal->thread, NULL, RunJournalWriter, journal);
+
+    // Edits made before the journal started go in as the whole text
+    if (buffer->revision != base_revision) {
+        QueueJournalRecord(journal, buffer, (JournalRecord){0, JOURNAL_REPLACE, buffer->revision, 0, buffer->text_size}, NULL);
+    }
+    buffer->change_hook = AppendJournalRecord;
+    buffer->change_hook_context = journal;
+    *recovered = count;
+    return journal;
+}
+
+// Waits until every queued record is on disk
+void FlushEditJournal(EditJournal* journal) {
+    pthread_mutex_lock(&journal->lock);
+    journal->flush_requested = true;
+    pthread_cond_signal(&journal->wake);
+    while (journal->pending_size > 0 || journal->writing_active) {
+        pthread_cond_wait(&journal->synced, &journal->lock);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+// Called once the text at saved_revision is in the buffer's file, possibly under a new path.
+// Drops the records the file now holds and ties the rest to the file as it is now.
+bool RebaseEditJournal(EditJournal* journal, TextBuffer* buffer, uint64_t saved_revision) {
+    JournalHeader header;
+    if (!buffer->file_path || !GetJournalHeader(buffer->file_path, &header)) return false;
+
+    FlushEditJournal(journal);
+    pthread_mutex_lock(&journal->lock);
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->lock);
+        return false;
+    }
+
+    size_t size;
+    char* data = ReadJournalFile(journal->fd, &size);
+    char* path = GetJournalPath(buffer->file_path);
+    int fd = RewriteJournal(path, header, data, size, saved_revision, NULL, NULL);
+    free(data);
+    if (fd >= 0) {
+        if (strcmp(path, journal->path) != 0) {
+            unlink(journal->path);
+        }
+        close(journal->fd);
+        journal->fd = fd;
+        free(journal->path);
+        journal->path = path;
+        journal->base_revision = saved_revision;
+    } else {
+        free(path);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return fd >= 0;
+}
+
+// Cheap rebase for a buffer that matches its file, as a followed log does between appends:
+// the journal is cut back to a header for the file as it is now. Nothing is synced, a crash
+// before the header is on disk leaves the old one, which no longer matches the grown file.
+// Gives up without waiting while the writer is busy, the caller tries again later.
+bool ResetEditJournal(EditJournal* journal, TextBuffer* buffer) {
+    JournalHeader header;
+    if (!buffer->file_path || !GetJournalHeader(buffer->file_path, &header)) return false;
+
+    pthread_mutex_lock(&journal->lock);
+    bool ok = !journal->failed && !journal->writing_active;
+    if (ok) {
+        // Whatever is still queued is in the file now
+        journal->pending_size = 0;
+        journal->flush_requested = false;
+        ok = ftruncate(journal->fd, 0) == 0 && WriteJournalBytes(journal->fd, (const char*)&header, sizeof(header));
+        if (ok) {
+            journal->base_revision = buffer->revision;
+        } else {
+            fprintf(stderr, "Could not reset journal: %s (%s)\n", journal->path, strerror(errno));
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return ok;
+}
+
+// Stops journaling, the journal is only left behind when the editor does not get here
+void CloseEditJournal(EditJournal* journal, TextBuffer* buffer) {
+    if (!journal) return;
+
+    if (buffer && buffer->change_hook_context == journal) {
+        buffer->change_hook = NULL;
+        buffer->change_hook_context = NULL;
+    }
+
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = true;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->thread, NULL);
+
+    close(journal->fd);
+    unlink(journal->path);
+    pthread_mutex_destroy(&journal->lock);
+    pthread_cond_destroy(&journal->wake);
+    pthread_cond_destroy(&journal->synced);
+    free(journal->pending);
+    free(journal->writing);
+    free(journal->path);
+    free(journal);
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pthread.h>
+
+#include "funcore.h"
+
+// Longest an edit waits in memory while typing goes on
+#define JOURNAL_SYNC_INTERVAL 0.2
+// Pause in the edits after which what is queued is synced right away
+#define JOURNAL_IDLE_DELAY 0.05
+#define INITIAL_JOURNAL_BUFFER_CAPACITY 4096
+
+typedef enum {
+    JOURNAL_INSERT = 1,
+    JOURNAL_DELETE,
+    // The whole text, written when a piece list was swapped in
+    JOURNAL_REPLACE
+} JournalRecordType;
+
+// The file a journal applies to, a journal whose file has changed since is not replayed
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t inode;
+} JournalHeader;
+
+// One edit, followed by length bytes of text for inserts and replaces. The checksum covers
+// the rest of the record and its text, so a write torn by a crash ends the journal.
+typedef struct {
+    uint32_t checksum;
+    uint32_t type;
+    uint64_t revision;
+    uint64_t position;
+    uint64_t length;
+} JournalRecord;
+
+// Write-ahead log of the edits made to a buffer since its file was saved, kept next to the
+// file as .name.funwal. Edits are queued in memory and a writer thread syncs them in groups,
+// so typing never waits on the disk. A journal left behind by a crash is replayed onto the
+// file the next time it is opened.
+typedef struct EditJournal {
+    char* path;
+    int fd;
+    // Revision of the text the file holds, the records before it are dropped
+    uint64_t base_revision;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t synced;
+
+    // Records queued by the editor and the ones the writer is working on
+    char* pending;
+    size_t pending_size;
+    size_t pending_capacity;
+    char* writing;
+    size_t writing_capacity;
+    bool writing_active;
+
+    double first_pending_time;
+    double last_append_time;
+    bool flush_requested;
+    bool stopping;
+    bool failed;
+} EditJournal;
+
+EditJournal* OpenEditJournal(TextBuffer* buffer, uint64_t base_revision, size_t* recovered);
+void FlushEditJournal(EditJournal* journal);
+bool RebaseEditJournal(EditJournal* journal, TextBuffer* buffer, uint64_t saved_revision);
+bool ResetEditJournal(EditJournal* journal, TextBuffer* buffer);
+void CloseEditJournal(EditJournal* journal, TextBuffer* buffer);
+
+#endif
@@ -1,44 +1,36 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "raylib.h"
 #include <string.h>
-#include <sys/stat.h>
-
-#ifdef _WIN32
-    #define WIN32_LEAN_AND_MEAN 
-    #define NOGDI             
-    #define NOUSER               
-    #include <windows.h>
-    #undef WIN32_LEAN_AND_MEAN
-    #undef NOGDI
-    #undef NOUSER
-    
-    #ifndef S_ISDIR
-        #define S_ISDIR(m) (((m) & _S_IFMT) == _S_IFDIR)
-    #endif
-    #ifndef S_ISREG
-        #define S_ISREG(m) (((m) & _S_IFMT) == _S_IFREG)
-    #endif
-#else
-    #include <dirent.h>
-    #include <unistd.h>
-#endif
-
-#ifndef _WIN32
-    #define min(a, b) ((a) < (b) ? (a) : (b))
-    #define max(a, b) ((a) > (b) ? (a) : (b))
-#endif
+#include "funcore.h"
+#include "search.h"
+#include "funregex.h"
+#include "parallelsearch.h"
+#include "incsearch.h"
+#include "matchindex.h"
+#include "filesave.h"
+#include "journal.h"
+#include "filewatch.h"
+#include "pagedfile.h"
+#include "hexview.h"
+#include "filetree.h"
+#include "fileload.h"
+
 #define BREAK_DOWN_RECT(rect) rect.position.x, rect.position.y, rect.size.x, rect.size.y
-#define ARRAY_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 #define INITIAL_TEXT_BUFFER_CAPACITY 10
-#define INITIAL_ADD_BUFFER_CAPACITY 4096
-#define INITIAL_UNDO_STACK_CAPACITY 4096
-#define INITIAL_PIECE_BUFFER_CAPACITY 1024
-#define INITIAL_COMMAND_BUFFER_CAPACITY 1024
+#define INITIAL_MACRO_CAPACITY 64
+#define ACTION_TEXT_BUFFER_CAPACITY 256
+#define LATENCY_SAMPLE_CAPACITY 512
+#define INPUT_RECORDING_MAGIC "FUNREC01"
+// Seconds between restarts of the journal of a followed file that has no edits of its own
+#define FOLLOW_JOURNAL_REBASE_INTERVAL 1.0
+// Bytes of a line the viewer draws, and columns a word move scrolls it sideways
+#define PAGED_LINE_DISPLAY_LENGTH 1024
+#define PAGED_COLUMN_STEP 8
 
-typedef enum { ORIGINAL, ADD } BufferType;
-typedef enum { TYPE_DIR, TYPE_FILE, TYPE_ERROR } FileType;
 typedef enum { MODE_TEXT, MODE_COMMAND, MODE_COUNT } EditorMode;
 
 typedef enum {
@@ -76,7 +68,15 @@ typedef enum {
     ACTION_CANCEL,
     ACTION_OPEN_COMMAND_PALETTE,
 
-    ACTION_EXECUTE_COMMAND
+    ACTION_EXECUTE_COMMAND,
+
+    ACTION_TOGGLE_LATENCY_OVERLAY,
+
+    ACTION_MACRO_RECORD,
+    ACTION_MACRO_PLAY,
+
+    ACTION_PAGE_UP,
+    ACTION_PAGE_DOWN
 } ActionType;
 
 
@@ -110,20 +110,24 @@ const char* ActionTypeToString(ActionType type) {
         case ACTION_QUIT: return "ACTION_QUIT";
         case ACTION_CANCEL: return "ACTION_CANCEL";
         case ACTION_OPEN_COMMAND_PALETTE: return "ACTION_OPEN_COMMAND_PALETTE";
+        case ACTION_EXECUTE_COMMAND: return "ACTION_EXECUTE_COMMAND";
+        case ACTION_TOGGLE_LATENCY_OVERLAY: return "ACTION_TOGGLE_LATENCY_OVERLAY";
+        case ACTION_MACRO_RECORD: return "ACTION_MACRO_RECORD";
+        case ACTION_MACRO_PLAY: return "ACTION_MACRO_PLAY";
+        case ACTION_PAGE_UP: return "ACTION_PAGE_UP";
+        case ACTION_PAGE_DOWN: return "ACTION_PAGE_DOWN";
         default: return "UNKNOWN_ACTION";
     }
 }
 
 typedef struct {
     ActionType type;
-    char* text_buffer;
+    char text_buffer[ACTION_TEXT_BUFFER_CAPACITY];
     size_t length;
+    double timestamp;
 } Action;
 
 void ClearAction(Action* action) {
-    if (action->text_buffer) {
-        free(action->text_buffer);
-    }
     action->length = 0;
 }
 
@@ -147,6 +151,8 @@ static KeyBinding default_normal_bindings[] = {
     { KEY_RIGHT, MODI_NONE,  ACTION_CURSOR_RIGHT },
     { KEY_UP,    MODI_NONE,  ACTION_CURSOR_UP },
     { KEY_DOWN,  MODI_NONE,  ACTION_CURSOR_DOWN },
+    { KEY_PAGE_UP,   MODI_NONE, ACTION_PAGE_UP },
+    { KEY_PAGE_DOWN, MODI_NONE, ACTION_PAGE_DOWN },
     
     // Word movement
     { KEY_LEFT,  MODI_CTRL,  ACTION_CURSOR_WORD_LEFT },
@@ -182,7 +188,15 @@ static KeyBinding default_normal_bindings[] = {
     { KEY_Q,      MODI_CTRL, ACTION_QUIT },
 
     // Command
-    { KEY_P, MODI_CTRL, ACTION_OPEN_COMMAND_PALETTE}
+    { KEY_P, MODI_CTRL, ACTION_OPEN_COMMAND_PALETTE},
+    { KEY_F, MODI_CTRL, ACTION_SEARCH },
+
+    // Macros
+    { KEY_R, MODI_CTRL, ACTION_MACRO_RECORD },
+    { KEY_E, MODI_CTRL, ACTION_MACRO_PLAY },
+
+    // Debug
+    { KEY_F3, MODI_NONE, ACTION_TOGGLE_LATENCY_OVERLAY }
 };
 
 static KeyBinding default_command_bindings[] = {
@@ -196,77 +210,10 @@ static KeyBinding default_command_bindings[] = {
     { KEY_ESCAPE, MODI_NONE, ACTION_CANCEL },
 
     { KEY_ENTER,     MODI_NONE, ACTION_EXECUTE_COMMAND },
-};
-
-
-typedef struct {
-    char* command_buffer;
-    size_t command_buffer_capacity;
-
-
-    size_t pointer_position;
-} CommandSystem;
-
-CommandSystem InitCommandSystem() {
-    CommandSystem system;
-    system.command_buffer = calloc(INITIAL_COMMAND_BUFFER_CAPACITY, sizeof(char));
-    system.command_buffer_capacity = INITIAL_COMMAND_BUFFER_CAPACITY;
-    system.pointer_position = 0;
 
-    return system;
-}
-
-void CommandSystemInsertString(CommandSystem* system, char* value, size_t len) {
-    size_t command_buffer_length = strlen(system->command_buffer);
-    while (command_buffer_length + len >= system->command_buffer_capacity) {
-        system->command_buffer = realloc(system->command_buffer, system->command_buffer_capacity * 2 * sizeof(char));
-        system->command_buffer_capacity *= 2;
-    }
-    memmove(system->command_buffer + system->pointer_position + len, system->command_buffer + system->pointer_position, command_buffer_length - system->pointer_position + 1);
-    memcpy(system->command_buffer + system->pointer_position, value, len);
-    system->pointer_position += len;
-}
-
-void CommandSystemRemoveChar(CommandSystem* system) {
-    size_t command_buffer_length = strlen(system->command_buffer);
-    
-    if (system->pointer_position >= command_buffer_length) {
-        return;
-    }
-    
-    memmove(system->command_buffer + system->pointer_position,
-            system->command_buffer + system->pointer_position + 1,
-            command_buffer_length - system->pointer_position);
-}
-
-void CommandSystemBackspace(CommandSystem* system) {
-    if (system->pointer_position == 0) {
-        return;
-    }
-    
-    system->pointer_position--;
-    CommandSystemRemoveChar(system);
-}
-
-void MoveCommandPointerLeft(CommandSystem* system) {
-    if (system->pointer_position <= 0) return;
-    system->pointer_position--;
-}
-
-void MoveCommandPointerRight(CommandSystem* system) {
-    size_t command_buffer_length = strlen(system->command_buffer);
-    if (system->pointer_position >= command_buffer_length) return;
-    system->pointer_position++;
-}
-
-void ClearCommandSystem(CommandSystem* system) {
-    if (system->command_buffer) {
-        free(system->command_buffer);
-    }
+    { KEY_F3, MODI_NONE, ACTION_TOGGLE_LATENCY_OVERLAY },
+};
 
-    system->command_buffer_capacity = 0;
-    system->pointer_position = 0;
-}
 
 typedef struct {
     EditorMode current_mode;
@@ -293,6 +240,58 @@ InputSystem InitInputSystem() {
     return sys;
 }
 
+typedef struct {
+    Action* actions;
+    size_t count;
+    size_t capacity;
+    bool recording;
+} Macro;
+
+Macro InitMacro() {
+    Macro macro;
+    macro.actions = malloc(INITIAL_MACRO_CAPACITY * sizeof(Action));
+    macro.capacity = INITIAL_MACRO_CAPACITY;
+    macro.count = 0;
+    macro.recording = false;
+    return macro;
+}
+
+void MacroAppendAction(Macro* macro, Action action) {
+    if (macro->count >= macro->capacity) {
+        macro->capacity *= 2;
+        macro->actions = realloc(macro->actions, macro->capacity * sizeof(Action));
+    }
+    macro->actions[macro->count++] = action;
+}
+
+bool IsMacroRecordable(ActionType type) {
+    switch (type) {
+        case ACTION_NONE:
+        case ACTION_UNDO:
+        case ACTION_REDO:
+        case ACTION_QUIT:
+        case ACTION_CANCEL:
+        case ACTION_OPEN_COMMAND_PALETTE:
+        case ACTION_SEARCH:
+        case ACTION_TOGGLE_LATENCY_OVERLAY:
+        case ACTION_MACRO_RECORD:
+        case ACTION_MACRO_PLAY:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void ClearMacro(Macro* macro) {
+    if (macro->actions) {
+        free(macro->actions);
+        macro->actions = NULL;
+    }
+    macro->count = 0;
+    macro->capacity = 0;
+    macro->recording = false;
+}
+
 ModifierFlags GetCurrentModifiers() {
     ModifierFlags mods = MODI_NONE;
 
@@ -330,12 +329,17 @@ Action InputSystemPoll(InputSystem* sys) {
     ModifierFlags mods = GetCurrentModifiers();
 
     if (!(mods & (MODI_CTRL | MODI_ALT | MODI_SUPER))) {
-        int ch = GetCharPressed();
-        if (ch != 0) {
+        // Drain every character queued this frame into one insert, a UTF-8 sequence is at most 4 bytes
+        int ch;
+        while (action.length + 4 <= ACTION_TEXT_BUFFER_CAPACITY && (ch = GetCharPressed()) != 0) {
+            int utf8_size = 0;
+            const char* utf8 = CodepointToUTF8(ch, &utf8_size);
+            memcpy(action.text_buffer + action.length, utf8, utf8_size);
+            action.length += utf8_size;
+        }
+        if (action.length > 0) {
             action.type = ACTION_INSERT_CHAR;
-            action.text_buffer = malloc(1);
-            action.text_buffer[0] = (char)ch;
-            action.length = 1;
+            action.timestamp = GetTime();
             return action;
         }
     }
@@ -344,122 +348,94 @@ Action InputSystemPoll(InputSystem* sys) {
     if (key != 0) {
         ActionType found = LookupBinding(sys, key, mods);
         action.type = found;
+        action.timestamp = GetTime();
         return action;
     }
 
     return action;
 }
 
-void normalize_line_endings(char* buf) {
-    char* src = buf;
-    char* dst = buf;
-    while (*src) {
-        if (*src != '\r') {
-            *dst++ = *src;
-        }
-        src++;
-    }
-    *dst = '\0';
-}
+// Recording layout: magic, then per action frame (u32), timestamp (f64), type (u16),
+// payload length (u32) and payload bytes, all in host byte order.
+// The payload is the inserted text, or the clipboard content for ACTION_PASTE.
+typedef struct {
+    FILE* file;
+    uint32_t frame;
+    size_t action_count;
+} InputRecorder;
 
-FileType GetFileTypeFromPath(char* path) {
-    struct stat path_stat;
-    if (stat(path, &path_stat) != 0) {
-        return TYPE_ERROR;
-    } else if (S_ISDIR(path_stat.st_mode)) {
-        return TYPE_DIR;
-    } else if (S_ISREG(path_stat.st_mode)) {
-        return TYPE_FILE;
-    }
+typedef struct {
+    uint32_t frame;
+    double timestamp;
+    ActionType type;
+    char* payload;
+    size_t payload_length;
+    size_t payload_capacity;
+} RecordedAction;
 
-    return TYPE_ERROR;
+bool InitInputRecorder(InputRecorder* recorder, const char* path) {
+    recorder->frame = 0;
+    recorder->action_count = 0;
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+        return false;
+    }
+    fwrite(INPUT_RECORDING_MAGIC, 1, strlen(INPUT_RECORDING_MAGIC), recorder->file);
+    return true;
 }
 
-char* LoadFile(const char* filename, size_t* out_len) {
-    FILE* f = fopen(filename, "rb");
-    if (!f) {
-        fprintf(stderr, "Could not open file: %s\n", filename);
-        return NULL;
-    }
-    fseek(f, 0, SEEK_END);
-    size_t len = ftell(f);
-    rewind(f);
+void RecordAction(InputRecorder* recorder, Action* action, const char* payload, size_t payload_length) {
+    if (!recorder->file) return;
 
-    char* buf = malloc(len + 1);
-    if (!buf) {
-        fclose(f);
-        fprintf(stderr, "Out of memory!\n");
-        return NULL;
+    uint16_t type = (uint16_t)action->type;
+    uint32_t length = (uint32_t)payload_length;
+    fwrite(&recorder->frame, sizeof(recorder->frame), 1, recorder->file);
+    fwrite(&action->timestamp, sizeof(action->timestamp), 1, recorder->file);
+    fwrite(&type, sizeof(type), 1, recorder->file);
+    fwrite(&length, sizeof(length), 1, recorder->file);
+    if (payload_length > 0) {
+        fwrite(payload, 1, payload_length, recorder->file);
     }
-    fread(buf, 1, len, f);
-    buf[len] = '\0';
-    fclose(f);
-    if (out_len) *out_len = len;
-    return buf;
-}
-
-void ClearInputSystem(InputSystem* system) {
-    ClearCommandSystem(&system->command_system);   
+    recorder->action_count++;
 }
 
-typedef enum {
-    EDIT_INSERT,
-    EDIT_DELETE
-} EditType;
-
-typedef struct {
-    EditType type;
-    size_t position;
-    size_t length;
-    char* text;
-    size_t cursor_before;
-    size_t cursor_after;
-} EditEntry;
-
-void ClearEditEntry(EditEntry* entry) {
-    if (!entry) return;
-    
-    if (entry->text) {
-        free(entry->text);
-        entry->text = NULL;
-        entry->length = 0;
+void ClearInputRecorder(InputRecorder* recorder) {
+    if (recorder->file) {
+        fclose(recorder->file);
+        recorder->file = NULL;
     }
 }
 
-typedef struct {
-    EditEntry* entries;
-    size_t count;
-    size_t capacity;
-    size_t current;
-} UndoStack;
-
-UndoStack InitUndoStack()  {
-    UndoStack stack;
-    stack.entries = calloc(INITIAL_UNDO_STACK_CAPACITY, sizeof(EditEntry));
-    stack.capacity = INITIAL_UNDO_STACK_CAPACITY;
-    stack.count = 0;
-    stack.current = 0;
-    return stack;
+bool ReadRecordingHeader(FILE* f) {
+    char magic[sizeof(INPUT_RECORDING_MAGIC)] = {0};
+    size_t magic_length = strlen(INPUT_RECORDING_MAGIC);
+    return fread(magic, 1, magic_length, f) == magic_length && memcmp(magic, INPUT_RECORDING_MAGIC, magic_length) == 0;
 }
 
-void ClearUndoStack(UndoStack* stack) {
-    if (!stack) return;
+bool ReadRecordedAction(FILE* f, RecordedAction* out) {
+    uint16_t type;
+    uint32_t length;
+    if (fread(&out->frame, sizeof(out->frame), 1, f) != 1) return false;
+    if (fread(&out->timestamp, sizeof(out->timestamp), 1, f) != 1) return false;
+    if (fread(&type, sizeof(type), 1, f) != 1) return false;
+    if (fread(&length, sizeof(length), 1, f) != 1) return false;
 
-    if (stack->entries) {
-        for (size_t i = 0; i < stack->count; i++) {
-            ClearEditEntry(&stack->entries[i]);
-        }
-        free(stack->entries);
+    if (length + 1 > out->payload_capacity) {
+        out->payload_capacity = length + 1;
+        out->payload = realloc(out->payload, out->payload_capacity);
     }
-    stack->capacity = 0;
-    stack->current = 0;
-    stack->count = 0;
+    if (length > 0 && fread(out->payload, 1, length, f) != length) return false;
+    if (out->payload) out->payload[length] = '\0';
+
+    out->type = (ActionType)type;
+    out->payload_length = length;
+    return true;
 }
 
-typedef struct {
-    size_t x;
-    size_t y;
-} Position;
+void ClearInputSystem(InputSystem* system) {
+    ClearCommandSystem(&system->command_system);   
+}
 
 Vector2 PositionToVector(Position position) {
     return (Vector2){position.x, position.y};
@@ -470,405 +446,6 @@ typedef struct {
     Position size;
 } Rect;
 
-typedef struct {
-    BufferType source;
-    size_t start;
-    size_t length;
-} Piece;
-
-typedef struct {
-    Position* line_positions;
-    size_t line_count;
-    size_t capacity;
-    bool is_valid;
-} LineCache;
-
-LineCache InitLineCache() {
-    LineCache cache;
-    cache.capacity = 1024;
-    cache.line_positions = calloc(cache.capacity, sizeof(Position));
-    cache.line_count = 0;
-    cache.is_valid = false;
-    return cache;
-}
-void ClearLineCache(LineCache* cache) {
-    if (!cache) return;
-    
-    if (cache->line_positions) {
-        free(cache->line_positions);
-        cache->line_positions = NULL;
-    }
-    cache->line_count = 0;
-    cache->capacity = 0;
-    cache->is_valid = false;
-}
-
-typedef struct {
-    char* file_path;
-
-    char* org_buffer;
-    size_t org_buffer_size;
-
-    char* add_buffer;
-    size_t add_buffer_capacity;
-    size_t add_buffer_count;
-
-    Piece* pieces;
-    size_t piece_capacity;
-    size_t piece_count;
-
-    LineCache line_cache;
-
-    size_t line_anchor;
-    size_t offset_x;
-
-    size_t pointer_position;
-    size_t selection_start;
-    size_t selection_end;
-
-    double time_since_last_edit;
-
-    Position pointer_position_cache;
-    size_t last_pointer_position_cached;
-    bool request_revalidate_pointer_cache;
-    bool has_selection;
-
-    UndoStack undo_stack;
-} TextBuffer;
-
-size_t GetTextSize(TextBuffer* buffer) {
-    size_t out = 0;
-    for (size_t i = 0; i < buffer->piece_count; ++i) {
-        out += buffer->pieces[i].length;
-    }
-    return out;
-}
-
-void PushCommand(TextBuffer* buffer, EditType type, size_t position, const char* text, size_t length) {
-    UndoStack* stack = &buffer->undo_stack;
-    for (size_t i = stack->current; i < stack->count; i++) {
-        ClearEditEntry(&stack->entries[i]);      
-    }
-    stack->count = stack->current;
-
-    if (stack->count >= stack->capacity) {
-        ClearEditEntry(&stack->entries[0]);
-        memmove(stack->entries, stack->entries + 1, (stack->capacity - 1) * sizeof(EditEntry));
-        stack->count--;
-    }
-    
-    EditEntry* entry = &stack->entries[stack->count];
-    entry->type = type;
-    entry->position = position;
-    entry->length = length;
-    entry->cursor_before = buffer->pointer_position;
-    switch (entry->type)
-    {
-        case EDIT_INSERT:
-            entry->cursor_after = buffer->pointer_position + entry->length;
-            break;
-        case EDIT_DELETE:
-            entry->cursor_after = buffer->pointer_position - entry->length;
-            break;
-    }
-
-    if (text && length > 0) {
-        entry->text = malloc(length + 1);
-        memcpy(entry->text, text, length);
-        entry->text[length] = '\0';
-    } else {
-        entry->text = NULL;
-    }
-
-    stack->count++;
-    stack->current = stack->count;
-}
-
-char GetCharAt(TextBuffer* buffer, size_t position) {
-    size_t traversed = 0;
-    char* work_buffer;
-    
-    for (size_t i = 0; i < buffer->piece_count; i++) {
-        work_buffer = buffer->pieces[i].source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
-        
-        if (traversed + buffer->pieces[i].length > position) {
-            size_t offset = position - traversed;
-            return work_buffer[buffer->pieces[i].start + offset];
-        }
-        
-        traversed += buffer->pieces[i].length;
-    }
-    
-    return '\0'; 
-}
-
-bool TryToMergeCharacterRemove(TextBuffer* buffer, float current_time) {
-    UndoStack* stack = &buffer->undo_stack;
-    if (stack->current > 0 && current_time - buffer->time_since_last_edit < 1.0) {
-        EditEntry* prev = &stack->entries[stack->current - 1];
-        if (prev->type == EDIT_DELETE && prev->position == buffer->pointer_position) {
-            char deleted = GetCharAt(buffer, buffer->pointer_position - 1);
-
-            char* new_text = malloc(prev->length + 2);
-            new_text[0] = deleted;
-            memcpy(new_text + 1, prev->text, prev->length);
-            new_text[prev->length + 1] = '\0';
-
-            free(prev->text);
-            prev->text = new_text;
-            prev->length++;
-            prev->position--;
-            prev->cursor_after = buffer->pointer_position - 1;
-            
-            return true;
-        }
-    }
-    return false;
-}
-
-bool TryToMergeCharacterInsert(TextBuffer* buffer, char* value, size_t len, float current_time) {
-    UndoStack* stack = &buffer->undo_stack;
-    if (stack->current > 0 && current_time - buffer->time_since_last_edit < 1.0) {
-        EditEntry* prev = &stack->entries[stack->current - 1];
-        if (prev->type == EDIT_INSERT && 
-            prev->position + prev->length == buffer->pointer_position &&
-            memchr(value, '\n', len) == NULL) {
-            
-            char* new_text = realloc(prev->text, prev->length + len + 1);
-            if (!new_text) {
-                return false;
-            }
-            memcpy(new_text + prev->length, value, len);
-            new_text[prev->length + len] = '\0';
-            prev->text = new_text;
-            prev->length += len;
-            prev->cursor_after = buffer->pointer_position + len;
-            return true;
-        }
-    }
-    return false;
-}
-
-void RebuildLineCache(TextBuffer* buffer) {
-    buffer->line_cache.line_count = 0;
-    buffer->line_cache.line_positions[0].x = 0;
-    buffer->line_cache.line_positions[0].y = 0;
-    size_t current_pos = 0;
-    char* work_buffer;
-
-    for (size_t i = 0; i < buffer->piece_count; ++i) {
-        work_buffer = buffer->pieces[i].source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
-
-        for (size_t j = 0; j < buffer->pieces[i].length; ++j) {
-            if (work_buffer[buffer->pieces[i].start + j] == '\n') {
-                
-                while (buffer->line_cache.line_count + 1 >= buffer->line_cache.capacity) {
-                    buffer->line_cache.capacity *= 2;
-                    buffer->line_cache.line_positions = realloc(buffer->line_cache.line_positions, buffer->line_cache.capacity * sizeof(Position));
-                }
-
-                buffer->line_cache.line_positions[buffer->line_cache.line_count].y = current_pos - buffer->line_cache.line_positions[buffer->line_cache.line_count].x;
-                buffer->line_cache.line_count++;
-                buffer->line_cache.line_positions[buffer->line_cache.line_count].x = current_pos + 1;
-                buffer->line_cache.line_positions[buffer->line_cache.line_count].y = 0;
-            }
-            current_pos++;
-        }
-    }
-    buffer->line_cache.line_positions[buffer->line_cache.line_count].y = current_pos - buffer->line_cache.line_positions[buffer->line_cache.line_count].x;
-    buffer->line_cache.line_count++;
-    buffer->line_cache.is_valid = true;
-}
-
-void InitTextBuffer(TextBuffer* buffer) {
-    buffer->add_buffer = calloc(INITIAL_ADD_BUFFER_CAPACITY, sizeof(char));
-    buffer->add_buffer_capacity = INITIAL_ADD_BUFFER_CAPACITY;    
-    buffer->add_buffer_count = 0;
-
-    buffer->line_cache = InitLineCache();
-    
-    buffer->line_anchor = 0;
-    buffer->offset_x = 0;
-    buffer->pointer_position = 0;
-    buffer->pointer_position_cache = (Position){0, 0};
-    buffer->last_pointer_position_cached = 0;
-    buffer->request_revalidate_pointer_cache = false;
-    buffer->time_since_last_edit = 0;
-
-    buffer->selection_start = 0;
-    buffer->selection_end = 0;
-    buffer->has_selection = false;
-
-    buffer->undo_stack = InitUndoStack();
-}
-
-char* GetTextRange(TextBuffer* buffer, size_t start, size_t end) {
-    size_t length = end - start;
-    char* result = malloc(length + 1);
-    for (size_t i = 0; i < length; i++) {
-        result[i] = GetCharAt(buffer, start + i);
-    }
-    result[length] = '\0';
-    return result;
-}
-
-void InitPieceBuffer(TextBuffer* buffer) {
-    buffer->pieces = calloc(INITIAL_PIECE_BUFFER_CAPACITY, sizeof(Piece));
-    buffer->piece_capacity = INITIAL_PIECE_BUFFER_CAPACITY;
-    buffer->pieces[0].source = ORIGINAL;
-    buffer->pieces[0].start = 0;
-    buffer->pieces[0].length = strlen(buffer->org_buffer);
-    
-    buffer->piece_count = 1;
-}
-
-void InitEmptyTextBuffer(TextBuffer* buffer) {
-    InitTextBuffer(buffer);
-
-    buffer->file_path = NULL;
-    buffer->org_buffer = strdup("");
-    buffer->org_buffer_size = 0;
-
-    InitPieceBuffer(buffer);
-    RebuildLineCache(buffer);
-}
-
-void InitTextBufferFromPath(TextBuffer* buffer, const char* path) {
-    InitTextBuffer(buffer);
-    
-    buffer->file_path = strdup(path);
-    buffer->org_buffer = LoadFile(path, &buffer->org_buffer_size);
-    normalize_line_endings(buffer->org_buffer);
-
-    InitPieceBuffer(buffer);
-    RebuildLineCache(buffer);
-}
-
-Position GetLinePosition(TextBuffer* buffer, size_t index) {
-    if (!buffer->line_cache.is_valid) {
-        RebuildLineCache(buffer);
-    }
-
-    return buffer->line_cache.line_positions[index];
-}
-
-Position GetLineByIndex(TextBuffer* buffer, size_t index) {
-    return GetLinePosition(buffer, index);
-}
-
-size_t GetLineCount(TextBuffer* buffer)  {
-    if (!buffer->line_cache.is_valid) {
-        RebuildLineCache(buffer);
-    }
-    return buffer->line_cache.line_count;
-}
-
-char* GenerateLine(TextBuffer* buffer, size_t index) {
-    //TODO: Use line cache
-    char* line;
-    Position line_position = GetLineByIndex(buffer, index);
-    line = calloc(line_position.y + 1, sizeof(char));
-
-    size_t start_pos = line_position.x;
-    size_t end_pos = start_pos + line_position.y;
-
-    size_t traversed = 0;
-    char* temp = line;
-    Piece piece;
-    char* work_buffer;
-    size_t copied = 0;
-    for (size_t i = 0; i < buffer->piece_count && copied < line_position.y; ++i) {
-        piece = buffer->pieces[i];
-        work_buffer = piece.source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
-        
-        size_t piece_start = traversed;
-        size_t piece_end = traversed + piece.length;
-
-        if (piece_end > start_pos && piece_start < end_pos) {
-            size_t copy_start = (piece_start >= start_pos) ? 0 : start_pos - piece_start;
-            size_t copy_end = (piece_end <= end_pos) ? piece.length : end_pos - piece_start;
-
-            memcpy(line + copied, work_buffer + piece.start + copy_start, copy_end - copy_start);
-            copied += copy_end - copy_start;
-        }
-        traversed += piece.length;
-    }
-    line[line_position.y] = '\0';
-    return line;
-}
-
-Position IndexToPosition(TextBuffer* buffer, size_t index) {  
-    //TODO: Use line cache
-    Position out = {0, 0};
-    size_t traversed = 0;
-    char* work_buffer;
-    for (size_t i = 0; i < buffer->piece_count && traversed < index; ++i) {
-        work_buffer = buffer->pieces[i].source == ORIGINAL ? buffer->org_buffer : buffer->add_buffer;
-        
-        size_t to_read = index - traversed;
-        if (to_read > buffer->pieces[i].length) to_read = buffer->pieces[i].length;
-        for (size_t j = 0; j < to_read; ++j) {
-            if (work_buffer[buffer->pieces[i].start + j] == '\n') {
-                out.y++;
-                out.x = 0;
-            } else {
-                out.x++;
-            }
-        }
-        traversed += to_read;
-    }    
-    return out;
-}
-
-Position GetPointerPosition(TextBuffer* buffer) {
-    if (!buffer->request_revalidate_pointer_cache && buffer->pointer_position == buffer->last_pointer_position_cached) return buffer->pointer_position_cache;
-    Position out = IndexToPosition(buffer, buffer->pointer_position);
-
-    buffer->request_revalidate_pointer_cache = false;
-    buffer->pointer_position_cache = out;
-    buffer->last_pointer_position_cached = buffer->pointer_position;
-    return out;
-}
-
-void ClearTextBuffer(TextBuffer* buffer) {
-    if (!buffer) return;
-
-    if (buffer->file_path) {
-        free(buffer->file_path);
-        buffer->file_path = NULL;
-    }
-
-    if (buffer->org_buffer) {
-        free(buffer->org_buffer);
-        buffer->org_buffer = NULL;
-    }
-    buffer->org_buffer_size = 0;
-
-    if (buffer->add_buffer) {
-        free(buffer->add_buffer);
-        buffer->add_buffer = NULL;
-    }
-    buffer->add_buffer_capacity = 0;
-    buffer->add_buffer_count = 0;
-
-    if (buffer->pieces) {
-        free(buffer->pieces);
-        buffer->pieces = NULL;
-    }
-    buffer->piece_capacity = 0;
-    buffer->piece_count = 0;
-
-    ClearLineCache(&buffer->line_cache);
-
-    buffer->line_anchor = 0;
-    buffer->pointer_position = 0;
-    buffer->selection_start = 0;
-    buffer->selection_end = 0;
-    buffer->has_selection = false;
-
-    ClearUndoStack(&buffer->undo_stack);
-}
-
 typedef struct {
     char* root_dir;
 
@@ -879,6 +456,12 @@ typedef struct {
     int open_text_buffer_index;
     bool exit_requested;
 
+    // A file too large to edit, shown read-only in place of the open buffer
+    PagedFile* paged_file;
+    // A binary file, shown as bytes in place of the open buffer
+    HexView* hex_view;
+    // Tree of root_dir, walked off the render thread
+    FileCache* file_cache;
 } EditorState;
 
 EditorState InitEditorState(size_t capacity) {
@@ -888,6 +471,10 @@ EditorState InitEditorState(size_t capacity) {
     state.text_buffers = calloc(capacity, sizeof(TextBuffer));
     state.text_buffers_capacity = capacity;
     state.text_buffers_count = 0;
+    state.exit_requested = false;
+    state.paged_file = NULL;
+    state.hex_view = NULL;
+    state.file_cache = NULL;
     return state;
 }
 
@@ -910,12 +497,31 @@ void ClearEditorState(EditorState* state) {
     state->text_buffers_count = 0;
     state->open_text_buffer_index = 0;
 
+    if (state->paged_file) {
+        ClosePagedFile(state->paged_file);
+        free(state->paged_file);
+        state->paged_file = NULL;
+    }
+
+    if (state->hex_view) {
+        CloseHexView(state->hex_view);
+        free(state->hex_view);
+        state->hex_view = NULL;
+    }
+
+    if (state->file_cache) {
+        ClearFileCache(state->file_cache);
+        free(state->file_cache);
+        state->file_cache = NULL;
+    }
+
     state->exit_requested = false;
 }
 
 void ResizeTextBuffers(EditorState* state) {
     size_t new_size = state->text_buffers_capacity * 2;
     state->text_buffers = realloc(state->text_buffers, new_size * sizeof(TextBuffer));
+    state->text_buffers_capacity = new_size;
 
     if (!state->text_buffers) {
         // TODO: Handle realloc fail gracefully
@@ -930,10 +536,23 @@ size_t GetFreeTextBufferIndex(EditorState* state) {
     return index;
 }
 
+void OpenEmptyBuffer(EditorState* state) {
+    size_t index = GetFreeTextBufferIndex(state); 
+
+    InitEmptyTextBuffer(&state->text_buffers[index]);
+    state->open_text_buffer_index = index;
+}
+
+// Starts walking the directory in the background, an empty buffer is open meanwhile
 void OpenDirectoryFromPath(EditorState* state, const char* path) {
     state->root_dir = strdup(path);
 
-    //TODO: introduce file cache and modal system
+    //TODO: introduce modal system
+    state->file_cache = malloc(sizeof(FileCache));
+    if (!InitFileCache(state->file_cache, path, 0)) {
+        TraceLog(LOG_WARNING, "Could not walk directory: %s", path);
+    }
+    OpenEmptyBuffer(state);
 }
 
 void OpenFileFromPath(EditorState* state, const char* path) {
@@ -943,11 +562,73 @@ void OpenFileFromPath(EditorState* state, const char* path) {
     state->open_text_buffer_index = index;
 }
  
-void OpenEmptyBuffer(EditorState* state) {
-    size_t index = GetFreeTextBufferIndex(state); 
+typedef struct {
+    EditorState* state;
+    size_t first_index;
+    char** paths;
+} FileOpenBatch;
+
+static void OpenLoadedFile(void* context, size_t index, char* data, size_t length) {
+    FileOpenBatch* batch = context;
+    InitTextBufferFromData(&batch->state->text_buffers[batch->first_index + index], batch->paths[index], data, length);
+}
+
+// Opens every regular file among paths with their reads all in flight at once, and shows the
+// first of them. Returns how many were opened.
+size_t OpenFilesFromPaths(EditorState* state, char** paths, size_t count) {
+    char** files = malloc(count * sizeof(char*));
+    size_t file_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (GetFileTypeFromPath(paths[i]) == TYPE_FILE) {
+            files[file_count++] = paths[i];
+        } else {
+            TraceLog(LOG_WARNING, "open: not a file: %s", paths[i]);
+        }
+    }
 
-    InitEmptyTextBuffer(&state->text_buffers[index]);
-    state->open_text_buffer_index = index;
+    if (file_count > 0) {
+        // Every slot is taken first, the buffers must not move while the reads fill them
+        size_t first = state->text_buffers_count;
+        for (size_t i = 0; i < file_count; ++i) {
+            GetFreeTextBufferIndex(state);
+        }
+        FileOpenBatch batch = { state, first, files };
+        FileLoadMethod method = LoadFiles((const char* const*)files, file_count, OpenLoadedFile, &batch);
+        TraceLog(LOG_INFO, "open: read %zu files %s", file_count, method == FILE_LOAD_URING ? "through io_uring" : "on a thread pool");
+        state->open_text_buffer_index = first;
+    }
+    free(files);
+    return file_count;
+}
+
+// Opens path in the read-only viewer, an empty buffer stands in wherever a buffer is expected
+bool OpenPagedFileFromPath(EditorState* state, const char* path, size_t cache_size) {
+    PagedFile* file = malloc(sizeof(PagedFile));
+    if (!OpenPagedFile(file, path, cache_size)) {
+        free(file);
+        return false;
+    }
+    state->paged_file = file;
+    OpenEmptyBuffer(state);
+    return true;
+}
+
+bool OpenHexViewFromPath(EditorState* state, const char* path) {
+    HexView* view = malloc(sizeof(HexView));
+    if (!OpenHexView(view, path)) {
+        free(view);
+        return false;
+    }
+    state->hex_view = view;
+    OpenEmptyBuffer(state);
+    return true;
+}
+
+// Path of the file shown read-only by one of the viewers, NULL while editing buffers
+const char* GetViewedFilePath(EditorState* state) {
+    if (state->paged_file) return state->paged_file->path;
+    if (state->hex_view) return state->hex_view->path;
+    return NULL;
 }
 
 typedef struct {
@@ -956,6 +637,7 @@ typedef struct {
     Color text_color;
     Color command_color;
     Color line_number_color;
+    Color match_color;
 } ColorScheme;
 
 typedef struct {
@@ -967,6 +649,12 @@ typedef struct {
     size_t number_padding;
     size_t pointer_width;
     size_t font_size;
+
+    // Open the file in the viewer whatever its size, with this much memory for its pages
+    bool paged;
+    size_t paged_cache_size;
+    // Open the file as bytes whether or not it looks binary
+    bool hex;
 } EditorSettings;
 
 void ClearEditorSettings(EditorSettings* settings) {
@@ -977,23 +665,201 @@ void ClearEditorSettings(EditorSettings* settings) {
     }
 }
 
+typedef enum {
+    LATENCY_DISPATCH,
+    LATENCY_RENDER,
+    LATENCY_PRESENT,
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+const char* LatencyStageToString(LatencyStage stage) {
+    switch (stage) {
+        case LATENCY_DISPATCH: return "dispatch";
+        case LATENCY_RENDER: return "render";
+        case LATENCY_PRESENT: return "present";
+        default: return "unknown";
+    }
+}
+
+typedef struct {
+    double p50;
+    double p95;
+    double p99;
+    double max;
+} LatencyStats;
+
+// Rolling window of input-to-stage latencies in seconds, one sample per frame that had input
+typedef struct {
+    double samples[LATENCY_STAGE_COUNT][LATENCY_SAMPLE_CAPACITY];
+    size_t sample_count;
+    size_t next_sample;
+
+    double input_time;
+    double dispatch_time;
+    double render_time;
+    bool frame_has_input;
+
+    LatencyStats stats[LATENCY_STAGE_COUNT];
+    size_t stats_sample_count;
+
+    bool overlay_visible;
+} LatencyTracker;
+
+void InitLatencyTracker(LatencyTracker* tracker) {
+    memset(tracker, 0, sizeof(LatencyTracker));
+}
+
+void LatencyMarkInput(LatencyTracker* tracker, double timestamp) {
+    if (tracker->frame_has_input) return;
+    tracker->frame_has_input = true;
+    tracker->input_time = timestamp;
+}
+
+void LatencyMarkDispatch(LatencyTracker* tracker) {
+    if (!tracker->frame_has_input) return;
+    tracker->dispatch_time = GetTime();
+}
+
+void LatencyMarkRender(LatencyTracker* tracker) {
+    if (!tracker->frame_has_input) return;
+    tracker->render_time = GetTime();
+}
+
+void LatencyMarkPresent(LatencyTracker* tracker) {
+    if (!tracker->frame_has_input) return;
+    double present_time = GetTime();
+
+    size_t slot = tracker->next_sample;
+    tracker->samples[LATENCY_DISPATCH][slot] = tracker->dispatch_time - tracker->input_time;
+    tracker->samples[LATENCY_RENDER][slot] = tracker->render_time - tracker->input_time;
+    tracker->samples[LATENCY_PRESENT][slot] = present_time - tracker->input_time;
+
+    tracker->next_sample = (tracker->next_sample + 1) % LATENCY_SAMPLE_CAPACITY;
+    tracker->sample_count++;
+    tracker->frame_has_input = false;
+}
+
+size_t GetLatencyWindowSize(LatencyTracker* tracker) {
+    return min(tracker->sample_count, (size_t)LATENCY_SAMPLE_CAPACITY);
+}
+
+int CompareDoubles(const void* a, const void* b) {
+    double lhs = *(const double*)a;
+    double rhs = *(const double*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+void UpdateLatencyStats(LatencyTracker* tracker) {
+    if (tracker->stats_sample_count == tracker->sample_count) return;
+
+    size_t window = GetLatencyWindowSize(tracker);
+    double sorted[LATENCY_SAMPLE_CAPACITY];
+    for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        LatencyStats* stats = &tracker->stats[stage];
+        if (window == 0) {
+            *stats = (LatencyStats){0};
+            continue;
+        }
+        memcpy(sorted, tracker->samples[stage], window * sizeof(double));
+        qsort(sorted, window, sizeof(double), CompareDoubles);
+        stats->p50 = sorted[(window - 1) * 50 / 100];
+        stats->p95 = sorted[(window - 1) * 95 / 100];
+        stats->p99 = sorted[(window - 1) * 99 / 100];
+        stats->max = sorted[window - 1];
+    }
+    tracker->stats_sample_count = tracker->sample_count;
+}
+
+bool WriteLatencyCsv(LatencyTracker* tracker, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+        return false;
+    }
+
+    size_t window = GetLatencyWindowSize(tracker);
+    size_t oldest = tracker->sample_count > LATENCY_SAMPLE_CAPACITY ? tracker->next_sample : 0;
+    fprintf(f, "sample,dispatch_ms,render_ms,present_ms\n");
+    for (size_t i = 0; i < window; ++i) {
+        size_t slot = (oldest + i) % LATENCY_SAMPLE_CAPACITY;
+        fprintf(f, "%zu,%.3f,%.3f,%.3f\n", tracker->sample_count - window + i,
+            tracker->samples[LATENCY_DISPATCH][slot] * 1000.0,
+            tracker->samples[LATENCY_RENDER][slot] * 1000.0,
+            tracker->samples[LATENCY_PRESENT][slot] * 1000.0);
+    }
+
+    fclose(f);
+    return true;
+}
+
 typedef struct {
     EditorState state;
     EditorSettings settings;
     InputSystem input_system;
+    LatencyTracker latency;
+    InputRecorder recorder;
+    Macro macro;
+
+    // Time of the action being dispatched, replay sets it from the recording
+    double current_time;
+
+    // Without a window there is no system clipboard, copy and paste use this instead
+    bool headless;
+    char* clipboard;
+
+    // The term last searched for. The index finds its matches around the view for highlighting,
+    // the workers count all of them in the background for the status line. Once they are done
+    // the index holds the whole count and edits only rescan around what they changed.
+    MatchIndex match_index;
+    size_t search_buffer_index;
+    ParallelSearch search;
+    MatchList search_matches;
+    // Revision of the text the count is for
+    uint64_t search_revision;
+
+    // Search as you type while a find command is being edited, the view is scanned on its own
+    // until the full scan has passed it
+    IncrementalSearch incremental_search;
+    MatchList visible_matches;
+
+    // Saves run on their own thread, how they are doing is shown in the command line
+    BackgroundSave save;
+    size_t save_buffer_index;
+    char command_status[256];
+
+    // Changes other programs make to the open files. Followed files only ever grow, their
+    // journals are started over from them once in a while rather than on every append.
+    FileWatcher watcher;
+    double journal_rebase_time;
 } Editor;
 
-Editor CreateEditor(EditorSettings settings, char* path) {
+void RegisterEditorCommands(CommandRegistry* registry);
+
+Editor CreateEditor(EditorSettings settings, char** paths, size_t path_count) {
     Editor editor;
     editor.settings = settings;
     editor.state = InitEditorState(INITIAL_TEXT_BUFFER_CAPACITY);
     
+    char* path = path_count > 0 ? paths[0] : NULL;
     FileType root_type = TYPE_ERROR;
     if (path) {
         root_type = GetFileTypeFromPath(path);
     } 
 
-    if (root_type == TYPE_FILE) {
+    if (path_count > 1) {
+        if (OpenFilesFromPaths(&editor.state, paths, path_count) == 0) {
+            OpenEmptyBuffer(&editor.state);
+        }
+    } else if (root_type == TYPE_FILE && (settings.hex || IsBinaryFile(path))) {
+        if (!OpenHexViewFromPath(&editor.state, path)) {
+            OpenEmptyBuffer(&editor.state);
+        }
+    } else if (root_type == TYPE_FILE && (settings.paged || IsLargeFile(path))) {
+        size_t cache_size = settings.paged_cache_size ? settings.paged_cache_size : PAGED_FILE_DEFAULT_CACHE_SIZE;
+        if (!OpenPagedFileFromPath(&editor.state, path, cache_size)) {
+            OpenEmptyBuffer(&editor.state);
+        }
+    } else if (root_type == TYPE_FILE) {
         OpenFileFromPath(&editor.state, path);
     } else if (root_type == TYPE_DIR) {
         OpenDirectoryFromPath(&editor.state, path);
@@ -1002,6 +868,25 @@ Editor CreateEditor(EditorSettings settings, char* path) {
     }
 
     editor.input_system = InitInputSystem();
+    RegisterEditorCommands(&editor.input_system.command_system.registry);
+    InitLatencyTracker(&editor.latency);
+    editor.recorder = (InputRecorder){0};
+    editor.macro = InitMacro();
+    editor.current_time = 0;
+    editor.headless = false;
+    editor.clipboard = NULL;
+    editor.match_index = (MatchIndex){0};
+    editor.search_buffer_index = 0;
+    editor.search = (ParallelSearch){0};
+    InitMatchList(&editor.search_matches);
+    editor.search_revision = 0;
+    InitIncrementalSearch(&editor.incremental_search);
+    InitMatchList(&editor.visible_matches);
+    editor.save = (BackgroundSave){0};
+    editor.save_buffer_index = 0;
+    editor.command_status[0] = '\0';
+    InitFileWatcher(&editor.watcher);
+    editor.journal_rebase_time = 0;
 
     return editor;
 }
@@ -1013,9 +898,48 @@ TextBuffer* GetActiveBuffer(Editor* editor) {
 void ClearEditor(Editor* editor) {
     if (!editor) return;
 
+    // Workers read the buffers, let them finish first
+    ClearBackgroundSave(&editor->save);
+    ClearParallelSearch(&editor->search);
+    for (size_t i = 0; i < editor->state.text_buffers_count; ++i) {
+        TextBuffer* buffer = &editor->state.text_buffers[i];
+        if (buffer->journal) {
+            CloseEditJournal(buffer->journal, buffer);
+            buffer->journal = NULL;
+        }
+    }
+
     ClearEditorState(&editor->state);
     ClearEditorSettings(&editor->settings);
     ClearInputSystem(&editor->input_system);
+    ClearInputRecorder(&editor->recorder);
+    ClearMacro(&editor->macro);
+    ClearMatchIndex(&editor->match_index);
+    ClearMatchList(&editor->search_matches);
+    ClearIncrementalSearch(&editor->incremental_search);
+    ClearMatchList(&editor->visible_matches);
+    ClearFileWatcher(&editor->watcher);
+
+    if (editor->clipboard) {
+        free(editor->clipboard);
+        editor->clipboard = NULL;
+    }
+}
+
+const char* EditorGetClipboardText(Editor* editor) {
+    if (editor->headless) {
+        return editor->clipboard;
+    }
+    return GetClipboardText();
+}
+
+void EditorSetClipboardText(Editor* editor, const char* text) {
+    if (editor->headless) {
+        free(editor->clipboard);
+        editor->clipboard = strdup(text);
+        return;
+    }
+    SetClipboardText(text);
 }
 
 bool ShouldEditorClose(Editor* editor) {
@@ -1029,417 +953,898 @@ Rect GetEditorTextFieldSize(Editor* editor) {
     };
 }
 
-void MovePointerLeft(TextBuffer* buffer) {
-    if (buffer->pointer_position > 0) {
-        buffer->pointer_position--;
-        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+void MovePointerAction(Editor* editor, void(*move_function)(TextBuffer* buffer)) {
+    TextBuffer* buffer = GetActiveBuffer(editor); 
+    size_t pointer_before = buffer->pointer_position;
+    move_function(buffer);
+    if (buffer->pointer_position != pointer_before) {
+        buffer->has_selection = false;
     }
 }
-
-void MovePointerRight(TextBuffer* buffer) {
-    if (buffer->pointer_position <= GetTextSize(buffer)) {
-        buffer->pointer_position++;
-        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
+void MovePointerSelectionAction(Editor* editor, void(*move_function)(TextBuffer* buffer)) {
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    size_t pointer_before = buffer->pointer_position;
+    move_function(buffer);
+    if (pointer_before != buffer->pointer_position) {
+        if (!buffer->has_selection) {
+            buffer->has_selection = true;
+            buffer->selection_start = pointer_before;
+        }
+        buffer->selection_end = buffer->pointer_position;
     }
 }
 
-void MovePointerUp(TextBuffer* buffer) {
-    Position pointer = GetPointerPosition(buffer);
-    if (pointer.y == 0) {
-        return;
-    }
-    Position nextLine = GetLineByIndex(buffer, pointer.y - 1);
-    if (buffer->pointer_position != nextLine.x + min(nextLine.y, pointer.x)) {
-        buffer->pointer_position = nextLine.x + min(nextLine.y, pointer.x);
-        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
-    }   
+void InsertStringAction(Editor* editor, char* value, size_t len) {
+    InsertTextAtPointer(GetActiveBuffer(editor), value, len, editor->current_time);
 }
 
-void MovePointerDown(TextBuffer* buffer) {
-    Position pointer = GetPointerPosition(buffer);
-    size_t max_lines = GetLineCount(buffer);
-    if (pointer.y >= max_lines - 1) {
-        return;
-    }
-    Position nextLine = GetLineByIndex(buffer, pointer.y + 1);
-    if (buffer->pointer_position != nextLine.x + min(nextLine.y, pointer.x)) {
-        buffer->pointer_position = nextLine.x + min(nextLine.y, pointer.x);
-        buffer->request_revalidate_pointer_cache = true; // TODO: strictly not needed!
-    }
+void RemoveBackwardsAction(Editor* editor) {
+    RemoveBackwardsAtPointer(GetActiveBuffer(editor), editor->current_time);
+}
+
+void InsertNewLineAction(Editor* editor) {
+    char new_line_buffer[1];
+    new_line_buffer[0] = '\n';
+    InsertStringAction(editor, new_line_buffer, 1);
 }
 
-bool IsWordChar(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+void InsertTabAction(Editor* editor) {
+    char tab_buffer[2];
+    tab_buffer[0] = ' ';
+    tab_buffer[1] = ' ';
+    InsertStringAction(editor, tab_buffer, 2);
 }
 
-bool IsPunct(char c) {
-    return c && !IsWordChar(c) && c != ' ' && c != '\t' && c != '\n';
+void UndoAction(Editor* editor) {
+    UndoEdit(GetActiveBuffer(editor));
+}
+
+void RedoAction(Editor* editor) {
+    RedoEdit(GetActiveBuffer(editor));
 }
 
-void MovePointerWordRight(TextBuffer* buffer) {
-    size_t size = GetTextSize(buffer);
-    if (buffer->pointer_position >= size) return;
-    char c = GetCharAt(buffer, buffer->pointer_position);
+void PasteAction(Editor* editor) {
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    const char* clipboard_text = EditorGetClipboardText(editor);
+    if (clipboard_text == NULL || clipboard_text[0] == '\0') {
+        return;
+    }
+
+    if (buffer->has_selection) {
+        RemoveSelection(buffer);
+    }
     
-    if (c == '\n') {
-        buffer->pointer_position++;
+    size_t clipboard_length = strlen(clipboard_text);
+    char* paste_buffer = malloc(clipboard_length + 1);
+    if (paste_buffer == NULL) {
         return;
     }
+    strcpy(paste_buffer, clipboard_text);
+
+    size_t paste_buffer_length = StripCarriageReturns(paste_buffer, clipboard_length, NULL);
+
+    PushCommand(buffer, EDIT_INSERT, buffer->pointer_position, paste_buffer, paste_buffer_length);
+
+    InsertString(buffer, buffer->pointer_position, paste_buffer, paste_buffer_length);
+    buffer->pointer_position += paste_buffer_length;
     
-    if (IsWordChar(c)) {
-        while (buffer->pointer_position < size && IsWordChar(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
-    } else if (IsPunct(c)) {
-        while (buffer->pointer_position < size && IsPunct(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
+    free(paste_buffer);
+}
+
+void CopyAction(Editor* editor) {
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    if (!buffer->has_selection) return;
+    size_t selection_length = abs((int)buffer->selection_end - (int)buffer->selection_start);
+    char* selection_buffer = GetTextRange(buffer, min(buffer->selection_start, buffer->selection_end), min(buffer->selection_start, buffer->selection_end) + selection_length);
+
+    EditorSetClipboardText(editor, selection_buffer);
+
+    free(selection_buffer);
+}
+
+void CutAction(Editor* editor) {
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    if (!buffer->has_selection) return;
+
+    CopyAction(editor);
+    RemoveSelection(buffer);
+}
+
+void ToggleLatencyOverlayAction(Editor* editor) {
+    editor->latency.overlay_visible = !editor->latency.overlay_visible;
+}
+
+void ToggleCommandModeAction(Editor* editor) {
+    if (editor->input_system.current_mode == MODE_COMMAND) {
+        editor->input_system.current_mode = MODE_TEXT;
     } else {
-        while (buffer->pointer_position < size && (c = GetCharAt(buffer, buffer->pointer_position), c == ' ' || c == '\t')) buffer->pointer_position++;
-        if (buffer->pointer_position < size && GetCharAt(buffer, buffer->pointer_position) == '\n') return;
-        while (buffer->pointer_position < size && IsPunct(GetCharAt(buffer, buffer->pointer_position))) buffer->pointer_position++;
+        editor->input_system.current_mode = MODE_COMMAND;
     }
 }
 
-void MovePointerWordLeft(TextBuffer* buffer) {
-    size_t size = GetTextSize(buffer);
-    if (buffer->pointer_position == 0) return;
-    buffer->pointer_position--;
-    
-    char c = GetCharAt(buffer, buffer->pointer_position);
-    if (c == '\n') return;
-    
-    while (buffer->pointer_position > 0 && (c = GetCharAt(buffer, buffer->pointer_position), c == ' ' || c == '\t')) {
-        if (GetCharAt(buffer, buffer->pointer_position - 1) == '\n') return;
-        buffer->pointer_position--;
+void DispatchInputTextMode(Editor* editor, Action action);
+
+void ToggleMacroRecordingAction(Editor* editor) {
+    Macro* macro = &editor->macro;
+    if (!macro->recording) {
+        macro->count = 0;
     }
-    
-    c = GetCharAt(buffer, buffer->pointer_position);
-    if (IsWordChar(c)) {
-        while (buffer->pointer_position > 0 && IsWordChar(GetCharAt(buffer, buffer->pointer_position - 1))) buffer->pointer_position--;
-    } else if (IsPunct(c)) {
-        while (buffer->pointer_position > 0 && IsPunct(GetCharAt(buffer, buffer->pointer_position - 1))) buffer->pointer_position--;
+    macro->recording = !macro->recording;
+}
+
+// Plays the macro times in a row as one undo step. The line cache only queues the
+// shift of following lines per edit and the pointer cache is revalidated once at the end.
+void PlayMacro(Editor* editor, size_t times) {
+    Macro* macro = &editor->macro;
+    if (macro->recording || macro->count == 0) return;
+
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    BeginEditTransaction(buffer);
+    for (size_t i = 0; i < times; ++i) {
+        for (size_t j = 0; j < macro->count; ++j) {
+            DispatchInputTextMode(editor, macro->actions[j]);
+        }
     }
+    EndEditTransaction(buffer);
 }
 
-void MovePointerAction(Editor* editor, void(*move_function)(TextBuffer* buffer)) {
-    TextBuffer* buffer = GetActiveBuffer(editor); 
-    size_t pointer_before = buffer->pointer_position;
-    move_function(buffer);
-    if (buffer->pointer_position != pointer_before) {
+void PlayMacroAction(Editor* editor) {
+    PlayMacro(editor, 1);
+}
+
+// The command line itself is cleared by ExecuteCommandAction once the whole script ran
+void LeaveCommandMode(Editor* editor) {
+    editor->input_system.current_mode = MODE_TEXT;
+}
+
+bool ParseCommandCount(const char* text, size_t* count) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || *end != '\0') return false;
+    *count = value;
+    return true;
+}
+
+bool GotoCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    PagedFile* paged_file = editor->state.paged_file;
+
+    if (editor->state.hex_view) {
+        TraceLog(LOG_WARNING, "goto: %s is shown as bytes, use offset", editor->state.hex_view->path);
+        return false;
+    }
+
+    size_t line;
+    if (paged_file) {
+        // The viewer may not know the line count yet, lines past the end go to the last one
+        if (!ParseCommandCount(args->args[1], &line) || line == 0) {
+            TraceLog(LOG_WARNING, "goto: line must be a number from 1");
+            return false;
+        }
+        JumpToPagedLine(paged_file, line - 1);
+        LeaveCommandMode(editor);
+        return true;
+    }
+    if (!ParseCommandCount(args->args[1], &line) || line == 0 || line > GetLineCount(buffer)) {
+        TraceLog(LOG_WARNING, "goto: line must be between 1 and %zu", GetLineCount(buffer));
+        return false;
+    }
+
+    buffer->pointer_position = GetLineByIndex(buffer, line - 1).x;
+    buffer->has_selection = false;
+    buffer->request_revalidate_pointer_cache = true;
+    LeaveCommandMode(editor);
+    return true;
+}
+
+// Goes to a byte offset, given in decimal or as 0x hex
+bool OffsetCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    char* end;
+    unsigned long long offset = strtoull(args->args[1], &end, 0);
+    if (end == args->args[1] || *end != '\0') {
+        TraceLog(LOG_WARNING, "offset: not a number: %s", args->args[1]);
+        return false;
+    }
+
+    if (editor->state.paged_file) {
+        JumpToPagedOffset(editor->state.paged_file, offset);
+    } else if (editor->state.hex_view) {
+        JumpToHexOffset(editor->state.hex_view, offset);
+    } else {
+        TextBuffer* buffer = GetActiveBuffer(editor);
+        buffer->pointer_position = min((size_t)offset, GetTextSize(buffer));
         buffer->has_selection = false;
+        buffer->request_revalidate_pointer_cache = true;
     }
+    LeaveCommandMode(editor);
+    return true;
 }
-void MovePointerSelectionAction(Editor* editor, void(*move_function)(TextBuffer* buffer)) {
+
+void RestartSearchCount(Editor* editor) {
     TextBuffer* buffer = GetActiveBuffer(editor);
-    size_t pointer_before = buffer->pointer_position;
-    move_function(buffer);
-    if (pointer_before != buffer->pointer_position) {
-        if (!buffer->has_selection) {
-            buffer->has_selection = true;
-            buffer->selection_start = pointer_before;
-        }
-        buffer->selection_end = buffer->pointer_position;
+    ClearParallelSearch(&editor->search);
+    editor->search_matches.count = 0;
+    editor->search_revision = buffer->revision;
+    StartParallelSearch(&editor->search, buffer, editor->match_index.query, editor->match_index.regex, 0);
+}
+
+// Makes query the highlighted term, searching for the same term again keeps what is known about it
+bool EditorSetSearchTerm(Editor* editor, const char* query, bool regex) {
+    MatchIndex* index = &editor->match_index;
+    if (index->active && index->regex == regex && strcmp(index->query, query) == 0 && editor->search_buffer_index == editor->state.open_text_buffer_index) {
+        return true;
+    }
+
+    ClearMatchIndex(index);
+    if (!InitMatchIndex(index, GetActiveBuffer(editor), query, regex)) {
+        TraceLog(LOG_WARNING, "search: %s", index->error);
+        return false;
     }
+    editor->search_buffer_index = editor->state.open_text_buffer_index;
+    RestartSearchCount(editor);
+    return true;
+}
+
+void EditorClearSearchTerm(Editor* editor) {
+    ClearMatchIndex(&editor->match_index);
+    ClearParallelSearch(&editor->search);
+    editor->search_matches.count = 0;
+}
+
+// Selects the next occurrence after the pointer and stays in command mode,
+// so pressing enter again moves on to the following one
+// The search runs a step per frame in EditorUpdateHexView
+bool EditorStartHexSearch(Editor* editor, const char* bytes, size_t length) {
+    if (!StartHexSearch(editor->state.hex_view, bytes, length)) return false;
+    editor->command_status[0] = '\0';
+    return true;
 }
 
-size_t AppendAddBuffer(TextBuffer* buffer, char* value, size_t len) {
-    while (buffer->add_buffer_count + len >= buffer->add_buffer_capacity) {
-        buffer->add_buffer = (char*)realloc(buffer->add_buffer, buffer->add_buffer_capacity * 2 * sizeof(char));
-        buffer->add_buffer_capacity *= 2;
+bool FindTextCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    if (editor->state.hex_view) {
+        return EditorStartHexSearch(editor, args->args[1], strlen(args->args[1]));
     }
 
-    size_t index = buffer->add_buffer_count;
-    
-    memcpy(&buffer->add_buffer[buffer->add_buffer_count], value, len);
+    LiteralPattern pattern = {0};
+    if (!InitLiteralPattern(&pattern, args->args[1], strlen(args->args[1]))) return false;
 
-    buffer->add_buffer_count += len;
-    
-    return index;
+    Match match;
+    bool found = FindNextLiteral(GetPieceView(buffer), &pattern, buffer->pointer_position, &match);
+    ClearLiteralPattern(&pattern);
+    EditorSetSearchTerm(editor, args->args[1], false);
+    if (!found) {
+        TraceLog(LOG_INFO, "find: no match for %s", args->args[1]);
+        return true;
+    }
+
+    buffer->pointer_position = match.start + match.length;
+    buffer->has_selection = true;
+    buffer->selection_start = match.start + match.length;
+    buffer->selection_end = match.start;
+    return true;
 }
 
-void InsertString(TextBuffer* buffer, size_t position, char* value, size_t len) {
-    // TODO: Use memove and inplace to make this function O(n) for the insertion!
-    size_t new_start = AppendAddBuffer(buffer, value, len);
+// Looks for bytes given in hex, in the byte view only
+bool FindHexCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    if (!editor->state.hex_view) {
+        TraceLog(LOG_WARNING, "findhex: only for files shown as bytes");
+        return false;
+    }
 
-    Piece new_piece = {ADD, new_start, len};
+    char* bytes;
+    size_t length;
+    if (!ParseHexPattern(args->args[1], &bytes, &length)) {
+        TraceLog(LOG_WARNING, "findhex: not pairs of hex digits: %s", args->args[1]);
+        return false;
+    }
+    bool ok = EditorStartHexSearch(editor, bytes, length);
+    free(bytes);
+    return ok;
+}
 
-    Piece* new_pieces = malloc((buffer->piece_count + 2) * sizeof(Piece));
-    size_t new_count = 0; 
-    size_t current_pos = 0;
-    bool inserted = false;
+bool RegexCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
 
-    if (buffer->piece_count == 0) {
-        new_pieces[new_count++] = new_piece;
-        inserted = true;
+    Regex regex;
+    if (!CompileRegex(&regex, args->args[1])) {
+        TraceLog(LOG_WARNING, "regex: %s", regex.error);
+        return false;
     }
 
-    for(size_t i = 0; i < buffer->piece_count; i++) {
-        Piece p = buffer->pieces[i];
-        if (current_pos + p.length < position) {
-            new_pieces[new_count++] = p;
-            current_pos += p.length;
-        } else {
-            size_t offset = position - current_pos;
-            if (offset > 0) {
-                Piece left = p;
-                left.length = offset;
-                new_pieces[new_count++] = left;
-            }
+    // An empty match right at the pointer would keep the pointer in place, look past it
+    Match match;
+    PieceView view = GetPieceView(buffer);
+    bool found = FindNextRegex(&regex, view, buffer->pointer_position, &match);
+    if (found && match.length == 0 && match.start == buffer->pointer_position && match.start < view.text_size) {
+        found = FindNextRegex(&regex, view, buffer->pointer_position + 1, &match);
+    }
+    ClearRegex(&regex);
+    EditorSetSearchTerm(editor, args->args[1], true);
+    if (!found) {
+        TraceLog(LOG_INFO, "regex: no match for %s", args->args[1]);
+        return true;
+    }
 
-            new_pieces[new_count++] = new_piece;
-            inserted = true;
+    buffer->pointer_position = match.start + match.length;
+    buffer->has_selection = match.length > 0;
+    buffer->selection_start = match.start + match.length;
+    buffer->selection_end = match.start;
+    return true;
+}
 
-            if (offset < p.length) {
-                Piece right = p;
-                right.start += offset;
-                right.length -= offset;
-                new_pieces[new_count++] = right;
-            }    
+bool FindAllCommand(void* context, CommandArgs* args) {
+    if (!EditorSetSearchTerm(context, args->args[1], false)) return false;
+    LeaveCommandMode(context);
+    return true;
+}
 
-            for (size_t j = i + 1; j < buffer->piece_count; j++) {
-                new_pieces[new_count++] = buffer->pieces[j];
-            }
-            break;
-        }
+bool RegexAllCommand(void* context, CommandArgs* args) {
+    if (!EditorSetSearchTerm(context, args->args[1], true)) return false;
+    LeaveCommandMode(context);
+    return true;
+}
+
+bool NoHighlightCommand(void* context, CommandArgs* args) {
+    EditorClearSearchTerm(context);
+    LeaveCommandMode(context);
+    return true;
+}
+
+// Pulls in the matches counted since the last frame. A finished count goes into the match
+// index, which then follows edits by rescanning only around the bytes they changed. Edits made
+// while the workers run are caught up with once they are done. Only a change too large to
+// rescan right away, like a replace all, or more edits than the change log holds count the
+// whole text again.
+void EditorUpdateSearch(Editor* editor) {
+    MatchIndex* index = &editor->match_index;
+    if (!index->active) return;
+    if (editor->search_buffer_index != editor->state.open_text_buffer_index) {
+        EditorClearSearchTerm(editor);
+        return;
+    }
+
+    if (editor->search.active) {
+        PollParallelSearch(&editor->search, &editor->search_matches);
+        if (!IsParallelSearchDone(&editor->search)) return;
+        CoverMatchIndex(index, &editor->search_matches, editor->search.snapshot.view.text_size, editor->search_revision);
+        ClearParallelSearch(&editor->search);
+    }
+
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    if (editor->search_revision == buffer->revision) return;
+    SyncMatchIndex(index, buffer);
+    if (GetMatchIndexGaps(index, 0, buffer->text_size + 1) > PARALLEL_SEARCH_RANGE_SIZE) {
+        RestartSearchCount(editor);
+        return;
+    }
+    size_t count;
+    QueryMatchIndex(index, buffer, 0, buffer->text_size, &count);
+    editor->search_revision = buffer->revision;
+}
+
+// Replaces every match in the buffer at once, one undo brings them all back
+bool ReplaceMatchesCommand(Editor* editor, MatchList* matches, const char* name, const char* replacement) {
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    size_t replaced = ReplaceAllMatches(buffer, matches, replacement, strlen(replacement));
+    ClearMatchList(matches);
+
+    TraceLog(LOG_INFO, "%s: replaced %zu matches", name, replaced);
+    LeaveCommandMode(editor);
+    return true;
+}
+
+bool ReplaceCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+
+    LiteralPattern pattern = {0};
+    if (!InitLiteralPattern(&pattern, args->args[1], strlen(args->args[1]))) return false;
+
+    MatchList matches;
+    InitMatchList(&matches);
+    FindAllLiteral(GetPieceView(buffer), &pattern, &matches);
+    ClearLiteralPattern(&pattern);
+    return ReplaceMatchesCommand(editor, &matches, "replace", args->args[2]);
+}
+
+bool RegexReplaceCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+
+    Regex regex;
+    if (!CompileRegex(&regex, args->args[1])) {
+        TraceLog(LOG_WARNING, "regexreplace: %s", regex.error);
+        return false;
     }
 
-    if (!inserted) {
-        new_pieces[new_count++] = new_piece;
+    MatchList matches;
+    InitMatchList(&matches);
+    FindAllRegex(&regex, GetPieceView(buffer), &matches);
+    ClearRegex(&regex);
+    return ReplaceMatchesCommand(editor, &matches, "regexreplace", args->args[2]);
+}
+
+// Follows the query of a find command as it is typed, one slice of the full scan per frame
+void EditorUpdateIncrementalSearch(Editor* editor) {
+    IncrementalSearch* search = &editor->incremental_search;
+    CommandSystem* system = &editor->input_system.command_system;
+    if (editor->input_system.current_mode != MODE_COMMAND) {
+        ResetIncrementalSearch(search);
+        return;
     }
 
-    while (new_count > buffer->piece_capacity) {
-        buffer->piece_capacity = new_count * 2;
-        buffer->pieces = realloc(buffer->pieces, buffer->piece_capacity * sizeof(Piece));
+    ParseCommandArgs(&system->args, system->command_buffer, strlen(system->command_buffer));
+    if (system->args.count != 2 || strcmp(system->args.args[0], "find") != 0) {
+        ResetIncrementalSearch(search);
+        return;
     }
 
-    memcpy(buffer->pieces, new_pieces, sizeof(Piece) * new_count);
-    buffer->piece_count = new_count;
-    free(new_pieces);
-
-    buffer->line_cache.is_valid = false;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    UpdateIncrementalSearch(search, buffer, system->args.args[1], strlen(system->args.args[1]));
+    StepIncrementalSearch(search, buffer, INCREMENTAL_SEARCH_SLICE_SIZE);
 }
 
-bool RemoveCharacter(TextBuffer* buffer, size_t position) {
-    if (position > 0) {
-        Piece* new_pieces = malloc((buffer->piece_count + 1) * sizeof(Piece));
-        int new_count = 0;
-        size_t current_pos = 0;
-
-        position--;
-
-        for (size_t i = 0; i < buffer->piece_count; ++i) {
-            Piece p = buffer->pieces[i];
-
-            if (current_pos + p.length <= position) {
-                new_pieces[new_count++] = p;
-                current_pos += p.length;
-            } else if (position >= current_pos && position < current_pos + p.length) {
-                size_t local_offset = position - current_pos;
+void SearchAction(Editor* editor) {
+    CommandSystem* system = &editor->input_system.command_system;
+    editor->input_system.current_mode = MODE_COMMAND;
+    ClearCommandBuffer(system);
+    CommandSystemInsertString(system, "find \"\"", strlen("find \"\""));
+    MoveCommandPointerLeft(system);
+}
 
-                if (local_offset > 0) {
-                    Piece left = p;
-                    left.length = local_offset;
-                    new_pieces[new_count++] = left;
-                }
+// Saves to the given path, which the buffer then belongs to, or to the buffer's own file
+bool WriteCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    TextBuffer* buffer = GetActiveBuffer(editor);
+    const char* path = args->count > 1 ? args->args[1] : buffer->file_path;
+    if (GetViewedFilePath(&editor->state)) {
+        TraceLog(LOG_WARNING, "write: %s is open read-only", GetViewedFilePath(&editor->state));
+        return false;
+    }
+    if (!path) {
+        TraceLog(LOG_WARNING, "write: buffer has no file, give a path");
+        return false;
+    }
+    if (editor->save.path && editor->save_buffer_index != (size_t)editor->state.open_text_buffer_index) {
+        TraceLog(LOG_WARNING, "write: another buffer is being saved");
+        return false;
+    }
+
+    StartBackgroundSave(&editor->save, buffer, path);
+    editor->save_buffer_index = editor->state.open_text_buffer_index;
+    LeaveCommandMode(editor);
+    return true;
+}
+
+// Follows the running save in the command line and takes the path over once a save is done
+void EditorUpdateSave(Editor* editor) {
+    BackgroundSave* save = &editor->save;
+    TextBuffer* buffer = &editor->state.text_buffers[editor->save_buffer_index];
+    switch (PollBackgroundSave(save, buffer)) {
+        case SAVE_IDLE:
+            return;
+        case SAVE_RUNNING: {
+            size_t total = max(save->snapshot.view.text_size, (size_t)1);
+            snprintf(editor->command_status, sizeof(editor->command_status), "saving %s %zu%%", save->path, GetBackgroundSaveProgress(save) * 100 / total);
+            return;
+        }
+        case SAVE_FINISHED:
+            if (!buffer->file_path || strcmp(buffer->file_path, save->saved_path) != 0) {
+                free(buffer->file_path);
+                buffer->file_path = strdup(save->saved_path);
+            }
+            WatchFile(&editor->watcher, editor->save_buffer_index, buffer, save->saved_revision);
+            if (buffer->journal) {
+                RebaseEditJournal(buffer->journal, buffer, save->saved_revision);
+            } else if (!editor->headless) {
+                size_t recovered;
+                buffer->journal = OpenEditJournal(buffer, save->saved_revision, &recovered);
+            }
+            snprintf(editor->command_status, sizeof(editor->command_status), "written %zu bytes to %s", GetBackgroundSaveProgress(save), save->saved_path);
+            break;
+        case SAVE_FAILED:
+            snprintf(editor->command_status, sizeof(editor->command_status), "could not save %s", save->saved_path);
+            break;
+    }
+    TraceLog(LOG_INFO, "write: %s", editor->command_status);
+}
 
-                if (local_offset + 1 < p.length) {
-                    Piece right = p;
-                    right.start += local_offset + 1;
-                    right.length -= local_offset + 1;
-                    new_pieces[new_count++] = right;
-                }
+// Journals the edits to the buffers from first on, bringing back the ones a crash lost first.
+// Buffers without a file get their journal once they are saved.
+void EditorOpenJournals(Editor* editor, size_t first) {
+    if (editor->headless) return;
 
-                current_pos += p.length;
-            } else {
-                new_pieces[new_count++] = p;
-                current_pos += p.length;
-            }
-        }
+    size_t recovered_files = 0;
+    size_t recovered_total = 0;
+    for (size_t i = first; i < editor->state.text_buffers_count; ++i) {
+        TextBuffer* buffer = &editor->state.text_buffers[i];
+        if (buffer->journal || !buffer->file_path) continue;
 
-        while (new_count > buffer->piece_capacity) {
-            buffer->piece_capacity = new_count * 2;
-            buffer->pieces = realloc(buffer->pieces, buffer->piece_capacity * sizeof(Piece));
+        size_t recovered;
+        buffer->journal = OpenEditJournal(buffer, buffer->revision, &recovered);
+        if (recovered > 0) {
+            snprintf(editor->command_status, sizeof(editor->command_status), "recovered %zu edits to %s", recovered, buffer->file_path);
+            TraceLog(LOG_INFO, "journal: %s", editor->command_status);
+            recovered_files++;
+            recovered_total += recovered;
         }
-        memcpy(buffer->pieces, new_pieces, sizeof(Piece) * new_count);
-        buffer->piece_count = new_count;
-        buffer->line_cache.is_valid = false;
-        return true;
     }
-    return false;
+    // Each file was logged on its own, the command line only has room for the sum
+    if (recovered_files > 1) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "recovered %zu edits to %zu files", recovered_total, recovered_files);
+    }
 }
 
-void ExecuteDelete(TextBuffer* buffer, size_t position, size_t length) {
-    for (size_t i = 0; i < length; ++i) {
-        RemoveCharacter(buffer, position + 1);
+void EditorWatchFiles(Editor* editor) {
+    for (size_t i = 0; i < editor->state.text_buffers_count; ++i) {
+        TextBuffer* buffer = &editor->state.text_buffers[i];
+        WatchFile(&editor->watcher, i, buffer, buffer->revision);
     }
-    buffer->pointer_position = position;
 }
 
-void RemoveArea(TextBuffer* buffer, size_t position, size_t length) {
-    char* deleted_text = GetTextRange(buffer, position, position + length);
-    PushCommand(buffer, EDIT_DELETE, position, deleted_text, length);
-    free(deleted_text);
+// Brings a buffer in line with its file by editing only what differs, one undo step away
+bool EditorReloadBuffer(Editor* editor, size_t index) {
+    TextBuffer* buffer = &editor->state.text_buffers[index];
+    FileWatch* watch = FindFileWatch(&editor->watcher, index);
+    if (!watch) {
+        watch = WatchFile(&editor->watcher, index, buffer, buffer->revision);
+    }
 
-    ExecuteDelete(buffer, position, length);
-}
+    FileReload reload;
+    if (!watch || !ReloadTextBuffer(buffer, watch, &reload)) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "could not reload %s", buffer->file_path ? buffer->file_path : "buffer");
+        TraceLog(LOG_WARNING, "reload: %s", editor->command_status);
+        return false;
+    }
 
-void RemoveSelection(TextBuffer* buffer) {
-    size_t selection_length = abs((int)(buffer->selection_end) - (int)(buffer->selection_start));
-    RemoveArea(buffer, min(buffer->selection_start, buffer->selection_end), selection_length);
-    buffer->has_selection = false;
+    // The file now holds the whole text, the journal starts over from it
+    if (buffer->journal) {
+        RebaseEditJournal(buffer->journal, buffer, buffer->revision);
+    }
+    if (reload.appended) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "%s grew by %zu bytes", watch->path, reload.inserted);
+    } else {
+        snprintf(editor->command_status, sizeof(editor->command_status), "reloaded %s, %zu changes, +%zu -%zu bytes", watch->path, reload.hunks, reload.inserted, reload.removed);
+    }
+    TraceLog(LOG_INFO, "reload: %s", editor->command_status);
+    return true;
 }
 
-void InsertStringAction(Editor* editor, char* value, size_t len) {
-    TextBuffer* buffer = GetActiveBuffer(editor);
-    if (buffer->has_selection) {
-        RemoveSelection(buffer);
+// Takes in what was appended to a followed file, keeping the view on the end if it was there
+void EditorFollowFile(Editor* editor, FileWatch* watch) {
+    TextBuffer* buffer = &editor->state.text_buffers[watch->buffer_index];
+    bool at_end = buffer->pointer_position == buffer->text_size;
+    FileReload reload;
+    if (!FollowFile(watch, buffer, &reload)) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "could not follow %s", watch->path);
+        TraceLog(LOG_WARNING, "tail: %s", editor->command_status);
+        watch->follow = false;
+        return;
     }
-    double current_time = GetTime();
-    if (!TryToMergeCharacterInsert(buffer, value, len, current_time)) {
-        char* text = malloc(len + 1);
-        memcpy(text, value, len);
-        text[len] = '\0';
-        PushCommand(buffer, EDIT_INSERT, buffer->pointer_position, text, len);
-        free(text);
+
+    if (at_end) {
+        buffer->pointer_position = buffer->text_size;
+        buffer->has_selection = false;
     }
-    InsertString(buffer, buffer->pointer_position, value, len);
-    buffer->pointer_position += len;
-    buffer->time_since_last_edit = current_time;
 }
 
-void RemoveBackwardsAction(Editor* editor) {
-    TextBuffer* buffer = GetActiveBuffer(editor);
-    if (buffer->has_selection) {
-        RemoveSelection(buffer);
-    } else {
-        if (buffer->pointer_position == 0) return;
+// A followed buffer without edits of its own holds what its file does. Appends are not
+// journaled, but the header has to follow the grown file or a crash leaves a stale journal.
+void EditorRebaseFollowedJournals(Editor* editor) {
+    if (GetWallTime() - editor->journal_rebase_time < FOLLOW_JOURNAL_REBASE_INTERVAL) return;
+
+    for (size_t i = 0; i < editor->watcher.count; ++i) {
+        FileWatch* watch = &editor->watcher.watches[i];
+        TextBuffer* buffer = &editor->state.text_buffers[watch->buffer_index];
+        if (watch->follow && buffer->journal && buffer->revision == watch->synced_revision && buffer->journal->base_revision != buffer->revision) {
+            ResetEditJournal(buffer->journal, buffer);
+        }
+    }
+    editor->journal_rebase_time = GetWallTime();
+}
 
-        double current_time = GetTime();
+// Takes in what other programs wrote to the open files. A buffer with edits of its own is
+// left alone and the change only reported, reload takes it in anyway.
+void EditorUpdateFileWatch(Editor* editor) {
+    EditorRebaseFollowedJournals(editor);
+    if (PollFileWatcher(&editor->watcher) == 0) return;
 
-        if (!TryToMergeCharacterRemove(buffer, current_time)) {
-            char deleted_char = GetCharAt(buffer, buffer->pointer_position - 1);
-            PushCommand(buffer, EDIT_DELETE, buffer->pointer_position - 1, &deleted_char, 1);
+    for (size_t i = 0; i < editor->watcher.count; ++i) {
+        FileWatch* watch = &editor->watcher.watches[i];
+        // Our own save shows up as a change too, it is known to be ours once it is done
+        if (!watch->changed || (editor->save.path && editor->save_buffer_index == watch->buffer_index)) continue;
+        watch->changed = false;
+        if (watch->follow) {
+            EditorFollowFile(editor, watch);
+            continue;
         }
+        if (!HasFileChanged(watch)) continue;
 
-        if (RemoveCharacter(buffer, buffer->pointer_position)) {
-            buffer->pointer_position--;
+        TextBuffer* buffer = &editor->state.text_buffers[watch->buffer_index];
+        if (buffer->revision != watch->synced_revision) {
+            snprintf(editor->command_status, sizeof(editor->command_status), "%s changed on disk, reload to take it in", watch->path);
+            TraceLog(LOG_WARNING, "watch: %s", editor->command_status);
+        } else {
+            EditorReloadBuffer(editor, watch->buffer_index);
         }
-        buffer->time_since_last_edit = current_time;
     }
 }
 
-void InsertNewLineAction(Editor* editor) {
-    char new_line_buffer[1];
-    new_line_buffer[0] = '\n';
-    InsertStringAction(editor, new_line_buffer, 1);
+void EditorUpdatePagedFile(Editor* editor) {
+    if (editor->state.paged_file) {
+        UpdatePagedFile(editor->state.paged_file);
+    }
 }
 
-void InsertTabAction(Editor* editor) {
-    char tab_buffer[2];
-    tab_buffer[0] = ' ';
-    tab_buffer[1] = ' ';
-    InsertStringAction(editor, tab_buffer, 2);
+void EditorUpdateFileCache(Editor* editor) {
+    if (editor->state.file_cache) {
+        UpdateFileCache(editor->state.file_cache, GetWallTime());
+    }
 }
 
-void UndoAction(Editor* editor) {
-    TextBuffer* buffer = GetActiveBuffer(editor);
-    UndoStack* stack = &buffer->undo_stack;
-    if (stack->current == 0) return;
+void EditorUpdateHexView(Editor* editor) {
+    HexView* view = editor->state.hex_view;
+    if (!view) return;
 
-    stack->current--;
-    EditEntry* entry = &stack->entries[stack->current];
+    UpdateHexView(view);
+    HexSearchResult result = UpdateHexSearch(view, HEX_SEARCH_STEP);
+    if (result == HEX_SEARCH_FOUND) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "found at 0x%llx", (unsigned long long)view->cursor);
+    } else if (result == HEX_SEARCH_NOT_FOUND) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "no match in %s", view->path);
+        TraceLog(LOG_INFO, "find: %s", editor->command_status);
+    }
+}
 
-    switch (entry->type) 
-    {
-        case EDIT_INSERT:
-            ExecuteDelete(buffer, entry->position, entry->length);        
-            break;
-        case EDIT_DELETE:
-            InsertString(buffer, entry->position, entry->text, entry->length);
-            break;
+bool ReloadCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    if (!GetActiveBuffer(editor)->file_path) {
+        TraceLog(LOG_WARNING, "reload: buffer has no file");
+        return false;
     }
 
-    buffer->pointer_position = entry->cursor_before;
-    buffer->line_cache.is_valid = false;
+    bool ok = EditorReloadBuffer(editor, editor->state.open_text_buffer_index);
+    LeaveCommandMode(editor);
+    return ok;
 }
 
-void RedoAction(Editor* editor) {
+// Follows the file of the buffer as it grows, or stops following it
+bool TailCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    size_t index = editor->state.open_text_buffer_index;
     TextBuffer* buffer = GetActiveBuffer(editor);
-    UndoStack* stack = &buffer->undo_stack;
-    if (stack->current >= stack->count) return;
-    
-    EditEntry* entry = &stack->entries[stack->current];
-    
-    switch (entry->type) {
-        case EDIT_INSERT: {
-            InsertString(buffer, entry->position, entry->text, entry->length);
-            break;
-        }
-        case EDIT_DELETE: {
-            ExecuteDelete(buffer, entry->position, entry->length);
-            break;
+    FileWatch* watch = FindFileWatch(&editor->watcher, index);
+    if (!watch) {
+        watch = WatchFile(&editor->watcher, index, buffer, buffer->revision);
+    }
+    if (!watch) {
+        TraceLog(LOG_WARNING, "tail: buffer has no file");
+        return false;
+    }
+
+    watch->follow = !watch->follow;
+    if (watch->follow) {
+        // Catches up on what was written since the last look and jumps to the end
+        buffer->pointer_position = buffer->text_size;
+        EditorFollowFile(editor, watch);
+    }
+    snprintf(editor->command_status, sizeof(editor->command_status), "%s %s", watch->follow ? "following" : "stopped following", watch->path);
+    LeaveCommandMode(editor);
+    return true;
+}
+
+bool OpenCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    if (GetViewedFilePath(&editor->state)) {
+        TraceLog(LOG_WARNING, "open: not while viewing %s", GetViewedFilePath(&editor->state));
+        return false;
+    }
+
+    size_t first = editor->state.text_buffers_count;
+    size_t opened = OpenFilesFromPaths(&editor->state, args->args + 1, args->count - 1);
+    if (opened == 0) return false;
+    for (size_t i = first; i < editor->state.text_buffers_count; ++i) {
+        WatchFile(&editor->watcher, i, &editor->state.text_buffers[i], editor->state.text_buffers[i].revision);
+    }
+    snprintf(editor->command_status, sizeof(editor->command_status), "opened %zu files", opened);
+    EditorOpenJournals(editor, first);
+    LeaveCommandMode(editor);
+    return true;
+}
+
+// Shows buffer N, or without N says which one is shown
+bool BufferCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    size_t count = editor->state.text_buffers_count;
+    if (args->count > 1) {
+        size_t index;
+        if (!ParseCommandCount(args->args[1], &index) || index == 0 || index > count) {
+            TraceLog(LOG_WARNING, "buffer: must be between 1 and %zu", count);
+            return false;
         }
+        editor->state.open_text_buffer_index = index - 1;
     }
-    
-    buffer->pointer_position = entry->cursor_after;
-    stack->current++;
-    buffer->line_cache.is_valid = false;
-}
 
-void PasteAction(Editor* editor) {
     TextBuffer* buffer = GetActiveBuffer(editor);
-    const char* clipboard_text = GetClipboardText();
-    if (clipboard_text == NULL || clipboard_text[0] == '\0') {
-        return;
+    snprintf(editor->command_status, sizeof(editor->command_status), "buffer %d of %zu: %s", editor->state.open_text_buffer_index + 1, count, buffer->file_path ? buffer->file_path : "[no file]");
+    LeaveCommandMode(editor);
+    return true;
+}
+
+// Reports what the last walk of the opened directory found
+bool FilesCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    if (!editor->state.file_cache) {
+        TraceLog(LOG_WARNING, "files: no directory is open");
+        return false;
     }
 
-    if (buffer->has_selection) {
-        RemoveSelection(buffer);
+    FileTree* tree = GetFileTree(editor->state.file_cache);
+    if (tree) {
+        snprintf(editor->command_status, sizeof(editor->command_status), "%zu files in %zu directories under %s", tree->file_count, tree->dir_count, editor->state.root_dir);
+    } else {
+        snprintf(editor->command_status, sizeof(editor->command_status), "walking %s", editor->state.root_dir);
+    }
+    LeaveCommandMode(editor);
+    return true;
+}
+
+bool QuitCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    editor->state.exit_requested = true;
+    return true;
+}
+
+bool MacroCommand(void* context, CommandArgs* args) {
+    Editor* editor = context;
+    size_t times = 1;
+    if (args->count > 1 && !ParseCommandCount(args->args[1], &times)) {
+        TraceLog(LOG_WARNING, "macro: invalid count %s", args->args[1]);
+        return false;
+    }
+
+    LeaveCommandMode(editor);
+    PlayMacro(editor, times);
+    return true;
+}
+
+void RegisterEditorCommands(CommandRegistry* registry) {
+    RegisterCommand(registry, "goto", 1, 1, GotoCommand);
+    RegisterCommand(registry, "offset", 1, 1, OffsetCommand);
+    RegisterCommand(registry, "find", 1, 1, FindTextCommand);
+    RegisterCommand(registry, "findhex", 1, 1, FindHexCommand);
+    RegisterCommand(registry, "regex", 1, 1, RegexCommand);
+    RegisterCommand(registry, "re", 1, 1, RegexCommand);
+    RegisterCommand(registry, "findall", 1, 1, FindAllCommand);
+    RegisterCommand(registry, "regexall", 1, 1, RegexAllCommand);
+    RegisterCommand(registry, "nohighlight", 0, 0, NoHighlightCommand);
+    RegisterCommand(registry, "noh", 0, 0, NoHighlightCommand);
+    RegisterCommand(registry, "replace", 2, 2, ReplaceCommand);
+    RegisterCommand(registry, "regexreplace", 2, 2, RegexReplaceCommand);
+    RegisterCommand(registry, "write", 0, 1, WriteCommand);
+    RegisterCommand(registry, "w", 0, 1, WriteCommand);
+    RegisterCommand(registry, "reload", 0, 0, ReloadCommand);
+    RegisterCommand(registry, "tail", 0, 0, TailCommand);
+    RegisterCommand(registry, "open", 1, COMMAND_ARGS_UNLIMITED, OpenCommand);
+    RegisterCommand(registry, "buffer", 0, 1, BufferCommand);
+    RegisterCommand(registry, "b", 0, 1, BufferCommand);
+    RegisterCommand(registry, "files", 0, 0, FilesCommand);
+    RegisterCommand(registry, "quit", 0, 0, QuitCommand);
+    RegisterCommand(registry, "q", 0, 0, QuitCommand);
+    RegisterCommand(registry, "macro", 0, 1, MacroCommand);
+}
+
+void ExecuteCommandAction(Editor* editor) {
+    CommandSystem* system = &editor->input_system.command_system;
+    editor->command_status[0] = '\0';
+    CommandResult result = ExecuteCommandScript(&system->registry, &system->args, editor, system->command_buffer);
+    if (result != COMMAND_OK && result != COMMAND_EMPTY) {
+        TraceLog(LOG_WARNING, "%s: %s", system->args.count ? system->args.args[0] : "", CommandResultToString(result));
     }
-    
-    size_t clipboard_length = strlen(clipboard_text);
-    char* paste_buffer = malloc(clipboard_length + 1);
-    if (paste_buffer == NULL) {
-        return;
+    if (editor->input_system.current_mode != MODE_COMMAND) {
+        ClearCommandBuffer(system);
     }
-    strcpy(paste_buffer, clipboard_text);
-
-    normalize_line_endings(paste_buffer);
-    size_t paste_buffer_length = strlen(paste_buffer);
-
-    PushCommand(buffer, EDIT_INSERT, buffer->pointer_position, paste_buffer, paste_buffer_length);
-
-    InsertString(buffer, buffer->pointer_position, paste_buffer, paste_buffer_length);
-    buffer->pointer_position += paste_buffer_length;
-    
-    free(paste_buffer);
 }
 
-void CopyAction(Editor* editor) {
-    TextBuffer* buffer = GetActiveBuffer(editor);
-    if (!buffer->has_selection) return;
-    size_t selection_length = abs((int)buffer->selection_end - (int)buffer->selection_start);
-    char* selection_buffer = GetTextRange(buffer, min(buffer->selection_start, buffer->selection_end), min(buffer->selection_start, buffer->selection_end) + selection_length);
-
-    SetClipboardText(selection_buffer);
-
-    free(selection_buffer);
+size_t GetPagedPageLines(Editor* editor) {
+    if (editor->settings.font_size == 0) return 1;
+    return max(GetEditorTextFieldSize(editor).size.y / editor->settings.font_size, (size_t)1);
 }
 
-void CutAction(Editor* editor) {
-    TextBuffer* buffer = GetActiveBuffer(editor);
-    if (!buffer->has_selection) return;
-
-    CopyAction(editor);
-    RemoveSelection(buffer);
+// Text mode while a file is open in the viewer, moving around is all there is to do
+void DispatchInputPagedMode(Editor* editor, Action action) {
+    PagedFile* file = editor->state.paged_file;
+    switch (action.type)
+    {
+    case ACTION_CURSOR_UP:
+        ScrollPagedFile(file, -1);
+        break;
+    case ACTION_CURSOR_DOWN:
+        ScrollPagedFile(file, 1);
+        break;
+    case ACTION_PAGE_UP:
+        ScrollPagedFile(file, -(int64_t)GetPagedPageLines(editor));
+        break;
+    case ACTION_PAGE_DOWN:
+        ScrollPagedFile(file, GetPagedPageLines(editor));
+        break;
+    case ACTION_CURSOR_LEFT:
+        file->column -= file->column > 0;
+        break;
+    case ACTION_CURSOR_RIGHT:
+        file->column++;
+        break;
+    case ACTION_CURSOR_WORD_LEFT:
+        file->column -= min(file->column, (size_t)PAGED_COLUMN_STEP);
+        break;
+    case ACTION_CURSOR_WORD_RIGHT:
+        file->column += PAGED_COLUMN_STEP;
+        break;
+    case ACTION_TOGGLE_LATENCY_OVERLAY:
+        ToggleLatencyOverlayAction(editor);
+        break;
+    case ACTION_OPEN_COMMAND_PALETTE:
+        ToggleCommandModeAction(editor);
+        break;
+    default:
+        TraceLog(LOG_INFO, "ActionType: %s is not available in the read-only viewer", ActionTypeToString(action.type));
+    }
 }
 
-void ToggleCommandModeAction(Editor* editor) {
-    if (editor->input_system.current_mode == MODE_COMMAND) {
-        editor->input_system.current_mode = MODE_TEXT;
-    } else {
-        editor->input_system.current_mode = MODE_COMMAND;
+// Text mode while a file is shown as bytes, the cursor moves a byte or a row at a time
+void DispatchInputHexMode(Editor* editor, Action action) {
+    HexView* view = editor->state.hex_view;
+    size_t page_rows = GetPagedPageLines(editor);
+    switch (action.type)
+    {
+    case ACTION_CURSOR_LEFT:
+        MoveHexCursor(view, -1, page_rows);
+        break;
+    case ACTION_CURSOR_RIGHT:
+        MoveHexCursor(view, 1, page_rows);
+        break;
+    case ACTION_CURSOR_UP:
+        MoveHexCursor(view, -HEX_ROW_BYTES, page_rows);
+        break;
+    case ACTION_CURSOR_DOWN:
+        MoveHexCursor(view, HEX_ROW_BYTES, page_rows);
+        break;
+    case ACTION_PAGE_UP:
+        MoveHexCursor(view, -(int64_t)(page_rows * HEX_ROW_BYTES), page_rows);
+        break;
+    case ACTION_PAGE_DOWN:
+        MoveHexCursor(view, page_rows * HEX_ROW_BYTES, page_rows);
+        break;
+    case ACTION_TOGGLE_LATENCY_OVERLAY:
+        ToggleLatencyOverlayAction(editor);
+        break;
+    case ACTION_OPEN_COMMAND_PALETTE:
+        ToggleCommandModeAction(editor);
+        break;
+    default:
+        TraceLog(LOG_INFO, "ActionType: %s is not available in the byte view", ActionTypeToString(action.type));
     }
 }
 
 void DispatchInputTextMode(Editor* editor, Action action){
+    if (editor->state.paged_file) {
+        DispatchInputPagedMode(editor, action);
+        return;
+    }
+    if (editor->state.hex_view) {
+        DispatchInputHexMode(editor, action);
+        return;
+    }
+    if (editor->macro.recording && IsMacroRecordable(action.type)) {
+        MacroAppendAction(&editor->macro, action);
+    }
+
     switch (action.type)
     {
     case ACTION_CURSOR_LEFT:
@@ -1505,8 +1910,21 @@ void DispatchInputTextMode(Editor* editor, Action action){
     case ACTION_CUT:
         CutAction(editor);
         break;
+    case ACTION_TOGGLE_LATENCY_OVERLAY:
+        ToggleLatencyOverlayAction(editor);
+        break;
+    case ACTION_MACRO_RECORD:
+        ToggleMacroRecordingAction(editor);
+        break;
+    case ACTION_MACRO_PLAY:
+        PlayMacroAction(editor);
+        break;
     case ACTION_OPEN_COMMAND_PALETTE:
         ToggleCommandModeAction(editor);
+        break;
+    case ACTION_SEARCH:
+        SearchAction(editor);
+        break;
     default:
         TraceLog(LOG_INFO, "ActionType: %s is not implemented for Text Mode", ActionTypeToString(action.type));
     }
@@ -1531,27 +1949,99 @@ void DispatchInputCommandMode(Editor* editor, Action action) {
         CommandSystemBackspace(&editor->input_system.command_system);
         break;
     case ACTION_EXECUTE_COMMAND:
+        ExecuteCommandAction(editor);
         break;
     case ACTION_INSERT_CHAR:
         CommandSystemInsertString(&editor->input_system.command_system, action.text_buffer, action.length);
         break;
+    case ACTION_TOGGLE_LATENCY_OVERLAY:
+        ToggleLatencyOverlayAction(editor);
+        break;
     default:
         TraceLog(LOG_INFO, "ActionType: %s is not implemented for Command Mode", ActionTypeToString(action.type));
     }
 }
 
+void EditorDispatchAction(Editor* editor, Action action) {
+    if (editor->input_system.current_mode == MODE_TEXT) {
+        DispatchInputTextMode(editor, action);
+    } else if (editor->input_system.current_mode == MODE_COMMAND) {
+        DispatchInputCommandMode(editor, action);
+    }
+}
+
 void EditorHandleInput(Editor* editor) {
     Action action = InputSystemPoll(&editor->input_system);
 
     while (action.type != ACTION_NONE) {
-        if (editor->input_system.current_mode == MODE_TEXT) {
-            DispatchInputTextMode(editor, action);
-        } else if (editor->input_system.current_mode == MODE_COMMAND) {
-            DispatchInputCommandMode(editor, action);
+        LatencyMarkInput(&editor->latency, action.timestamp);
+        if (editor->recorder.file) {
+            const char* payload = action.text_buffer;
+            size_t payload_length = action.length;
+            if (action.type == ACTION_PASTE) {
+                payload = GetClipboardText();
+                payload_length = payload ? strlen(payload) : 0;
+            }
+            RecordAction(&editor->recorder, &action, payload, payload_length);
         }
+
+        editor->current_time = action.timestamp;
+        EditorDispatchAction(editor, action);
         ClearAction(&action);
         action = InputSystemPoll(&editor->input_system);
     }
+    editor->recorder.frame++;
+    LatencyMarkDispatch(&editor->latency);
+}
+
+int ReplayInputRecording(const char* recording_path, char* path) {
+    FILE* f = fopen(recording_path, "rb");
+    if (!f) {
+        fprintf(stderr, "Could not open file: %s\n", recording_path);
+        return 1;
+    }
+    if (!ReadRecordingHeader(f)) {
+        fprintf(stderr, "Not an input recording: %s\n", recording_path);
+        fclose(f);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    EditorSettings settings = {0};
+    Editor editor = CreateEditor(settings, path ? &path : NULL, path ? 1 : 0);
+    editor.headless = true;
+
+    RecordedAction recorded = {0};
+    size_t action_count = 0;
+    uint32_t frame_count = 0;
+    double start = GetWallTime();
+
+    while (!ShouldEditorClose(&editor) && ReadRecordedAction(f, &recorded)) {
+        Action action = { .type = recorded.type, .timestamp = recorded.timestamp };
+        if (recorded.type == ACTION_PASTE) {
+            EditorSetClipboardText(&editor, recorded.payload ? recorded.payload : "");
+        } else if (recorded.payload_length > 0) {
+            action.length = min(recorded.payload_length, (size_t)ACTION_TEXT_BUFFER_CAPACITY);
+            memcpy(action.text_buffer, recorded.payload, action.length);
+        }
+
+        editor.current_time = action.timestamp;
+        EditorDispatchAction(&editor, action);
+        action_count++;
+        frame_count = recorded.frame + 1;
+    }
+
+    double elapsed = GetWallTime() - start;
+    TextBuffer* buffer = GetActiveBuffer(&editor);
+    printf("replayed %zu actions over %u frames in %.3f ms (%.0f actions/s)\n",
+        action_count, frame_count, elapsed * 1000.0, elapsed > 0 ? action_count / elapsed : 0.0);
+    printf("text size %zu, pieces %zu, undo entries %zu, hash %016llx\n",
+        GetTextSize(buffer), buffer->piece_count, buffer->undo_stack.count, (unsigned long long)HashTextBuffer(buffer));
+
+    free(recorded.payload);
+    fclose(f);
+    ClearEditor(&editor);
+    return 0;
 }
 
 size_t GetPointerOffsetFromLeft(Editor* editor, TextBuffer* buffer, Position pointer) {
@@ -1670,7 +2160,8 @@ void EditorRenderCommand(Editor* editor) {
     DrawTextEx(editor->settings.editor_font, ":", (Vector2){offset.x, offset.y}, editor->settings.font_size, 1, editor->settings.scheme.command_color); 
     Vector2 offset_prefix = MeasureTextEx(editor->settings.editor_font, ":", editor->settings.font_size, 1); 
     if (editor->input_system.current_mode != MODE_COMMAND) {
-        DrawTextEx(editor->settings.editor_font, editor->input_system.command_system.command_buffer, (Vector2){offset.x + offset_prefix.x, offset.y}, editor->settings.font_size, 1, editor->settings.scheme.command_color);    
+        const char* text = editor->command_status[0] ? editor->command_status : editor->input_system.command_system.command_buffer;
+        DrawTextEx(editor->settings.editor_font, text, (Vector2){offset.x + offset_prefix.x, offset.y}, editor->settings.font_size, 1, editor->settings.scheme.command_color);    
     } else {
         char* temp;
         temp = calloc(editor->input_system.command_system.pointer_position + 1, sizeof(char));
@@ -1684,6 +2175,92 @@ void EditorRenderCommand(Editor* editor) {
     }
 }
 
+float MeasureLinePrefix(Editor* editor, char* line, size_t length) {
+    char saved = line[length];
+    line[length] = '\0';
+    float width = MeasureTextEx(editor->settings.editor_font, line, editor->settings.font_size, 1).x;
+    line[length] = saved;
+    return width;
+}
+
+// The matches to draw over the visible lines. While typing a search the full scan may not
+// have reached the view yet, the visible lines are then searched on their own so the
+// highlights follow every keystroke. Otherwise the index of the search term is asked for
+// the lines around the view.
+MatchList GetHighlightedMatches(Editor* editor, TextBuffer* buffer, size_t first_line, size_t last_line) {
+    if (first_line >= last_line) return (MatchList){0};
+    size_t view_start = GetLineByIndex(buffer, first_line).x;
+    Position last = GetLineByIndex(buffer, last_line - 1);
+    size_t view_end = last.x + last.y;
+
+    IncrementalSearch* search = &editor->incremental_search;
+    const IncrementalSearchStep* step = GetIncrementalSearchStep(search);
+    if (step) {
+        if (step->scanned_to >= view_end) return step->matches;
+
+        editor->visible_matches.count = 0;
+        SearchLiteral(GetPieceView(buffer), &search->pattern, view_start, view_end, MatchListCollect, &editor->visible_matches);
+        return editor->visible_matches;
+    }
+
+    if (!editor->match_index.active || editor->search_buffer_index != editor->state.open_text_buffer_index) return (MatchList){0};
+
+    // A screen above and below is indexed along with the view, so scrolling rarely has to scan
+    size_t view_size = view_end - view_start;
+    size_t count;
+    const Match* matches = QueryMatchIndex(&editor->match_index, buffer, view_start > view_size ? view_start - view_size : 0, view_end + view_size, &count);
+    // Only read while drawing, the items stay owned by the index
+    return (MatchList){ (Match*)matches, count, count };
+}
+
+// Draws the match backgrounds of the visible lines, matches are sorted so only the slice
+// overlapping the view is walked
+void RenderSearchMatches(Editor* editor, TextBuffer* buffer, const MatchList* matches, Rect render_field, Position pointer, size_t first_line, size_t last_line) {
+    if (matches->count == 0 || first_line >= last_line) return;
+
+    size_t view_start = GetLineByIndex(buffer, first_line).x;
+    size_t low = 0;
+    size_t high = matches->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (matches->items[mid].start + max(matches->items[mid].length, (size_t)1) <= view_start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    size_t pointer_gap = editor->settings.pointer_padding.x * 2 + editor->settings.pointer_width;
+    for (size_t line = first_line; line < last_line; ++line) {
+        Position line_position = GetLineByIndex(buffer, line);
+        size_t line_start = line_position.x;
+        size_t line_end = line_start + line_position.y;
+        while (low < matches->count && matches->items[low].start + max(matches->items[low].length, (size_t)1) <= line_start) {
+            low++;
+        }
+
+        char* text = NULL;
+        for (size_t i = low; i < matches->count && matches->items[i].start <= line_end; ++i) {
+            Match match = matches->items[i];
+            size_t from = max(match.start, line_start) - line_start;
+            size_t to = min(match.start + match.length, line_end) - line_start;
+            if (!text) {
+                text = GenerateLine(buffer, line);
+            }
+
+            float x_from = MeasureLinePrefix(editor, text, from);
+            float x_to = MeasureLinePrefix(editor, text, max(from, to));
+            // Text behind the pointer is drawn shifted by the pointer
+            if (line == pointer.y) {
+                if (from >= pointer.x) x_from += pointer_gap;
+                if (to > pointer.x) x_to += pointer_gap;
+            }
+            DrawRectangle(render_field.position.x - buffer->offset_x + x_from, render_field.position.y + (line - first_line) * editor->settings.font_size, max(x_to - x_from, 2.0f), editor->settings.font_size, editor->settings.scheme.match_color);
+        }
+        free(text);
+    }
+}
+
 void EditorRenderTextBuffer(Editor* editor, Rect render_field) {
     TextBuffer* buffer = &editor->state.text_buffers[editor->state.open_text_buffer_index]; 
     Position pointer = GetPointerPosition(buffer);
@@ -1714,6 +2291,10 @@ void EditorRenderTextBuffer(Editor* editor, Rect render_field) {
         buffer->offset_x = pointer_offset;
     }
 
+    size_t last_line = min(buffer->line_anchor + lines_completly_rendered + 1, line_count);
+    MatchList matches = GetHighlightedMatches(editor, buffer, buffer->line_anchor, last_line);
+    RenderSearchMatches(editor, buffer, &matches, render_field, pointer, buffer->line_anchor, last_line);
+
     size_t line_y = 0;
     for (size_t i = buffer->line_anchor; i < min(buffer->line_anchor + lines_completly_rendered + 1, line_count); ++i) {    
         RenderLine(editor, buffer, i, (Position){render_field.position.x-buffer->offset_x, render_field.position.y + line_y * editor->settings.font_size}, i, pointer, selection_start_position, selection_end_position);
@@ -1722,6 +2303,71 @@ void EditorRenderTextBuffer(Editor* editor, Rect render_field) {
     EndScissorMode();
 }
 
+// The lines of the viewer from the top one on. A line number the index has not confirmed yet
+// is marked with a ~.
+void EditorRenderPagedFile(Editor* editor, Rect render_field) {
+    PagedFile* file = editor->state.paged_file;
+    size_t lines_completly_rendered = render_field.size.y / editor->settings.font_size;
+    const char* prefix = file->top_line_exact ? "" : "~";
+    char number_str[32];
+    char line[PAGED_LINE_DISPLAY_LENGTH + 1];
+
+    snprintf(number_str, sizeof(number_str), "%s%llu", prefix, (unsigned long long)(file->top_line + lines_completly_rendered + 1));
+    size_t max_offset = MeasureTextEx(editor->settings.editor_font, number_str, editor->settings.font_size, 1).x + editor->settings.number_padding * 2;
+
+    BeginScissorMode(BREAK_DOWN_RECT(render_field));
+    uint64_t offset = file->top;
+    for (size_t i = 0; i <= lines_completly_rendered && (i == 0 || offset < file->size); ++i) {
+        float y = render_field.position.y + i * editor->settings.font_size;
+        snprintf(number_str, sizeof(number_str), "%s%llu", prefix, (unsigned long long)(file->top_line + i + 1));
+        Vector2 measured_text = MeasureTextEx(editor->settings.editor_font, number_str, editor->settings.font_size, 1);
+        DrawTextEx(editor->settings.editor_font, number_str, (Vector2){render_field.position.x + max_offset - editor->settings.number_padding - measured_text.x, y}, editor->settings.font_size, 1, editor->settings.scheme.line_number_color);
+
+        uint64_t next;
+        ReadPagedLine(file, offset, file->column, line, sizeof(line), &next);
+        DrawTextEx(editor->settings.editor_font, line, (Vector2){render_field.position.x + max_offset, y}, editor->settings.font_size, 1, editor->settings.scheme.text_color);
+        offset = next;
+    }
+    EndScissorMode();
+}
+
+static float MeasureHexRowPrefix(Editor* editor, char* row, size_t column) {
+    char saved = row[column];
+    row[column] = '\0';
+    float width = MeasureTextEx(editor->settings.editor_font, row, editor->settings.font_size, 1).x;
+    row[column] = saved;
+    return width;
+}
+
+// Rows of the byte view from the top one on, with the cursor or the match it is on marked
+// in both the hex and the text column
+void EditorRenderHexView(Editor* editor, Rect render_field) {
+    HexView* view = editor->state.hex_view;
+    size_t lines_completly_rendered = render_field.size.y / editor->settings.font_size;
+    uint64_t mark_end = view->cursor + max(view->match_length, (size_t)1);
+    char row[HEX_ROW_LENGTH + 1];
+
+    BeginScissorMode(BREAK_DOWN_RECT(render_field));
+    for (size_t i = 0; i <= lines_completly_rendered; ++i) {
+        uint64_t offset = view->top + i * HEX_ROW_BYTES;
+        if (offset >= view->size && i > 0) break;
+        float y = render_field.position.y + i * editor->settings.font_size;
+        size_t count = FormatHexRow(view, offset, row, sizeof(row));
+
+        for (size_t byte = 0; byte < count && view->size > 0; ++byte) {
+            if (offset + byte < view->cursor || offset + byte >= mark_end) continue;
+            size_t hex_column = GetHexByteColumn(view, byte, false);
+            size_t text_column = GetHexByteColumn(view, byte, true);
+            float hex_x = MeasureHexRowPrefix(editor, row, hex_column);
+            float text_x = MeasureHexRowPrefix(editor, row, text_column);
+            DrawRectangle(render_field.position.x + hex_x, y, MeasureHexRowPrefix(editor, row, hex_column + 2) - hex_x, editor->settings.font_size, editor->settings.scheme.match_color);
+            DrawRectangle(render_field.position.x + text_x, y, MeasureHexRowPrefix(editor, row, text_column + 1) - text_x, editor->settings.font_size, editor->settings.scheme.match_color);
+        }
+        DrawTextEx(editor->settings.editor_font, row, (Vector2){render_field.position.x, y}, editor->settings.font_size, 1, editor->settings.scheme.text_color);
+    }
+    EndScissorMode();
+}
+
 void EditorRenderTextField(Editor* editor, Rect render_field) {
     TextBuffer* buffer = &editor->state.text_buffers[editor->state.open_text_buffer_index]; 
     Position pointer = GetPointerPosition(buffer);
@@ -1760,21 +2406,109 @@ void EditorRenderTextField(Editor* editor, Rect render_field) {
     free(number_str);
 }
 
+// "match k of N" for the last match starting before the pointer. The count arrives in text
+// order, so k is settled as soon as a match past the pointer came in, N once all of them did.
+void FormatSearchStatus(Editor* editor, const char* mode, char* status, size_t size) {
+    MatchList* matches = editor->search.active ? &editor->search_matches : &editor->match_index.matches;
+    size_t pointer = GetActiveBuffer(editor)->pointer_position;
+    bool counted = !editor->search.active && editor->search_revision == GetActiveBuffer(editor)->revision;
+
+    size_t low = 0;
+    size_t high = matches->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (matches->items[mid].start < pointer) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    bool position_known = counted || low < matches->count;
+    if (!position_known || low == 0) {
+        snprintf(status, size, "%s - %zu%s matches", mode, matches->count, counted ? "" : "+");
+    } else {
+        snprintf(status, size, "%s - match %zu of %zu%s", mode, low, matches->count, counted ? "" : "+");
+    }
+}
+
 void EditorRenderMode(Editor* editor) {
     char* mode;
     if (editor->input_system.current_mode == MODE_COMMAND) {
         mode = "Command Mode";
+    } else if (editor->state.paged_file) {
+        mode = "View";
+    } else if (editor->state.hex_view) {
+        mode = "Hex";
     } else {
         mode = "Text Mode";
     }
+
+    char status[96];
+    const IncrementalSearchStep* step = GetIncrementalSearchStep(&editor->incremental_search);
+    if (step) {
+        // The count keeps growing while the scan is still running
+        bool complete = IsIncrementalSearchComplete(&editor->incremental_search, GetActiveBuffer(editor));
+        snprintf(status, sizeof(status), "%s - %zu%s matches", mode, step->matches.count, complete ? "" : "+");
+        mode = status;
+    } else if (editor->match_index.active) {
+        FormatSearchStatus(editor, mode, status, sizeof(status));
+        mode = status;
+    } else if (editor->state.paged_file) {
+        uint64_t line_count;
+        double progress = GetPagedIndexProgress(editor->state.paged_file, &line_count);
+        if (progress < 1.0) {
+            snprintf(status, sizeof(status), "%s - indexing %.0f%%, %llu lines so far", mode, progress * 100.0, (unsigned long long)line_count);
+        } else {
+            snprintf(status, sizeof(status), "%s - %llu lines", mode, (unsigned long long)line_count);
+        }
+        mode = status;
+    } else if (editor->state.hex_view) {
+        HexView* view = editor->state.hex_view;
+        if (view->searching) {
+            snprintf(status, sizeof(status), "%s - searching %.0f%%", mode, GetHexSearchProgress(view) * 100.0);
+        } else {
+            snprintf(status, sizeof(status), "%s - 0x%llx of %llu bytes", mode, (unsigned long long)view->cursor, (unsigned long long)view->size);
+        }
+        mode = status;
+    }
     DrawTextEx(editor->settings.editor_font, mode, PositionToVector(editor->settings.mode_padding), editor->settings.font_size, 1, editor->settings.scheme.mode_color);
 }
 
+void EditorRenderLatencyOverlay(Editor* editor) {
+    LatencyTracker* tracker = &editor->latency;
+    UpdateLatencyStats(tracker);
+
+    char line[128];
+    size_t line_count = LATENCY_STAGE_COUNT + 1;
+    Vector2 line_size = MeasureTextEx(editor->settings.editor_font, "present p50 000.00 p95 000.00 p99 000.00 ms", editor->settings.font_size, 1);
+    Position offset = (Position){GetScreenWidth() - line_size.x - editor->settings.mode_padding.x, editor->settings.mode_padding.y};
+
+    DrawRectangle(offset.x - editor->settings.mode_padding.x, offset.y, line_size.x + editor->settings.mode_padding.x * 2, line_count * editor->settings.font_size, editor->settings.scheme.background_color);
+
+    snprintf(line, sizeof(line), "input latency, %zu samples", GetLatencyWindowSize(tracker));
+    DrawTextEx(editor->settings.editor_font, line, PositionToVector(offset), editor->settings.font_size, 1, editor->settings.scheme.mode_color);
+    for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        LatencyStats stats = tracker->stats[stage];
+        snprintf(line, sizeof(line), "%-8s p50 %6.2f p95 %6.2f p99 %6.2f ms", LatencyStageToString(stage), stats.p50 * 1000.0, stats.p95 * 1000.0, stats.p99 * 1000.0);
+        DrawTextEx(editor->settings.editor_font, line, (Vector2){offset.x, offset.y + (stage + 1) * editor->settings.font_size}, editor->settings.font_size, 1, editor->settings.scheme.mode_color);
+    }
+}
+
 void EditorRender(Editor* editor) {
     ClearBackground(editor->settings.scheme.background_color);
     EditorRenderMode(editor);
-    EditorRenderTextField(editor, GetEditorTextFieldSize(editor));
+    if (editor->state.paged_file) {
+        EditorRenderPagedFile(editor, GetEditorTextFieldSize(editor));
+    } else if (editor->state.hex_view) {
+        EditorRenderHexView(editor, GetEditorTextFieldSize(editor));
+    } else {
+        EditorRenderTextField(editor, GetEditorTextFieldSize(editor));
+    }
     EditorRenderCommand(editor);
+    if (editor->latency.overlay_visible) {
+        EditorRenderLatencyOverlay(editor);
+    }
 }
 
 void SetupWindow() {
@@ -1787,6 +2521,39 @@ void SetupWindow() {
 }
 
 int main(int argc, char** argv) {
+    char** paths = malloc(argc * sizeof(char*));
+    size_t path_count = 0;
+    const char* latency_csv_path = NULL;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    bool paged = false;
+    size_t paged_cache_size = PAGED_FILE_DEFAULT_CACHE_SIZE;
+    bool hex = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--latency-csv") == 0 && i + 1 < argc) {
+            latency_csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--view") == 0) {
+            paged = true;
+        } else if (strcmp(argv[i], "--view-cache") == 0 && i + 1 < argc) {
+            // Given in MB
+            paged_cache_size = strtoull(argv[++i], NULL, 10) << 20;
+        } else if (strcmp(argv[i], "--hex") == 0) {
+            hex = true;
+        } else {
+            paths[path_count++] = argv[i];
+        }
+    }
+
+    if (replay_path) {
+        int result = ReplayInputRecording(replay_path, path_count > 0 ? paths[0] : NULL);
+        free(paths);
+        return result;
+    }
+
     SetupWindow();
 
     ColorScheme scheme = {
@@ -1794,7 +2561,8 @@ int main(int argc, char** argv) {
         .mode_color = WHITE,
         .text_color = WHITE,
         .command_color = WHITE,
-        .line_number_color = YELLOW
+        .line_number_color = YELLOW,
+        .match_color = (Color){92, 78, 28, 255}
     };
 
     EditorSettings settings = {
@@ -1806,28 +2574,40 @@ int main(int argc, char** argv) {
         .command_padding = (Position){10, 10},
         .pointer_width = 2,
         .editor_font = LoadFontEx("Input.ttf", 30, NULL, 0),
+        .paged = paged,
+        .paged_cache_size = paged_cache_size,
+        .hex = hex,
     };
 
-    char* path = NULL;
-    if (argc >= 2) {
-        path = strdup(argv[1]);
-    }
-
-    Editor editor = CreateEditor(settings, path);
-    if (path) {
-        free(path);
-        path = NULL;
+    Editor editor = CreateEditor(settings, paths, path_count);
+    EditorOpenJournals(&editor, 0);
+    EditorWatchFiles(&editor);
+    free(paths);
+    if (record_path) {
+        InitInputRecorder(&editor.recorder, record_path);
     }
 
     while (!WindowShouldClose() && !ShouldEditorClose(&editor)) {
         BeginDrawing();
 
         EditorHandleInput(&editor);
+        EditorUpdateSearch(&editor);
+        EditorUpdateIncrementalSearch(&editor);
+        EditorUpdateSave(&editor);
+        EditorUpdateFileWatch(&editor);
+        EditorUpdatePagedFile(&editor);
+        EditorUpdateHexView(&editor);
+        EditorUpdateFileCache(&editor);
         EditorRender(&editor);
-        
+        LatencyMarkRender(&editor.latency);
+
         EndDrawing();
+        LatencyMarkPresent(&editor.latency);
     }
 
+    if (latency_csv_path) {
+        WriteLatencyCsv(&editor.latency, latency_csv_path);
+    }
     ClearEditor(&editor);
     return 0;
 }
\ No newline at end of file
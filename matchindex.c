@@ -0,0 +1,272 @@
+#define _GNU_SOURCE
+#include "matchindex.h"
+
+typedef struct {
+    MatchList* matches;
+    size_t last_end;
+    // Last start taken from the current scan, matches further on may run past its window
+    size_t limit;
+} MatchCollector;
+
+static size_t MatchSpanEnd(Match match) {
+    // Empty matches still take up their position
+    return match.start + max(match.length, (size_t)1);
+}
+
+// Neighbouring scans overlap by the margin, a match seen by the previous scan is skipped
+static bool CollectNewMatch(void* context, size_t start, size_t length) {
+    MatchCollector* collector = context;
+    if (start > collector->limit) return false;
+    if (start < collector->last_end) return true;
+
+    MatchListAppend(collector->matches, start, length);
+    collector->last_end = MatchSpanEnd((Match){start, length});
+    return true;
+}
+
+static void ScanMatchIndexRange(MatchIndex* index, PieceView view, size_t from, size_t to, MatchCollector* collector) {
+    collector->limit = to;
+    from = from > index->margin ? from - index->margin : 0;
+    to = min(to + index->margin, view.text_size);
+    if (index->regex) {
+        SearchRegex(&index->compiled_regex, view, from, to, CollectNewMatch, collector);
+    } else {
+        SearchLiteral(view, &index->pattern, from, to, CollectNewMatch, collector);
+    }
+}
+
+static void AppendCoveredRange(TextRange** ranges, size_t* count, size_t* capacity, TextRange range) {
+    if (range.start >= range.end) return;
+    if (*count > 0 && (*ranges)[*count - 1].end >= range.start) {
+        (*ranges)[*count - 1].end = max((*ranges)[*count - 1].end, range.end);
+        return;
+    }
+    if (*count >= *capacity) {
+        *capacity *= 2;
+        *ranges = realloc(*ranges, *capacity * sizeof(TextRange));
+    }
+    (*ranges)[(*count)++] = range;
+}
+
+// Drops what an edit may have changed, matches starting and coverage within the margin of the
+// changed bytes, and moves everything after it by the change in length. Matches are dropped
+// by their start like the coverage is, so a covered range never misses one.
+static void ApplyTextChange(MatchIndex* index, TextChange change) {
+    size_t low = change.position > index->margin ? change.position - index->margin : 0;
+    size_t high = change.position + change.removed + index->margin;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < index->matches.count; ++i) {
+        Match match = index->matches.items[i];
+        if (match.start >= low && match.start < high) continue;
+        if (match.start >= high) {
+            match.start = match.start - change.removed + change.inserted;
+        }
+        index->matches.items[kept++] = match;
+    }
+    index->matches.count = kept;
+
+    size_t capacity = index->covered_count + 1;
+    TextRange* covered = malloc(capacity * sizeof(TextRange));
+    size_t count = 0;
+    for (size_t i = 0; i < index->covered_count; ++i) {
+        TextRange range = index->covered[i];
+        AppendCoveredRange(&covered, &count, &capacity, (TextRange){range.start, min(range.end, low)});
+        if (range.end > high) {
+            TextRange after = {max(range.start, high), range.end};
+            after.start = after.start - change.removed + change.inserted;
+            after.end = after.end - change.removed + change.inserted;
+            AppendCoveredRange(&covered, &count, &capacity, after);
+        }
+    }
+    free(index->covered);
+    index->covered = covered;
+    index->covered_count = count;
+    index->covered_capacity = capacity;
+}
+
+// Adds the matches found in the new gaps, the matches already known win where the two overlap
+static void MergeFoundMatches(MatchIndex* index, const MatchList* found) {
+    if (found->count == 0) return;
+
+    MatchList* matches = &index->matches;
+    MatchList merged;
+    InitMatchList(&merged);
+    size_t i = 0;
+    size_t j = 0;
+    size_t last_end = 0;
+    while (i < matches->count || j < found->count) {
+        if (j >= found->count || (i < matches->count && matches->items[i].start <= found->items[j].start)) {
+            MatchListAppend(&merged, matches->items[i].start, matches->items[i].length);
+            last_end = MatchSpanEnd(matches->items[i]);
+            i++;
+            continue;
+        }
+
+        Match match = found->items[j++];
+        bool overlaps_next = i < matches->count && matches->items[i].start < MatchSpanEnd(match);
+        if (match.start >= last_end && !overlaps_next) {
+            MatchListAppend(&merged, match.start, match.length);
+            last_end = MatchSpanEnd(match);
+        }
+    }
+
+    ClearMatchList(matches);
+    *matches = merged;
+}
+
+static void CoverMatchIndexRange(MatchIndex* index, TextBuffer* buffer, size_t from, size_t to) {
+    // Scrolling within what was scanned before is the common case
+    for (size_t i = 0; i < index->covered_count; ++i) {
+        if (index->covered[i].start <= from && index->covered[i].end >= to) return;
+    }
+
+    PieceView view = GetPieceView(buffer);
+    MatchList found;
+    InitMatchList(&found);
+    MatchCollector collector = { &found, 0, 0 };
+
+    size_t capacity = index->covered_count + 2;
+    TextRange* covered = malloc(capacity * sizeof(TextRange));
+    size_t count = 0;
+    size_t position = from;
+    for (size_t i = 0; i <= index->covered_count; ++i) {
+        TextRange range = i < index->covered_count ? index->covered[i] : (TextRange){to, to};
+        if (position < to && range.start > position) {
+            size_t gap_end = min(range.start, to);
+            ScanMatchIndexRange(index, view, position, gap_end, &collector);
+            AppendCoveredRange(&covered, &count, &capacity, (TextRange){position, gap_end});
+            position = gap_end;
+        }
+        if (i < index->covered_count) {
+            AppendCoveredRange(&covered, &count, &capacity, range);
+            position = max(position, range.end);
+        }
+    }
+
+    free(index->covered);
+    index->covered = covered;
+    index->covered_count = count;
+    index->covered_capacity = capacity;
+
+    MergeFoundMatches(index, &found);
+    ClearMatchList(&found);
+}
+
+bool InitMatchIndex(MatchIndex* index, TextBuffer* buffer, const char* query, bool regex) {
+    *index = (MatchIndex){0};
+    index->regex = regex;
+    if (regex) {
+        if (!CompileRegex(&index->compiled_regex, query)) {
+            snprintf(index->error, sizeof(index->error), "%s", index->compiled_regex.error);
+            return false;
+        }
+        index->margin = MATCH_INDEX_REGEX_MARGIN;
+    } else {
+        if (!InitLiteralPattern(&index->pattern, query, strlen(query))) {
+            snprintf(index->error, sizeof(index->error), "empty search");
+            return false;
+        }
+        index->margin = index->pattern.length - 1;
+    }
+
+    index->query = strdup(query);
+    InitMatchList(&index->matches);
+    index->covered = malloc(INITIAL_MATCH_INDEX_RANGES * sizeof(TextRange));
+    index->covered_capacity = INITIAL_MATCH_INDEX_RANGES;
+    index->revision = buffer->revision;
+    index->active = true;
+    return true;
+}
+
+// Takes matches, all of them in a text of text_size bytes at revision, as found by a full scan
+// elsewhere. The index owns them after this and catches up with later edits on the next sync.
+void CoverMatchIndex(MatchIndex* index, MatchList* matches, size_t text_size, uint64_t revision) {
+    if (!index->active) return;
+
+    ClearMatchList(&index->matches);
+    index->matches = *matches;
+    InitMatchList(matches);
+    index->covered[0] = (TextRange){0, text_size + 1};
+    index->covered_count = 1;
+    index->revision = revision;
+}
+
+// Catches up with the edits made since the last call, starting over if they left the change log
+void SyncMatchIndex(MatchIndex* index, TextBuffer* buffer) {
+    if (!index->active) return;
+
+    for (uint64_t revision = index->revision + 1; revision <= buffer->revision; ++revision) {
+        TextChange change;
+        if (!GetTextChange(buffer, revision, &change)) {
+            index->matches.count = 0;
+            index->covered_count = 0;
+            break;
+        }
+        ApplyTextChange(index, change);
+    }
+    index->revision = buffer->revision;
+}
+
+// Returns the matches touching [from, to] and their number in count, scanning the parts of the
+// range not covered yet
+const Match* QueryMatchIndex(MatchIndex* index, TextBuffer* buffer, size_t from, size_t to, size_t* count) {
+    *count = 0;
+    if (!index->active) return NULL;
+
+    SyncMatchIndex(index, buffer);
+    to = min(to, buffer->text_size);
+    from = min(from, to);
+    // Matches starting right at to count, like empty matches at the very end of the text
+    CoverMatchIndexRange(index, buffer, from, to + 1);
+
+    const MatchList* matches = &index->matches;
+    size_t low = 0;
+    size_t high = matches->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (MatchSpanEnd(matches->items[mid]) <= from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    size_t end = low;
+    while (end < matches->count && matches->items[end].start <= to) {
+        end++;
+    }
+    *count = end - low;
+    return matches->items + low;
+}
+
+// Bytes of [from, to) not covered yet, what a query over the range would have to scan
+size_t GetMatchIndexGaps(const MatchIndex* index, size_t from, size_t to) {
+    size_t gaps = to > from ? to - from : 0;
+    for (size_t i = 0; i < index->covered_count; ++i) {
+        size_t start = max(index->covered[i].start, from);
+        size_t end = min(index->covered[i].end, to);
+        if (end > start) {
+            gaps -= end - start;
+        }
+    }
+    return gaps;
+}
+
+void ClearMatchIndex(MatchIndex* index) {
+    if (!index->active) return;
+
+    if (index->regex) {
+        ClearRegex(&index->compiled_regex);
+    } else {
+        ClearLiteralPattern(&index->pattern);
+    }
+    free(index->query);
+    index->query = NULL;
+    ClearMatchList(&index->matches);
+    free(index->covered);
+    index->covered = NULL;
+    index->covered_count = 0;
+    index->covered_capacity = 0;
+    index->active = false;
+}
@@ -0,0 +1,43 @@
+#ifndef MATCHINDEX_H
+#define MATCHINDEX_H
+
+#include "funregex.h"
+
+// How far around an edit regex matches are looked for again, longer matches are not tracked exactly
+#define MATCH_INDEX_REGEX_MARGIN 4096
+#define INITIAL_MATCH_INDEX_RANGES 16
+
+typedef struct {
+    size_t start;
+    size_t end;
+} TextRange;
+
+// The matches of one query, found only where they were asked for. covered holds the sorted,
+// disjoint ranges whose matches are all in matches. Edits drop the matches and coverage
+// around the changed region and shift the rest, so scrolling back only scans what changed.
+typedef struct {
+    char* query;
+    bool regex;
+    LiteralPattern pattern;
+    Regex compiled_regex;
+    char error[96];
+    // Bytes around a range that are scanned along with it, so matches crossing its ends are found
+    size_t margin;
+
+    MatchList matches;
+    TextRange* covered;
+    size_t covered_count;
+    size_t covered_capacity;
+
+    uint64_t revision;
+    bool active;
+} MatchIndex;
+
+bool InitMatchIndex(MatchIndex* index, TextBuffer* buffer, const char* query, bool regex);
+void CoverMatchIndex(MatchIndex* index, MatchList* matches, size_t text_size, uint64_t revision);
+void SyncMatchIndex(MatchIndex* index, TextBuffer* buffer);
+size_t GetMatchIndexGaps(const MatchIndex* index, size_t from, size_t to);
+const Match* QueryMatchIndex(MatchIndex* index, TextBuffer* buffer, size_t from, size_t to, size_t* count);
+void ClearMatchIndex(MatchIndex* index);
+
+#endif
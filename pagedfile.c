@@ -0,0 +1,369 @@
+#define _GNU_SOURCE
+#include "pagedfile.h"
+#include "fileload.h"
+
+#include <errno.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#endif
+
+static const char* FindLastNewline(const char* data, size_t length) {
+#ifdef __GLIBC__
+    return memrchr(data, '\n', length);
+#else
+    for (size_t i = length; i > 0; --i) {
+        if (data[i - 1] == '\n') return data + i - 1;
+    }
+    return NULL;
+#endif
+}
+
+bool IsLargeFile(const char* path) {
+    struct stat file_stat;
+    return stat(path, &file_stat) == 0 && (uint64_t)file_stat.st_size >= PAGED_FILE_AUTO_SIZE;
+}
+
+// The bytes from offset to the end of the page holding it, read into the cache if needed
+static const char* GetPagedBytes(PagedFile* file, uint64_t offset, size_t* available) {
+    *available = 0;
+    if (offset >= file->size) return NULL;
+
+    uint64_t page_offset = offset - offset % PAGED_FILE_PAGE_SIZE;
+    FilePage* victim = NULL;
+    for (size_t i = 0; i < file->page_count; ++i) {
+        FilePage* page = &file->pages[i];
+        if (page->data && page->offset == page_offset) {
+            victim = page;
+            break;
+        }
+        // An empty slot first, otherwise the page used longest ago
+        if (!victim || (victim->data && (!page->data || page->last_used < victim->last_used))) {
+            victim = page;
+        }
+    }
+
+    if (!victim->data || victim->offset != page_offset) {
+        if (!victim->data) {
+            victim->data = malloc(PAGED_FILE_PAGE_SIZE);
+        }
+        victim->offset = page_offset;
+        victim->length = ReadFileAt(file->fd, victim->data, min(file->size - page_offset, (uint64_t)PAGED_FILE_PAGE_SIZE), page_offset);
+    }
+    victim->last_used = ++file->use_clock;
+
+    // The file may have shrunk since it was opened
+    size_t skip = offset - page_offset;
+    if (skip >= victim->length) return NULL;
+    *available = victim->length - skip;
+    return victim->data + skip;
+}
+
+// Start of the line after the one holding offset, or the end of the file
+uint64_t FindNextPagedLine(PagedFile* file, uint64_t offset) {
+    while (offset < file->size) {
+        size_t available;
+        const char* data = GetPagedBytes(file, offset, &available);
+        if (!data) break;
+        const char* newline = memchr(data, '\n', available);
+        if (newline) return offset + (newline - data) + 1;
+        offset += available;
+    }
+    return file->size;
+}
+
+uint64_t FindPagedLineStart(PagedFile* file, uint64_t offset) {
+    offset = min(offset, file->size);
+    while (offset > 0) {
+        uint64_t page_offset = (offset - 1) - (offset - 1) % PAGED_FILE_PAGE_SIZE;
+        size_t available;
+        const char* data = GetPagedBytes(file, page_offset, &available);
+        if (!data) return 0;
+        const char* newline = FindLastNewline(data, min(offset - page_offset, (uint64_t)available));
+        if (newline) return page_offset + (newline - data) + 1;
+        offset = page_offset;
+    }
+    return 0;
+}
+
+static uint64_t CountPagedNewlines(PagedFile* file, uint64_t from, uint64_t to) {
+    uint64_t count = 0;
+    while (from < to) {
+        size_t available;
+        const char* data = GetPagedBytes(file, from, &available);
+        if (!data) break;
+        size_t length = min(to - from, (uint64_t)available);
+        const char* end = data + length;
+        for (const char* p = data; p < end && (p = memchr(p, '\n', end - p)); ++p) {
+            count++;
+        }
+        from += length;
+    }
+    return count;
+}
+
+// Copies the line starting at offset from column on into out, cut to fit. Control bytes are
+// shown as dots, so binary data does not end the line early. next is set to the following line.
+size_t ReadPagedLine(PagedFile* file, uint64_t offset, size_t column, char* out, size_t capacity, uint64_t* next) {
+    size_t length = 0;
+    uint64_t position = offset;
+    uint64_t line_end = file->size;
+    while (position < file->size) {
+        size_t available;
+        const char* data = GetPagedBytes(file, position, &available);
+        if (!data) break;
+        const char* newline = memchr(data, '\n', available);
+        size_t run = newline ? (size_t)(newline - data) : available;
+
+        uint64_t run_column = position - offset;
+        if (run_column + run > column && length + 1 < capacity) {
+            size_t skip = column > run_column ? column - run_column : 0;
+            size_t take = min(run - skip, capacity - 1 - length);
+            memcpy(out + length, data + skip, take);
+            length += take;
+        }
+        position += run;
+        if (newline) {
+            line_end = position;
+            position++;
+            break;
+        }
+    }
+    *next = min(position, file->size);
+
+    // The CR of a CRLF is dropped when the copy reached the end of the line
+    if (length > 0 && out[length - 1] == '\r' && column + length == line_end - offset) {
+        length--;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if ((unsigned char)out[i] < 0x20 && out[i] != '\t') {
+            out[i] = '.';
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
+
+static void* BuildPagedLineIndex(void* argument) {
+    PagedFile* file = argument;
+    int fd = OpenReadOnly(file->path);
+    char* chunk = malloc(PAGED_INDEX_READ_SIZE);
+    // A chunk holds at most one checkpoint per PAGED_LINE_INTERVAL bytes
+    uint64_t* found = malloc((PAGED_INDEX_READ_SIZE / PAGED_LINE_INTERVAL + 1) * sizeof(uint64_t));
+    uint64_t offset = 0;
+    uint64_t lines = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+    while (fd >= 0 && offset < file->size && !__atomic_load_n(&file->index_stopping, __ATOMIC_RELAXED)) {
+        size_t read = ReadFileAt(fd, chunk, min(file->size - offset, (uint64_t)PAGED_INDEX_READ_SIZE), offset);
+        if (read == 0) break;
+
+        size_t found_count = 0;
+        const char* end = chunk + read;
+        for (const char* p = chunk; p < end && (p = memchr(p, '\n', end - p)); ++p) {
+            if (++lines % PAGED_LINE_INTERVAL == 0) {
+                found[found_count++] = offset + (p - chunk) + 1;
+            }
+        }
+
+        pthread_mutex_lock(&file->index_lock);
+        if (file->checkpoint_count + found_count > file->checkpoint_capacity) {
+            while (file->checkpoint_count + found_count > file->checkpoint_capacity) {
+                file->checkpoint_capacity *= 2;
+            }
+            file->checkpoints = realloc(file->checkpoints, file->checkpoint_capacity * sizeof(uint64_t));
+        }
+        memcpy(file->checkpoints + file->checkpoint_count, found, found_count * sizeof(uint64_t));
+        file->checkpoint_count += found_count;
+        file->indexed_size = offset + read;
+        file->indexed_lines = lines;
+        pthread_mutex_unlock(&file->index_lock);
+
+#ifdef POSIX_FADV_DONTNEED
+        // Scanned once, the pages shown come through the cache
+        posix_fadvise(fd, offset, read, POSIX_FADV_DONTNEED);
+#endif
+        offset += read;
+    }
+
+    pthread_mutex_lock(&file->index_lock);
+    file->index_complete = true;
+    pthread_mutex_unlock(&file->index_lock);
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(chunk);
+    free(found);
+    return NULL;
+}
+
+bool OpenPagedFile(PagedFile* file, const char* path, size_t cache_size) {
+    *file = (PagedFile){0};
+    int fd = OpenReadOnly(path);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0) {
+        fprintf(stderr, "Could not open file: %s (%s)\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    file->path = strdup(path);
+    file->fd = fd;
+    file->size = file_stat.st_size;
+    // Pages are only allocated once read, a small file never takes the whole cache
+    file->page_count = max(cache_size / PAGED_FILE_PAGE_SIZE, (size_t)2);
+    file->pages = calloc(file->page_count, sizeof(FilePage));
+
+    pthread_mutex_init(&file->index_lock, NULL);
+    file->checkpoint_capacity = INITIAL_PAGED_CHECKPOINT_CAPACITY;
+    file->checkpoints = malloc(file->checkpoint_capacity * sizeof(uint64_t));
+    file->checkpoints[0] = 0;
+    file->checkpoint_count = 1;
+    file->top_line_exact = true;
+
+    file->index_running = pthread_create(&file->index_thread, NULL, BuildPagedLineIndex, file) == 0;
+    if (!file->index_running) {
+        // No thread to be had, index right here instead
+        BuildPagedLineIndex(file);
+    }
+    return true;
+}
+
+// Line number of the line starting at offset, false while the index has not got that far
+static bool GetPagedLineNumber(PagedFile* file, uint64_t offset, uint64_t* line) {
+    pthread_mutex_lock(&file->index_lock);
+    if (offset > file->indexed_size && !file->index_complete) {
+        pthread_mutex_unlock(&file->index_lock);
+        return false;
+    }
+    size_t low = 0;
+    size_t high = file->checkpoint_count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (file->checkpoints[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    uint64_t start = file->checkpoints[low];
+    pthread_mutex_unlock(&file->index_lock);
+
+    *line = (uint64_t)low * PAGED_LINE_INTERVAL + CountPagedNewlines(file, start, offset);
+    return true;
+}
+
+static uint64_t GetBytesPerLine(PagedFile* file) {
+    pthread_mutex_lock(&file->index_lock);
+    uint64_t lines = file->indexed_lines;
+    uint64_t size = file->indexed_size;
+    pthread_mutex_unlock(&file->index_lock);
+    return lines > 0 ? max(size / lines, (uint64_t)1) : PAGED_ESTIMATED_LINE_LENGTH;
+}
+
+// Shows the line holding offset at the top. A newline at the very end starts no line of its own.
+void JumpToPagedOffset(PagedFile* file, uint64_t offset) {
+    if (offset >= file->size) {
+        offset = file->size > 0 ? file->size - 1 : 0;
+    }
+    file->top = FindPagedLineStart(file, offset);
+    file->top_line_exact = GetPagedLineNumber(file, file->top, &file->top_line);
+    if (!file->top_line_exact) {
+        file->top_line = file->top / GetBytesPerLine(file);
+    }
+}
+
+// Goes to line, counted from 0. Past the index the line is placed by the average line length
+// seen so far and its number stays an estimate until the index catches up.
+void JumpToPagedLine(PagedFile* file, uint64_t line) {
+    size_t checkpoint = line / PAGED_LINE_INTERVAL;
+    pthread_mutex_lock(&file->index_lock);
+    bool indexed = checkpoint < file->checkpoint_count;
+    bool complete = file->index_complete;
+    uint64_t start = indexed ? file->checkpoints[checkpoint] : 0;
+    pthread_mutex_unlock(&file->index_lock);
+
+    if (!indexed) {
+        if (complete) {
+            JumpToPagedOffset(file, file->size);
+            return;
+        }
+        JumpToPagedOffset(file, line * GetBytesPerLine(file));
+        if (!file->top_line_exact) {
+            file->top_line = line;
+        }
+        return;
+    }
+
+    file->top = start;
+    file->top_line = (uint64_t)checkpoint * PAGED_LINE_INTERVAL;
+    file->top_line_exact = true;
+    for (uint64_t left = line % PAGED_LINE_INTERVAL; left > 0; --left) {
+        uint64_t next = FindNextPagedLine(file, file->top);
+        if (next >= file->size) break;
+        file->top = next;
+        file->top_line++;
+    }
+}
+
+void ScrollPagedFile(PagedFile* file, int64_t lines) {
+    for (; lines > 0; --lines) {
+        uint64_t next = FindNextPagedLine(file, file->top);
+        if (next >= file->size) break;
+        file->top = next;
+        file->top_line++;
+    }
+    for (; lines < 0 && file->top > 0; ++lines) {
+        file->top = FindPagedLineStart(file, file->top - 1);
+        if (file->top_line > 0) {
+            file->top_line--;
+        }
+    }
+}
+
+// Makes an estimated line number exact once the index has passed it
+void UpdatePagedFile(PagedFile* file) {
+    if (file->top_line_exact) return;
+    uint64_t line;
+    if (GetPagedLineNumber(file, file->top, &line)) {
+        file->top_line = line;
+        file->top_line_exact = true;
+    }
+}
+
+// Share of the file indexed so far, line_count is set to the lines found in it
+double GetPagedIndexProgress(PagedFile* file, uint64_t* line_count) {
+    pthread_mutex_lock(&file->index_lock);
+    double progress = file->index_complete || file->size == 0 ? 1.0 : (double)file->indexed_size / file->size;
+    if (line_count) {
+        *line_count = file->indexed_lines + 1;
+    }
+    pthread_mutex_unlock(&file->index_lock);
+    return progress;
+}
+
+void ClosePagedFile(PagedFile* file) {
+    if (file->index_running) {
+        __atomic_store_n(&file->index_stopping, 1, __ATOMIC_RELAXED);
+        pthread_join(file->index_thread, NULL);
+        file->index_running = false;
+    }
+    pthread_mutex_destroy(&file->index_lock);
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    for (size_t i = 0; i < file->page_count; ++i) {
+        free(file->pages[i].data);
+    }
+    free(file->pages);
+    free(file->checkpoints);
+    free(file->path);
+    *file = (PagedFile){0};
+    file->fd = -1;
+}
@@ -0,0 +1,74 @@
+#ifndef PAGEDFILE_H
+#define PAGEDFILE_H
+
+#include <pthread.h>
+
+#include "funcore.h"
+
+// Window of the file read in one go and kept in the cache
+#define PAGED_FILE_PAGE_SIZE (1 << 20)
+#define PAGED_FILE_DEFAULT_CACHE_SIZE (64 << 20)
+// Files this large open in the viewer even when it was not asked for
+#define PAGED_FILE_AUTO_SIZE (1ULL << 30)
+// Lines between two offsets kept by the line index
+#define PAGED_LINE_INTERVAL 1024
+// Bytes the index thread reads at a time, with its own buffer next to the cache
+#define PAGED_INDEX_READ_SIZE (4 << 20)
+#define INITIAL_PAGED_CHECKPOINT_CAPACITY 1024
+// Guess at the length of a line until the index has seen some
+#define PAGED_ESTIMATED_LINE_LENGTH 80
+
+typedef struct {
+    uint64_t offset;
+    char* data;
+    size_t length;
+    uint64_t last_used;
+} FilePage;
+
+// A file shown read-only without loading it. Windows of it are read on demand into a cache
+// of fixed size, the least recently used one making room for the next. A thread builds a
+// sparse line index meanwhile, so jumps to a line are exact once it got there and estimated
+// from the lines seen so far before.
+typedef struct {
+    char* path;
+    int fd;
+    uint64_t size;
+
+    FilePage* pages;
+    size_t page_count;
+    uint64_t use_clock;
+
+    // checkpoints[i] is where line i * PAGED_LINE_INTERVAL starts. Lines and bytes seen so far
+    // are updated by the index thread as it goes.
+    pthread_t index_thread;
+    pthread_mutex_t index_lock;
+    uint64_t* checkpoints;
+    size_t checkpoint_count;
+    size_t checkpoint_capacity;
+    uint64_t indexed_size;
+    uint64_t indexed_lines;
+    bool index_running;
+    bool index_complete;
+    int index_stopping;
+
+    // First line shown and the column the lines are shown from. The line number is an
+    // estimate until the index reaches it.
+    uint64_t top;
+    uint64_t top_line;
+    bool top_line_exact;
+    size_t column;
+} PagedFile;
+
+bool IsLargeFile(const char* path);
+bool OpenPagedFile(PagedFile* file, const char* path, size_t cache_size);
+uint64_t FindNextPagedLine(PagedFile* file, uint64_t offset);
+uint64_t FindPagedLineStart(PagedFile* file, uint64_t offset);
+size_t ReadPagedLine(PagedFile* file, uint64_t offset, size_t column, char* out, size_t capacity, uint64_t* next);
+void JumpToPagedOffset(PagedFile* file, uint64_t offset);
+void JumpToPagedLine(PagedFile* file, uint64_t line);
+void ScrollPagedFile(PagedFile* file, int64_t lines);
+void UpdatePagedFile(PagedFile* file);
+double GetPagedIndexProgress(PagedFile* file, uint64_t* line_count);
+void ClosePagedFile(PagedFile* file);
+
+#endif
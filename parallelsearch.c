@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include "parallelsearch.h"
+
+typedef struct {
+    MatchList* matches;
+    size_t end;
+    int* cancelled;
+} RangeCollector;
+
+static bool CollectRangeMatch(void* context, size_t start, size_t length) {
+    RangeCollector* collector = context;
+    if (start >= collector->end) return false;
+
+    MatchListAppend(collector->matches, start, length);
+    return !__atomic_load_n(collector->cancelled, __ATOMIC_RELAXED);
+}
+
+static bool InitSearchMatcher(ParallelSearch* search, LiteralPattern* pattern, Regex* regex) {
+    if (search->regex) {
+        if (CompileRegex(regex, search->query)) return true;
+        snprintf(search->error, sizeof(search->error), "%s", regex->error);
+        return false;
+    }
+    if (InitLiteralPattern(pattern, search->query, strlen(search->query))) return true;
+    snprintf(search->error, sizeof(search->error), "empty search");
+    return false;
+}
+
+static void ClearSearchMatcher(ParallelSearch* search, LiteralPattern* pattern, Regex* regex) {
+    if (search->regex) {
+        ClearRegex(regex);
+    } else {
+        ClearLiteralPattern(pattern);
+    }
+}
+
+// Collects the matches starting in [start, end). A literal match runs past end by less than the
+// needle, a regex match is followed as far as it goes.
+static void ScanSearchRange(ParallelSearch* search, LiteralPattern* pattern, Regex* regex, size_t start, size_t end, MatchList* matches) {
+    PieceView view = search->snapshot.view;
+    RangeCollector collector = { matches, end, &search->cancelled };
+    if (search->regex) {
+        SearchRegexStarts(regex, view, start, end, CollectRangeMatch, &collector);
+    } else {
+        SearchLiteral(view, pattern, start, min(end + pattern->length - 1, view.text_size), CollectRangeMatch, &collector);
+    }
+}
+
+static void* ParallelSearchWorker(void* argument) {
+    ParallelSearch* search = argument;
+    LiteralPattern pattern = {0};
+    Regex regex = {0};
+    InitSearchMatcher(search, &pattern, &regex);
+
+    while (!__atomic_load_n(&search->cancelled, __ATOMIC_RELAXED)) {
+        size_t index = __atomic_fetch_add(&search->next_range, 1, __ATOMIC_RELAXED);
+        if (index >= search->range_count) break;
+
+        SearchRange* range = &search->ranges[index];
+        ScanSearchRange(search, &pattern, &regex, range->start, range->end, &range->matches);
+        __atomic_store_n(&range->done, 1, __ATOMIC_RELEASE);
+    }
+
+    ClearSearchMatcher(search, &pattern, &regex);
+    return NULL;
+}
+
+static void JoinParallelSearch(ParallelSearch* search) {
+    for (size_t i = 0; i < search->thread_count; ++i) {
+        pthread_join(search->threads[i], NULL);
+    }
+    search->thread_count = 0;
+}
+
+// thread_count 0 uses one thread per processor
+bool StartParallelSearch(ParallelSearch* search, TextBuffer* buffer, const char* query, bool regex, size_t thread_count) {
+    *search = (ParallelSearch){0};
+    search->query = strdup(query);
+    search->regex = regex;
+    if (!InitSearchMatcher(search, &search->pattern, &search->compiled_regex)) {
+        free(search->query);
+        search->query = NULL;
+        return false;
+    }
+
+    search->snapshot = CreateTextSnapshot(buffer);
+    size_t text_size = search->snapshot.view.text_size;
+    search->range_count = max((size_t)1, (text_size + PARALLEL_SEARCH_RANGE_SIZE - 1) / PARALLEL_SEARCH_RANGE_SIZE);
+    search->ranges = calloc(search->range_count, sizeof(SearchRange));
+    for (size_t i = 0; i < search->range_count; ++i) {
+        search->ranges[i].start = i * PARALLEL_SEARCH_RANGE_SIZE;
+        search->ranges[i].end = min((i + 1) * PARALLEL_SEARCH_RANGE_SIZE, text_size);
+        InitMatchList(&search->ranges[i].matches);
+    }
+    // An empty text still gets one range so empty regex matches are reported
+    search->ranges[search->range_count - 1].end = max(search->ranges[search->range_count - 1].end, text_size + 1);
+
+    if (thread_count == 0) {
+        thread_count = GetProcessorCount();
+    }
+    thread_count = min(min(thread_count, search->range_count), (size_t)PARALLEL_SEARCH_MAX_THREADS);
+    for (size_t i = 0; i < thread_count; ++i) {
+        if (pthread_create(&search->threads[search->thread_count], NULL, ParallelSearchWorker, search) == 0) {
+            search->thread_count++;
+        }
+    }
+    search->active = true;
+
+    // Without any worker the polling thread would wait forever, do the work here instead
+    if (search->thread_count == 0) {
+        ParallelSearchWorker(search);
+    }
+    return true;
+}
+
+// Appends the matches of every range finished since the last poll, in text order.
+// Returns the number of matches appended.
+size_t PollParallelSearch(ParallelSearch* search, MatchList* out) {
+    if (!search->active) return 0;
+
+    size_t added = 0;
+    while (search->merged_ranges < search->range_count) {
+        SearchRange* range = &search->ranges[search->merged_ranges];
+        if (!__atomic_load_n(&range->done, __ATOMIC_ACQUIRE)) break;
+
+        MatchList* matches = &range->matches;
+        if (matches->count > 0 && matches->items[0].start < search->merged_end) {
+            // The last match of the previous range runs into this one, a sequential scan
+            // would have continued from its end so redo the range from there
+            matches->count = 0;
+            ScanSearchRange(search, &search->pattern, &search->compiled_regex, search->merged_end, range->end, matches);
+        }
+
+        for (size_t i = 0; i < matches->count; ++i) {
+            MatchListAppend(out, matches->items[i].start, matches->items[i].length);
+        }
+        if (matches->count > 0) {
+            Match last = matches->items[matches->count - 1];
+            search->merged_end = last.start + last.length + (last.length == 0);
+        }
+        added += matches->count;
+        ClearMatchList(matches);
+        search->merged_ranges++;
+    }
+
+    if (search->merged_ranges == search->range_count) {
+        JoinParallelSearch(search);
+    }
+    return added;
+}
+
+bool IsParallelSearchDone(ParallelSearch* search) {
+    return !search->active || search->merged_ranges == search->range_count;
+}
+
+// Workers stop after their current match or range, ClearParallelSearch waits for them
+void CancelParallelSearch(ParallelSearch* search) {
+    __atomic_store_n(&search->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+void ClearParallelSearch(ParallelSearch* search) {
+    if (!search->active) return;
+
+    CancelParallelSearch(search);
+    JoinParallelSearch(search);
+
+    for (size_t i = 0; i < search->range_count; ++i) {
+        ClearMatchList(&search->ranges[i].matches);
+    }
+    free(search->ranges);
+    search->ranges = NULL;
+    search->range_count = 0;
+
+    ClearSearchMatcher(search, &search->pattern, &search->compiled_regex);
+    ClearTextSnapshot(&search->snapshot);
+    free(search->query);
+    search->query = NULL;
+    search->active = false;
+}
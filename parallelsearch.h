@@ -0,0 +1,49 @@
+#ifndef PARALLELSEARCH_H
+#define PARALLELSEARCH_H
+
+#include <pthread.h>
+
+#include "funregex.h"
+
+#define PARALLEL_SEARCH_RANGE_SIZE (4 << 20)
+#define PARALLEL_SEARCH_MAX_THREADS 64
+
+typedef struct {
+    size_t start;
+    size_t end;
+    MatchList matches;
+    // Set by the worker once matches is complete, read with acquire
+    int done;
+} SearchRange;
+
+// Searches a snapshot in fixed size ranges on a pool of threads. Ranges are handed out in
+// text order and merged in order by PollParallelSearch, so the first hits arrive early.
+typedef struct {
+    TextSnapshot snapshot;
+    char* query;
+    bool regex;
+    char error[96];
+
+    SearchRange* ranges;
+    size_t range_count;
+    size_t next_range;
+    int cancelled;
+
+    pthread_t threads[PARALLEL_SEARCH_MAX_THREADS];
+    size_t thread_count;
+
+    // Owned by the polling thread, used to redo a range whose first match overlaps the previous one
+    LiteralPattern pattern;
+    Regex compiled_regex;
+    size_t merged_ranges;
+    size_t merged_end;
+    bool active;
+} ParallelSearch;
+
+bool StartParallelSearch(ParallelSearch* search, TextBuffer* buffer, const char* query, bool regex, size_t thread_count);
+size_t PollParallelSearch(ParallelSearch* search, MatchList* out);
+bool IsParallelSearchDone(ParallelSearch* search);
+void CancelParallelSearch(ParallelSearch* search);
+void ClearParallelSearch(ParallelSearch* search);
+
+#endif
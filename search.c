@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include "search.h"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+PieceCursor InitPieceCursor(PieceView view) {
+    return (PieceCursor){ .view = view, .index = 0, .piece_start = 0 };
+}
+
+// Leaves the cursor on the piece containing position, or at piece_count past the end of the text
+void SeekPieceCursor(PieceCursor* cursor, size_t position) {
+    const Piece* pieces = cursor->view.pieces;
+    while (cursor->index > 0 && position < cursor->piece_start) {
+        cursor->index--;
+        cursor->piece_start -= pieces[cursor->index].length;
+    }
+    while (cursor->index < cursor->view.piece_count && position >= cursor->piece_start + pieces[cursor->index].length) {
+        cursor->piece_start += pieces[cursor->index].length;
+        cursor->index++;
+    }
+}
+
+char PieceCursorByteAt(PieceCursor* cursor, size_t position) {
+    SeekPieceCursor(cursor, position);
+    if (cursor->index >= cursor->view.piece_count) return '\0';
+    return GetPieceViewText(cursor->view, cursor->view.pieces[cursor->index])[position - cursor->piece_start];
+}
+
+bool InitLiteralPattern(LiteralPattern* pattern, const char* needle, size_t length) {
+    if (length == 0) return false;
+
+    pattern->needle = malloc(length);
+    memcpy(pattern->needle, needle, length);
+    pattern->length = length;
+    pattern->window = malloc(length * 2);
+
+    for (size_t i = 0; i < ARRAY_LEN(pattern->skip); ++i) {
+        pattern->skip[i] = length;
+    }
+    for (size_t i = 0; i + 1 < length; ++i) {
+        pattern->skip[(unsigned char)needle[i]] = length - 1 - i;
+    }
+    return true;
+}
+
+void ClearLiteralPattern(LiteralPattern* pattern) {
+    if (pattern->needle) {
+        free(pattern->needle);
+        pattern->needle = NULL;
+    }
+    if (pattern->window) {
+        free(pattern->window);
+        pattern->window = NULL;
+    }
+    pattern->length = 0;
+}
+
+// Offset of the first occurrence of the pattern in text, SIZE_MAX if there is none
+size_t FindLiteralInText(const LiteralPattern* pattern, const char* text, size_t length) {
+    size_t m = pattern->length;
+    if (m > length) return SIZE_MAX;
+
+    if (m == 1) {
+        const char* hit = memchr(text, pattern->needle[0], length);
+        return hit ? (size_t)(hit - text) : SIZE_MAX;
+    }
+
+    const char* needle = pattern->needle;
+    size_t last = length - m;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Compare the first and last needle byte against 16 candidate starts at once,
+    // only candidates where both agree are verified with memcmp
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i final = _mm_set1_epi8(needle[m - 1]);
+    for (; i + 15 <= last; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i block_final = _mm_loadu_si128((const __m128i*)(text + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(final, block_final)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(text + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    // Horspool for what is left (or everything without SSE2)
+    while (i <= last) {
+        unsigned char c = text[i + m - 1];
+        if (c == (unsigned char)needle[m - 1] && memcmp(text + i, needle, m - 1) == 0) return i;
+        i += pattern->skip[c];
+    }
+    return SIZE_MAX;
+}
+
+// Reports every non-overlapping match that lies fully inside [from, to). Pieces are scanned
+// in place, matches crossing piece boundaries are found in a window made of the last
+// length - 1 bytes before a piece and the first length - 1 bytes of it.
+size_t SearchLiteral(PieceView view, LiteralPattern* pattern, size_t from, size_t to, MatchCallback callback, void* context) {
+    size_t m = pattern->length;
+    to = min(to, view.text_size);
+    if (m == 0 || from >= to || to - from < m) return 0;
+
+    char* window = pattern->window;
+    size_t found = 0;
+    size_t next_allowed = from;
+    size_t tail_length = 0;
+    size_t piece_start = 0;
+    for (size_t i = 0; i < view.piece_count && piece_start < to; piece_start += view.pieces[i].length, ++i) {
+        Piece piece = view.pieces[i];
+        if (piece_start + piece.length <= from) continue;
+
+        size_t offset = from > piece_start ? from - piece_start : 0;
+        size_t chunk_start = piece_start + offset;
+        size_t chunk_length = min(piece_start + piece.length, to) - chunk_start;
+        const char* chunk = GetPieceViewText(view, piece) + offset;
+
+        if (tail_length > 0) {
+            size_t head = min(chunk_length, m - 1);
+            memcpy(window + tail_length, chunk, head);
+            size_t window_start = chunk_start - tail_length;
+            size_t scan = next_allowed > window_start ? next_allowed - window_start : 0;
+            while (scan < tail_length) {
+                size_t hit = FindLiteralInText(pattern, window + scan, tail_length + head - scan);
+                if (hit == SIZE_MAX || scan + hit >= tail_length) break;
+                scan += hit;
+
+                found++;
+                if (!callback(context, window_start + scan, m)) return found;
+                next_allowed = window_start + scan + m;
+                scan += m;
+            }
+        }
+
+        size_t scan = next_allowed > chunk_start ? next_allowed - chunk_start : 0;
+        while (scan + m <= chunk_length) {
+            size_t hit = FindLiteralInText(pattern, chunk + scan, chunk_length - scan);
+            if (hit == SIZE_MAX) break;
+            scan += hit;
+
+            found++;
+            if (!callback(context, chunk_start + scan, m)) return found;
+            next_allowed = chunk_start + scan + m;
+            scan += m;
+        }
+
+        // Keep the last m - 1 bytes seen, they may span several short pieces
+        if (chunk_length >= m - 1) {
+            memcpy(window, chunk + chunk_length - (m - 1), m - 1);
+            tail_length = m - 1;
+        } else {
+            size_t keep = min(tail_length, m - 1 - chunk_length);
+            memmove(window, window + tail_length - keep, keep);
+            memcpy(window + keep, chunk, chunk_length);
+            tail_length = keep + chunk_length;
+        }
+    }
+    return found;
+}
+
+static bool StoreFirstMatch(void* context, size_t start, size_t length) {
+    *(Match*)context = (Match){start, length};
+    return false;
+}
+
+// First match at or after from, wrapping around to the start of the text
+bool FindNextLiteral(PieceView view, LiteralPattern* pattern, size_t from, Match* match) {
+    from = min(from, view.text_size);
+    if (SearchLiteral(view, pattern, from, view.text_size, StoreFirstMatch, match)) return true;
+    return SearchLiteral(view, pattern, 0, min(from + pattern->length - 1, view.text_size), StoreFirstMatch, match) > 0;
+}
+
+void InitMatchList(MatchList* list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void MatchListAppend(MatchList* list, size_t start, size_t length) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, list->capacity * sizeof(Match));
+    }
+    list->items[list->count++] = (Match){start, length};
+}
+
+bool MatchListCollect(void* context, size_t start, size_t length) {
+    MatchListAppend(context, start, length);
+    return true;
+}
+
+void ClearMatchList(MatchList* list) {
+    if (list->items) {
+        free(list->items);
+        list->items = NULL;
+    }
+    list->count = 0;
+    list->capacity = 0;
+}
+
+size_t FindAllLiteral(PieceView view, LiteralPattern* pattern, MatchList* matches) {
+    matches->count = 0;
+    return SearchLiteral(view, pattern, 0, view.text_size, MatchListCollect, matches);
+}
+
+// Rebuilds the piece list in one pass with every match swapped for the replacement, which is
+// appended to the add buffer once and shared by all its pieces. matches must be sorted and must
+// not overlap. The whole thing is a single undo step. Returns the number of replaced matches.
+size_t ReplaceAllMatches(TextBuffer* buffer, const MatchList* matches, const char* replacement, size_t length) {
+    if (matches->count == 0) return 0;
+
+    size_t add_start = length > 0 ? AppendAddBuffer(buffer, (char*)replacement, length) : 0;
+
+    // Every match splits at most one piece and adds one replacement piece
+    size_t capacity = max((size_t)INITIAL_PIECE_BUFFER_CAPACITY, buffer->piece_count + 2 * matches->count + 1);
+    Piece* pieces = malloc(capacity * sizeof(Piece));
+    size_t piece_count = 0;
+    size_t text_size = buffer->text_size;
+    size_t pointer = buffer->pointer_position;
+
+    size_t index = 0;
+    size_t piece_start = 0;
+    size_t position = 0;
+    for (size_t i = 0; i <= matches->count; ++i) {
+        size_t copy_end = i < matches->count ? matches->items[i].start : buffer->text_size;
+        while (position < copy_end) {
+            Piece piece = buffer->pieces[index];
+            size_t piece_end = piece_start + piece.length;
+            size_t end = min(piece_end, copy_end);
+            pieces[piece_count++] = (Piece){piece.source, piece.start + position - piece_start, end - position};
+            position = end;
+            if (end == piece_end) {
+                piece_start = piece_end;
+                index++;
+            }
+        }
+        if (i == matches->count) break;
+
+        if (length > 0) {
+            pieces[piece_count++] = (Piece){ADD, add_start, length};
+        }
+        Match match = matches->items[i];
+        position = match.start + match.length;
+        text_size = text_size - match.length + length;
+        // The pointer keeps its place in the text around it, inside a match it moves past the replacement
+        if (match.start < buffer->pointer_position) {
+            pointer = pointer - (min(buffer->pointer_position, position) - match.start) + length;
+        }
+        while (index < buffer->piece_count && piece_start + buffer->pieces[index].length <= position) {
+            piece_start += buffer->pieces[index].length;
+            index++;
+        }
+    }
+
+    ReplaceTextPieces(buffer, pieces, piece_count, capacity, text_size, pointer);
+    return matches->count;
+}
@@ -0,0 +1,54 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "funcore.h"
+
+// Walks a view piece by piece, seeking is linear from the last position so nearby lookups are cheap
+typedef struct {
+    PieceView view;
+    size_t index;
+    size_t piece_start;
+} PieceCursor;
+
+typedef struct {
+    char* needle;
+    size_t length;
+    // Horspool shift per byte
+    size_t skip[256];
+    // Tail of the previous pieces plus head of the next one, for matches that straddle pieces
+    char* window;
+} LiteralPattern;
+
+typedef struct {
+    size_t start;
+    size_t length;
+} Match;
+
+typedef struct {
+    Match* items;
+    size_t count;
+    size_t capacity;
+} MatchList;
+
+// Called for every match in text order, return false to stop the search
+typedef bool (*MatchCallback)(void* context, size_t start, size_t length);
+
+PieceCursor InitPieceCursor(PieceView view);
+void SeekPieceCursor(PieceCursor* cursor, size_t position);
+char PieceCursorByteAt(PieceCursor* cursor, size_t position);
+
+bool InitLiteralPattern(LiteralPattern* pattern, const char* needle, size_t length);
+void ClearLiteralPattern(LiteralPattern* pattern);
+size_t FindLiteralInText(const LiteralPattern* pattern, const char* text, size_t length);
+size_t SearchLiteral(PieceView view, LiteralPattern* pattern, size_t from, size_t to, MatchCallback callback, void* context);
+bool FindNextLiteral(PieceView view, LiteralPattern* pattern, size_t from, Match* match);
+
+void InitMatchList(MatchList* list);
+void MatchListAppend(MatchList* list, size_t start, size_t length);
+bool MatchListCollect(void* context, size_t start, size_t length);
+void ClearMatchList(MatchList* list);
+size_t FindAllLiteral(PieceView view, LiteralPattern* pattern, MatchList* matches);
+
+size_t ReplaceAllMatches(TextBuffer* buffer, const MatchList* matches, const char* replacement, size_t length);
+
+#endif